@@ -0,0 +1,364 @@
+// =============================================================
+// Control-path latency benchmark of /dev/camera_control.
+//
+// Issues a mix of control operations (IOCTL_GET, IOCTL_SET,
+// IOCTL_PANTILT_RELATIVE, ...) from one or more threads, first with the
+// stream off, then while a reader thread keeps /dev/camera_stream running,
+// and reports per operation the round-trip latency (percentiles and log2
+// histogram) and the throughput in ops/s.
+//
+//   ./bin/control_bench                          default mix, idle then streaming
+//   ./bin/control_bench -m get=1 -n 2000 -t 4    GET_CUR only, 4 threads
+//   ./bin/control_bench -m pt=1 -r 30 -s 1       30 pan/tilt moves/s while streaming
+//
+// Operations of the mix (name=weight, comma separated):
+//   get     GET_CUR of the exposure time (camera terminal, 4 bytes)
+//   min     GET_MIN of the exposure time (served from the driver cache)
+//   set     SET_CUR of the auto-exposure priority, to the value it already has
+//   pt      IOCTL_PANTILT_RELATIVE, alternately +step and -step in pan
+//   ptasync IOCTL_PANTILT_RELATIVE_ASYNC, same moves
+// =============================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <ioctl_cmds.h>
+
+#define GET_CUR               0x81
+#define SET_CUR               0x01
+#define GET_MIN               0x82
+#define CT_INDEX              0x0100   // camera terminal (entity 1), interface 0
+#define CT_AE_PRIORITY        0x0300
+#define CT_EXPOSURE_ABSOLUTE  0x0400
+#define CTRL_TIMEOUT          400
+
+#define FRAME_SIZE_640x480    (640*480*2)
+#define HIST_BUCKETS          24       // bucket 0: < 1 us, bucket n: [2^(n-1), 2^n) us
+#define MAX_SCHEDULE          64
+
+enum { OP_GET, OP_MIN, OP_SET, OP_PT, OP_PT_ASYNC, OP_COUNT };
+
+static const char *op_names[OP_COUNT] = { "get", "min", "set", "pt", "ptasync" };
+
+struct op_stats {
+    uint64_t *lat;       // ns, one per operation issued
+    uint32_t  count;
+    uint32_t  errors;
+    uint32_t  hist[HIST_BUCKETS];
+};
+
+struct phase {
+    const char      *name;
+    struct op_stats  ops[OP_COUNT];
+    uint64_t         t0, t1;
+    uint32_t         frames;     // read by the stream thread during the phase
+};
+
+static int      fd_control;
+static int      schedule[MAX_SCHEDULE];
+static int      schedule_len;
+static uint32_t nops      = 500;
+static int      nthreads  = 1;
+static int      rate      = 0;     // ops/s over all threads, 0 = back to back
+static int      step      = 64;    // pan units per move (64 per degree)
+static int      streaming = 2;     // 0 = idle only, 1 = streaming only, 2 = both
+static uint8_t  ae_priority;
+static int      ae_priority_valid;
+
+static uint32_t next_op;           // shared by the worker threads
+static uint64_t pace_start;
+static volatile int stop_stream;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t)
+{
+    struct timespec ts = { .tv_sec = t / 1000000000ULL, .tv_nsec = t % 1000000000ULL };
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int parse_mix(const char *mix)
+{
+    char buf[256], *tok, *eq;
+    int op, w;
+
+    snprintf(buf, sizeof(buf), "%s", mix);
+    schedule_len = 0;
+    for (tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        eq = strchr(tok, '=');
+        w = eq ? atoi(eq + 1) : 1;
+        if (eq)
+            *eq = 0;
+        for (op = 0; op < OP_COUNT && strcmp(tok, op_names[op]); op++)
+            ;
+        if (op == OP_COUNT || w < 0) {
+            fprintf(stderr, "control_bench: unknown operation %s\n", tok);
+            return -1;
+        }
+        while (w-- > 0 && schedule_len < MAX_SCHEDULE)
+            schedule[schedule_len++] = op;
+    }
+    return schedule_len ? 0 : -1;
+}
+
+// =============================================================
+// Operations
+// =============================================================
+static int do_op(int op, uint32_t n)
+{
+    struct usb_request req;
+    struct pantilt_relative rel;
+    uint8_t data[4];
+
+    memset(&req, 0, sizeof(req));
+    req.index   = CT_INDEX;
+    req.timeout = CTRL_TIMEOUT;
+    req.data    = data;
+
+    switch (op) {
+    case OP_GET:
+    case OP_MIN:
+        req.request   = (op == OP_GET) ? GET_CUR : GET_MIN;
+        req.value     = CT_EXPOSURE_ABSOLUTE;
+        req.data_size = 4;
+        return ioctl(fd_control, IOCTL_GET, &req);
+    case OP_SET:
+        if (!ae_priority_valid)
+            return -1;
+        req.request   = SET_CUR;
+        req.value     = CT_AE_PRIORITY;
+        req.data_size = 1;
+        data[0]       = ae_priority;
+        return ioctl(fd_control, IOCTL_SET, &req);
+    case OP_PT:
+    case OP_PT_ASYNC:
+        // the head swings around where it started
+        rel.pan  = (n & 1) ? -step : step;
+        rel.tilt = 0;
+        return ioctl(fd_control, op == OP_PT ? IOCTL_PANTILT_RELATIVE : IOCTL_PANTILT_RELATIVE_ASYNC, &rel);
+    }
+    return -1;
+}
+
+static void *worker(void *arg)
+{
+    struct phase *ph = arg;
+    struct op_stats *st;
+    uint64_t t0, dt, us;
+    uint32_t n;
+    int op, r, b;
+
+    while ((n = __atomic_fetch_add(&next_op, 1, __ATOMIC_RELAXED)) < nops) {
+        if (rate)
+            sleep_until(pace_start + (uint64_t)n * 1000000000ULL / rate);
+        op = schedule[n % schedule_len];
+        t0 = now_ns();
+        r = do_op(op, n / schedule_len);
+        dt = now_ns() - t0;
+
+        st = &ph->ops[op];
+        us = dt / 1000;
+        for (b = 0; us && b < HIST_BUCKETS - 1; b++)
+            us >>= 1;
+        pthread_mutex_lock(&stats_lock);
+        if (r < 0)
+            st->errors++;
+        st->lat[st->count++] = dt;
+        st->hist[b]++;
+        pthread_mutex_unlock(&stats_lock);
+    }
+    return NULL;
+}
+
+// Keeps the stream running (and its URB completions going) during a phase
+static void *stream_reader(void *arg)
+{
+    struct phase *ph = arg;
+    uint8_t *frame = malloc(FRAME_SIZE_640x480);
+    int fd = open("/dev/camera_stream", O_RDWR);
+
+    if (fd < 0 || !frame) {
+        perror("open /dev/camera_stream");
+        free(frame);
+        return NULL;
+    }
+    if (ioctl(fd, IOCTL_STREAMON, NULL) < 0) {
+        perror("IOCTL_STREAMON failed");
+        close(fd);
+        free(frame);
+        return NULL;
+    }
+    while (!stop_stream) {
+        if (read(fd, frame, FRAME_SIZE_640x480) > 0 && ph->t0 && !ph->t1)
+            ph->frames++;
+    }
+    ioctl(fd, IOCTL_STREAMOFF, NULL);
+    close(fd);
+    free(frame);
+    return NULL;
+}
+
+// =============================================================
+// Phases and report
+// =============================================================
+static void run_phase(struct phase *ph, int with_stream)
+{
+    pthread_t threads[64], reader;
+    int i, op;
+
+    for (op = 0; op < OP_COUNT; op++) {
+        ph->ops[op].lat = calloc(nops, sizeof(uint64_t));
+        if (!ph->ops[op].lat) {
+            perror("calloc");
+            exit(1);
+        }
+    }
+    if (with_stream) {
+        stop_stream = 0;
+        pthread_create(&reader, NULL, stream_reader, ph);
+        sleep(1);  // let the stream settle before measuring
+    }
+
+    next_op = 0;
+    ph->t0 = pace_start = now_ns();
+    for (i = 0; i < nthreads; i++)
+        pthread_create(&threads[i], NULL, worker, ph);
+    for (i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+    ph->t1 = now_ns();
+
+    if (with_stream) {
+        stop_stream = 1;
+        pthread_join(reader, NULL);
+    }
+    // Let the asynchronous pan/tilt queue drain before the next phase
+    ioctl(fd_control, IOCTL_PANTILT_WAIT, 10000);
+}
+
+static void report(struct phase *ph)
+{
+    double secs = (ph->t1 - ph->t0) / 1e9;
+    struct op_stats *st;
+    uint32_t total = 0;
+    int op, b, last;
+
+    printf("\n== %s: %d thread(s), %s", ph->name, nthreads, rate ? "" : "back to back");
+    if (rate)
+        printf("%d ops/s requested", rate);
+    if (ph->frames)
+        printf(", stream at %.1f fps", ph->frames / secs);
+    printf("\n%-8s %8s %8s %10s %10s %10s %10s %10s\n",
+           "op", "count", "errors", "ops/s", "p50 us", "p90 us", "p99 us", "max us");
+    for (op = 0; op < OP_COUNT; op++) {
+        st = &ph->ops[op];
+        if (!st->count)
+            continue;
+        total += st->count;
+        qsort(st->lat, st->count, sizeof(uint64_t), cmp_u64);
+        printf("%-8s %8u %8u %10.1f %10.1f %10.1f %10.1f %10.1f\n", op_names[op], st->count, st->errors,
+               st->count / secs, st->lat[st->count / 2] / 1e3, st->lat[(uint64_t)st->count * 9 / 10] / 1e3,
+               st->lat[(uint64_t)st->count * 99 / 100] / 1e3, st->lat[st->count - 1] / 1e3);
+    }
+    printf("%-8s %8u %8s %10.1f\n", "all", total, "", total / secs);
+
+    for (op = 0; op < OP_COUNT; op++) {
+        st = &ph->ops[op];
+        if (!st->count)
+            continue;
+        for (last = HIST_BUCKETS - 1; last > 0 && !st->hist[last]; last--)
+            ;
+        printf("%s latency (us):\n", op_names[op]);
+        for (b = 0; b <= last; b++) {
+            if (!st->hist[b])
+                continue;
+            printf("  %8u - %-8u %8u\n", b ? 1U << (b - 1) : 0, 1U << b, st->hist[b]);
+        }
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-m mix] [-n ops] [-t threads] [-r ops/s] [-p step] [-s 0|1|2]\n"
+            "  -m  operations and weights, e.g. get=4,set=1,pt=1 (get, min, set, pt, ptasync)\n"
+            "  -n  operations per phase (default 500)\n"
+            "  -t  threads issuing them concurrently (default 1)\n"
+            "  -r  pace the operations at this total rate (default: back to back)\n"
+            "  -p  pan units of each pan/tilt move (default 64, one degree)\n"
+            "  -s  0 = stream off only, 1 = streaming only, 2 = both (default)\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static struct phase idle = { .name = "stream off" }, busy = { .name = "streaming" };
+    const char *mix = "get=4,min=1,set=1,pt=1";
+    struct usb_request req;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:n:t:r:p:s:h")) != -1) {
+        switch (opt) {
+        case 'm': mix = optarg; break;
+        case 'n': nops = atoi(optarg); break;
+        case 't': nthreads = atoi(optarg); break;
+        case 'r': rate = atoi(optarg); break;
+        case 'p': step = atoi(optarg); break;
+        case 's': streaming = atoi(optarg); break;
+        default:  usage(argv[0]); return 2;
+        }
+    }
+    if (parse_mix(mix) < 0 || nops == 0 || nthreads < 1 || nthreads > 64) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    fd_control = open("/dev/camera_control", O_RDWR);
+    if (fd_control < 0) {
+        perror("open /dev/camera_control");
+        return 1;
+    }
+
+    // SET_CUR writes back the current auto-exposure priority: the camera is left as it was
+    memset(&req, 0, sizeof(req));
+    req.request   = GET_CUR;
+    req.value     = CT_AE_PRIORITY;
+    req.index     = CT_INDEX;
+    req.data_size = 1;
+    req.timeout   = CTRL_TIMEOUT;
+    req.data      = &ae_priority;
+    ae_priority_valid = (ioctl(fd_control, IOCTL_GET, &req) == 0);
+    if (!ae_priority_valid)
+        perror("GET_CUR auto-exposure priority failed, set operations will fail");
+
+    if (streaming != 1) {
+        run_phase(&idle, 0);
+        report(&idle);
+    }
+    if (streaming != 0) {
+        run_phase(&busy, 1);
+        report(&busy);
+    }
+    close(fd_control);
+    return 0;
+}
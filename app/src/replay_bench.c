@@ -0,0 +1,492 @@
+// =============================================================
+// Replay harness and microbenchmark of the frame assembly
+// (driver/include/callback.h built in user space).
+//
+// Feeds synthetic isochronous packet sequences, or a packet trace recorded
+// by the driver (debugfs logitech_orbit/<intf>/packets), through
+// complete_callback() and reports packets/s, bytes/s and how accurately
+// frames were completed.
+//
+//   ./bin/replay_bench                      all synthetic scenarios
+//   ./bin/replay_bench -s lossy -l 20 -c 2  2% lost packets, zero-filled
+//   ./bin/replay_bench -m 2 -R 64,48,320,240,2  planar output of a decimated region
+//   ./bin/replay_bench -r packets.bin       replay a recorded trace
+//
+// Every delivered frame is checked against a reference built here from the
+// source pattern, for any region of interest, decimation and output mode.
+// Exit status is 1 when a delivered frame has wrong content or when a clean
+// frame was not delivered complete, so it can be used as a regression test.
+// =============================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <ioctl_cmds.h>
+#include <callback.h>
+
+#define HEADER_LEN      12
+#define PACKET_SIZE     3060                        // wMaxPacketSize of the Orbit
+#define PAYLOAD_LEN     (PACKET_SIZE - HEADER_LEN)
+
+// Impairments of a synthetic frame
+#define IMP_LOSS        (1 << 0)  // packets completed with an error status
+#define IMP_EARLY_EOF   (1 << 1)  // EOF set on a packet in the middle of the frame
+#define IMP_FID_GLITCH  (1 << 2)  // one packet carries the wrong FID
+
+struct packet {
+    uint32_t offset;   // in the packet pool
+    uint16_t length;   // actual_length, header included
+    int16_t  status;
+};
+
+struct sequence {
+    struct packet *pkts;
+    uint32_t       count;
+    uint32_t       cap;
+    uint8_t       *pool;
+    uint32_t       pool_used;
+    uint32_t       pool_cap;
+    uint8_t       *impaired;  // per frame IMP_* (synthetic only)
+    uint32_t       frames;
+};
+
+struct result {
+    uint32_t delivered_complete;
+    uint32_t delivered_repaired;
+    uint32_t corrupt;           // delivered with bytes that differ from the source
+    uint32_t clean_frames;
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t ns;                // time spent in complete_callback
+};
+
+static uint8_t src_frame[EXPECTED_FRAME_SIZE];
+static uint8_t frame_bufs[3][EXPECTED_FRAME_SIZE];
+
+// Expected output frame, and the source offset each of its bytes comes from
+static uint8_t  ref_frame[EXPECTED_FRAME_SIZE];
+static uint32_t ref_offset[EXPECTED_FRAME_SIZE];
+static uint32_t ref_size;
+static uint8_t urb_buffer[USPACE_URB_PACKETS * PACKET_SIZE];
+
+static int loss_permille = 10;
+static int conceal       = STREAM_CONCEAL_DROP;
+static int output_mode   = STREAM_OUTPUT_YUYV;
+static int urb_packets   = 32;
+static int iterations    = 5;
+static struct stream_roi roi = { 0, 0, FRAME_WIDTH, FRAME_HEIGHT, 1, 0 };
+
+// =============================================================
+// Packet sequences
+// =============================================================
+static void seq_add(struct sequence *seq, uint8_t flags, uint8_t hlen, const uint8_t *payload,
+                    uint32_t len, int status)
+{
+    struct packet *p;
+
+    if (seq->count == seq->cap) {
+        seq->cap = seq->cap ? seq->cap * 2 : 4096;
+        seq->pkts = realloc(seq->pkts, seq->cap * sizeof(*seq->pkts));
+        if (!seq->pkts) {
+            perror("realloc");
+            exit(2);
+        }
+    }
+    while (seq->pool_used + hlen + len > seq->pool_cap) {
+        seq->pool_cap = seq->pool_cap ? seq->pool_cap * 2 : (1 << 24);
+        seq->pool = realloc(seq->pool, seq->pool_cap);
+        if (!seq->pool) {
+            perror("realloc");
+            exit(2);
+        }
+    }
+
+    p = &seq->pkts[seq->count++];
+    p->offset = seq->pool_used;
+    p->length = hlen + len;
+    p->status = status;
+    if (hlen >= 2) {
+        seq->pool[seq->pool_used]     = hlen;
+        seq->pool[seq->pool_used + 1] = flags;
+        memset(seq->pool + seq->pool_used + 2, 0, hlen - 2);
+    }
+    if (len)
+        memcpy(seq->pool + seq->pool_used + hlen, payload, len);
+    seq->pool_used += hlen + len;
+}
+
+// One 640x480 frame; lost packets keep their place (error status, no data).
+// Returns the impairments actually applied.
+static uint8_t gen_frame(struct sequence *seq, int fid, uint8_t imp)
+{
+    uint8_t applied = imp & ~IMP_LOSS;
+    uint32_t off = 0, len, npk = (EXPECTED_FRAME_SIZE + PAYLOAD_LEN - 1) / PAYLOAD_LEN;
+    uint32_t early = npk / 3, glitch = npk / 2, k;
+    uint8_t flags;
+
+    for (k = 0; off < EXPECTED_FRAME_SIZE; k++, off += len) {
+        len   = min(PAYLOAD_LEN, EXPECTED_FRAME_SIZE - off);
+        flags = fid;
+        if (off + len >= EXPECTED_FRAME_SIZE || ((imp & IMP_EARLY_EOF) && k == early))
+            flags |= STREAM_EOF;
+        if ((imp & IMP_FID_GLITCH) && k == glitch)
+            flags ^= STREAM_FID;
+        if ((imp & IMP_LOSS) && rand() % 1000 < loss_permille) {
+            seq_add(seq, 0, 0, NULL, 0, -EPROTO);
+            applied |= IMP_LOSS;
+        } else
+            seq_add(seq, flags, HEADER_LEN, src_frame + off, len, 0);
+    }
+    // idle interval between frames
+    seq_add(seq, 0, 0, NULL, 0, 0);
+    return applied;
+}
+
+static int gen_scenario(struct sequence *seq, const char *name, uint32_t frames)
+{
+    uint8_t imp;
+    uint32_t f;
+
+    seq->impaired = calloc(frames, 1);
+    seq->frames = frames;
+    for (f = 0; f < frames; f++) {
+        if (!strcmp(name, "clean"))
+            imp = 0;
+        else if (!strcmp(name, "lossy"))
+            imp = IMP_LOSS;
+        else if (!strcmp(name, "eof"))
+            imp = (f % 4 == 1) ? IMP_EARLY_EOF : 0;
+        else if (!strcmp(name, "fid"))
+            imp = (f % 4 == 1) ? IMP_FID_GLITCH : 0;
+        else
+            return -1;
+        seq->impaired[f] = gen_frame(seq, f & 1, imp);
+    }
+    return 0;
+}
+
+// Packet trace recorded by the driver: headers and statuses are replayed,
+// the payload is taken from the source pattern at its place in the frame
+// (a lost packet is assumed as long as the previous one, like the driver does).
+static int load_trace(struct sequence *seq, const char *path)
+{
+    struct packet_record rec;
+    uint32_t off = 0, len, last_len = 0;
+    int last_fid = -1, fid;
+    FILE *fp = fopen(path, "rb");
+
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+        if (rec.status || rec.header_len == PACKET_HDR_NONE || rec.header_len > rec.actual_length) {
+            // a packet without a valid header is replayed as lost
+            seq_add(seq, 0, 0, NULL, 0, rec.status ? rec.status : (rec.actual_length ? -EPROTO : 0));
+            if (rec.status || rec.actual_length)
+                off += last_len;
+            continue;
+        }
+        fid = rec.header_flags & STREAM_FID;
+        if (fid != last_fid) {
+            off = 0;
+            seq->frames++;
+        }
+        last_fid = fid;
+        len = rec.actual_length - rec.header_len;
+        if (len && !(rec.header_flags & STREAM_EOF))
+            last_len = len;
+        if (off + len > EXPECTED_FRAME_SIZE)
+            len = off < EXPECTED_FRAME_SIZE ? EXPECTED_FRAME_SIZE - off : 0;
+        seq_add(seq, rec.header_flags, rec.header_len, src_frame + off, len, 0);
+        off += len;
+    }
+    fclose(fp);
+    printf("Loaded %u packets from %s\n", seq->count, path);
+    return seq->count ? 0 : -1;
+}
+
+// =============================================================
+// Reference output
+// =============================================================
+// Written independently of frame_emit_line: output macropixel m of output
+// row r is source macropixel m * decimation of line y + r * decimation.
+static void ref_put(uint32_t pos, uint32_t off)
+{
+    ref_frame[pos]  = src_frame[off];
+    ref_offset[pos] = off;
+}
+
+static void build_reference(void)
+{
+    uint32_t d = roi.decimation, ow = roi.width / d, oh = roi.height / d;
+    uint32_t r, m, k, base, y_plane = ow * oh, c_plane = (ow / 2) * oh;
+
+    for (r = 0; r < oh; r++) {
+        for (m = 0; m < ow / 2; m++) {
+            base = (roi.y + r * d) * FRAME_STRIDE + roi.x * 2 + m * d * 4;
+            switch (output_mode) {
+            case STREAM_OUTPUT_GREY:
+            case STREAM_OUTPUT_YUV422P:
+                ref_put(r * ow + m * 2,     base);      // Y0
+                ref_put(r * ow + m * 2 + 1, base + 2);  // Y1
+                if (output_mode == STREAM_OUTPUT_GREY)
+                    break;
+                ref_put(y_plane + r * (ow / 2) + m,           base + 1);  // U
+                ref_put(y_plane + c_plane + r * (ow / 2) + m, base + 3);  // V
+                break;
+            default:
+                for (k = 0; k < 4; k++)
+                    ref_put((r * (ow / 2) + m) * 4 + k, base + k);
+                break;
+            }
+        }
+    }
+    ref_size = (output_mode == STREAM_OUTPUT_GREY) ? y_plane : y_plane * 2;
+}
+
+// =============================================================
+// Replay
+// =============================================================
+static void buffer_init(struct driver_buffer *b)
+{
+    memset(b, 0, sizeof(*b));
+    b->Data      = frame_bufs[0];
+    b->ReadyData = frame_bufs[1];
+    b->ReadData  = frame_bufs[2];
+    b->MaxLength = EXPECTED_FRAME_SIZE;
+    b->Roi               = roi;
+    b->Output            = output_mode;
+    b->FrameSize         = frame_out_size(&b->Roi, b->Output);
+    b->DeliverEvery      = 1;
+    b->Conceal           = conceal;
+    b->ConcealMinPercent = 50;
+    b->Profile           = URB_PROFILE_THROUGHPUT;
+    b->LastFID           = -1;
+    b->Status            = BUF_STREAM_READ;
+}
+
+// What read() does: take the ready frame and check it against the source
+static void consume(struct driver_buffer *b, struct result *res)
+{
+    const struct frame_meta *m;
+    uint8_t *tmp;
+    uint32_t i, k;
+    int damaged;
+
+    if (!(b->Status & BUF_STREAM_EOF))
+        return;
+    tmp = b->ReadData;
+    b->ReadData   = b->ReadyData;
+    b->ReadyData  = tmp;
+    b->ReadBytes  = b->ReadyBytes;
+    b->LastMeta   = b->ReadyMeta;
+    b->Status    &= ~BUF_STREAM_EOF;
+    m = &b->LastMeta;
+
+    if (m->flags & FRAME_FLAG_COMPLETE)
+        res->delivered_complete++;
+    else
+        res->delivered_repaired++;
+
+    // Damaged ranges are source offsets: skip the output bytes taken from them
+    if (b->ReadBytes != ref_size) {
+        res->corrupt++;
+        return;
+    }
+    for (i = 0; i < ref_size; i++) {
+        damaged = 0;
+        for (k = 0; k < min(m->damage_count, (uint32_t)FRAME_META_MAX_DAMAGE); k++)
+            if (ref_offset[i] >= m->damage[k].offset && ref_offset[i] - m->damage[k].offset < m->damage[k].length)
+                damaged = 1;
+        if (!damaged && b->ReadData[i] != ref_frame[i]) {
+            res->corrupt++;
+            return;
+        }
+    }
+}
+
+static void replay(const struct sequence *seq, struct result *res)
+{
+    static struct driver_buffer b;
+    static struct urb urb;
+    const struct packet *p;
+    uint32_t i = 0, n, off;
+    uint64_t t0;
+
+    buffer_init(&b);
+    urb.context = &b;
+    urb.transfer_buffer = urb_buffer;
+
+    while (i < seq->count) {
+        // One URB of urb_packets packets, laid out as the host controller does
+        urb.status = 0;
+        urb.error_count = 0;
+        for (n = 0, off = 0; n < (uint32_t)urb_packets && i < seq->count; n++, i++) {
+            p = &seq->pkts[i];
+            memcpy(urb_buffer + off, seq->pool + p->offset, p->length);
+            urb.iso_frame_desc[n].offset        = off;
+            urb.iso_frame_desc[n].length        = PACKET_SIZE;
+            urb.iso_frame_desc[n].actual_length = p->length;
+            urb.iso_frame_desc[n].status        = p->status;
+            urb.error_count += (p->status != 0);
+            res->bytes += p->length;
+            off += PACKET_SIZE;
+        }
+        urb.number_of_packets = n;
+        res->packets += n;
+
+        t0 = ktime_get_ns();
+        complete_callback(&urb);
+        res->ns += ktime_get_ns() - t0;
+
+        consume(&b, res);
+    }
+}
+
+// Frames of the sequence that reach the driver intact
+static uint32_t clean_frames(const struct sequence *seq)
+{
+    uint32_t f, n = 0;
+
+    for (f = 0; f < seq->frames; f++)
+        n += !seq->impaired[f];
+    return n;
+}
+
+static int run(const char *name, struct sequence *seq)
+{
+    struct result res = {0}, one;
+    int it, failed = 0;
+
+    for (it = 0; it < iterations; it++) {
+        memset(&one, 0, sizeof(one));
+        replay(seq, &one);
+        res.packets += one.packets;
+        res.bytes   += one.bytes;
+        res.ns      += one.ns;
+        if (it == 0) {
+            res.delivered_complete = one.delivered_complete;
+            res.delivered_repaired = one.delivered_repaired;
+            res.corrupt            = one.corrupt;
+        }
+    }
+    if (res.ns == 0)
+        res.ns = 1;
+
+    printf("%-8s %7u %9u %9u %8u %8u %12.0f %9.1f %8.1f\n",
+           name, seq->frames, res.delivered_complete, res.delivered_repaired,
+           seq->frames - min(seq->frames, res.delivered_complete + res.delivered_repaired),
+           res.corrupt,
+           res.packets * 1e9 / res.ns, res.bytes * 1e9 / res.ns / 1e6,
+           (double)res.ns / res.packets);
+
+    if (res.corrupt)
+        failed = 1;
+    // Every intact synthetic frame must come out complete
+    if (seq->impaired && res.delivered_complete < clean_frames(seq)) {
+        printf("  -> %u intact frames, only %u delivered complete\n", clean_frames(seq), res.delivered_complete);
+        failed = 1;
+    }
+    return failed;
+}
+
+static void seq_free(struct sequence *seq)
+{
+    free(seq->pkts);
+    free(seq->pool);
+    free(seq->impaired);
+    memset(seq, 0, sizeof(*seq));
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-s clean|lossy|eof|fid|all] [-n frames] [-l loss_permille]\n"
+            "          [-c conceal 0-3] [-m output 0-2] [-p packets_per_urb] [-i iterations]\n"
+            "          [-R x,y,width,height[,decimation]] [-r packets.bin]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    static const char *all[] = { "clean", "lossy", "eof", "fid" };
+    const char *scenario = "all", *trace = NULL;
+    struct sequence seq = {0};
+    uint32_t frames = 300, i;
+    unsigned int rx, ry, rw, rh, rd;
+    int opt, failed = 0, known;
+
+    while ((opt = getopt(argc, argv, "s:n:l:c:m:p:i:R:r:h")) != -1) {
+        switch (opt) {
+        case 's': scenario = optarg; break;
+        case 'n': frames = atoi(optarg); break;
+        case 'l': loss_permille = atoi(optarg); break;
+        case 'c': conceal = atoi(optarg) & 3; break;
+        case 'm': output_mode = atoi(optarg) % 3; break;
+        case 'p': urb_packets = atoi(optarg); break;
+        case 'i': iterations = atoi(optarg); break;
+        case 'r': trace = optarg; break;
+        case 'R':
+            rd = 1;
+            if (sscanf(optarg, "%u,%u,%u,%u,%u", &rx, &ry, &rw, &rh, &rd) < 4) {
+                usage(argv[0]);
+                return 2;
+            }
+            roi.x = rx;
+            roi.y = ry;
+            roi.width = rw;
+            roi.height = rh;
+            roi.decimation = rd;
+            break;
+        default:  usage(argv[0]); return 2;
+        }
+    }
+    if (urb_packets < 1 || urb_packets > USPACE_URB_PACKETS || iterations < 1 || frames < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    // Same rules as IOCTL_STREAM_SET_ROI
+    if ((roi.decimation != 1 && roi.decimation != 2 && roi.decimation != 4) ||
+        (roi.x % 2) || roi.width == 0 || (roi.width % (2 * roi.decimation)) || roi.height == 0 ||
+        (roi.height % roi.decimation) ||
+        roi.x + roi.width > FRAME_WIDTH || roi.y + roi.height > FRAME_HEIGHT) {
+        fprintf(stderr, "invalid region %ux%u at (%u,%u), decimation %u\n",
+                roi.width, roi.height, roi.x, roi.y, roi.decimation);
+        return 2;
+    }
+    for (i = 0, known = !strcmp(scenario, "all"); i < sizeof(all) / sizeof(all[0]); i++)
+        known |= !strcmp(scenario, all[i]);
+    if (!known) {
+        fprintf(stderr, "unknown scenario %s\n", scenario);
+        usage(argv[0]);
+        return 2;
+    }
+
+    for (i = 0; i < EXPECTED_FRAME_SIZE; i++)
+        src_frame[i] = (uint8_t)(i * 7 + (i >> 11));
+    build_reference();
+    srand(784);
+
+    printf("%u packets per URB, conceal %d, output %d, region %ux%u at (%u,%u) / %u, %d iterations\n",
+           urb_packets, conceal, output_mode, roi.width, roi.height, roi.x, roi.y, roi.decimation, iterations);
+    printf("%-8s %7s %9s %9s %8s %8s %12s %9s %8s\n",
+           "scenario", "frames", "complete", "repaired", "dropped", "corrupt", "packets/s", "MB/s", "ns/pkt");
+
+    if (trace) {
+        if (load_trace(&seq, trace) < 0)
+            return 2;
+        failed |= run("trace", &seq);
+        seq_free(&seq);
+        return failed;
+    }
+
+    for (i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+        if (strcmp(scenario, "all") && strcmp(scenario, all[i]))
+            continue;
+        gen_scenario(&seq, all[i], frames);
+        failed |= run(all[i], &seq);
+        seq_free(&seq);
+    }
+    return failed;
+}
@@ -0,0 +1,288 @@
+// =============================================================
+// Headless streaming benchmark of /dev/camera_stream.
+//
+// Streams for a number of frames or seconds, keeps nothing but timestamps in
+// the capture loop (no disk I/O, no printing) and reports, as JSON:
+// delivered fps, inter-frame interval percentiles and jitter, the delay
+// between the hand-over of a frame by the driver and its read(), short and
+// repaired frames, frames lost (sequence gaps) and CPU time per frame.
+//
+//   ./bin/stream_bench -d 10                 10 seconds, JSON on stdout
+//   ./bin/stream_bench -n 1000 -P 1 -o r.json  1000 frames, low latency URBs
+//   ./bin/stream_bench -S 120 -d 5           driver synthetic source at 120 fps
+//
+// Exit status is 1 when no frame was read.
+// =============================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+#include <ioctl_cmds.h>
+
+#define FRAME_SIZE_640x480  (640*480*2)
+#define MAX_SAMPLES         (1 << 20)
+
+struct sample {
+    uint64_t read_ns;     // CLOCK_MONOTONIC when read() returned
+    uint64_t handover_ns; // frame_meta.timestamp_ns
+    uint32_t sequence;
+    uint32_t flags;
+    int32_t  bytes;
+};
+
+static struct sample *samples;
+static uint32_t nsamples;
+
+static int   max_frames  = 0;    // 0 = until the duration is over
+static int   duration_s  = 10;
+static int   warmup      = 10;
+static int   conceal     = -1;   // -1 = leave the driver settings
+static int   profile     = -1;
+static int   synth_fps   = 0;
+static const char *out_path = NULL;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t tv_ns(const struct timeval *tv)
+{
+    return (uint64_t)tv->tv_sec * 1000000000ULL + (uint64_t)tv->tv_usec * 1000;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void print_percentiles(FILE *fp, const char *name, uint64_t *v, uint32_t n)
+{
+    double mean = 0, var = 0;
+    uint32_t i;
+
+    if (n == 0) {
+        fprintf(fp, "  \"%s\": null,\n", name);
+        return;
+    }
+    for (i = 0; i < n; i++)
+        mean += v[i];
+    mean /= n;
+    for (i = 0; i < n; i++)
+        var += (v[i] - mean) * (v[i] - mean);
+    qsort(v, n, sizeof(v[0]), cmp_u64);
+    fprintf(fp, "  \"%s\": {\"min\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f, "
+            "\"mean\": %.1f, \"stddev\": %.1f},\n", name,
+            v[0] / 1e3, v[n / 2] / 1e3, v[(uint64_t)n * 9 / 10] / 1e3, v[(uint64_t)n * 99 / 100] / 1e3,
+            v[n - 1] / 1e3, mean / 1e3, sqrt(var / n) / 1e3);
+}
+
+// Everything is computed after the capture loop
+static void report(FILE *fp, uint32_t expected, uint64_t t0, uint64_t t1,
+                   const struct rusage *ru0, const struct rusage *ru1,
+                   const struct stream_geometry *geo0, const struct stream_geometry *geo1)
+{
+    uint64_t *v = malloc(sizeof(*v) * (nsamples ? nsamples : 1));
+    uint64_t utime = tv_ns(&ru1->ru_utime) - tv_ns(&ru0->ru_utime);
+    uint64_t stime = tv_ns(&ru1->ru_stime) - tv_ns(&ru0->ru_stime);
+    uint32_t i, n, shorts = 0, repaired = 0, recovered = 0, lost = 0;
+    double secs = (t1 - t0) / 1e9;
+    struct utsname u;
+
+    for (i = 0; i < nsamples; i++) {
+        if (samples[i].bytes < (int32_t)expected)
+            shorts++;
+        if (samples[i].flags & FRAME_FLAG_REPAIRED)
+            repaired++;
+        if (samples[i].flags & FRAME_FLAG_RECOVERED)
+            recovered++;
+        if (i > 0 && samples[i].sequence > samples[i - 1].sequence + 1)
+            lost += samples[i].sequence - samples[i - 1].sequence - 1;
+    }
+    uname(&u);
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"kernel\": \"%s\",\n", u.release);
+    fprintf(fp, "  \"source\": \"%s\",\n", synth_fps ? "synthetic" : "camera");
+    fprintf(fp, "  \"profile\": %d,\n", geo1->profile);
+    fprintf(fp, "  \"conceal\": %d,\n", conceal);
+    fprintf(fp, "  \"duration_s\": %.3f,\n", secs);
+    fprintf(fp, "  \"frames\": %u,\n", nsamples);
+    fprintf(fp, "  \"frame_bytes\": %u,\n", expected);
+    fprintf(fp, "  \"fps\": %.2f,\n", secs > 0 ? nsamples / secs : 0.0);
+    fprintf(fp, "  \"short_frames\": %u,\n", shorts);
+    fprintf(fp, "  \"repaired_frames\": %u,\n", repaired);
+    fprintf(fp, "  \"recovered_frames\": %u,\n", recovered);
+    fprintf(fp, "  \"lost_frames\": %u,\n", lost);
+
+    for (i = 1, n = 0; i < nsamples; i++)
+        v[n++] = samples[i].read_ns - samples[i - 1].read_ns;
+    print_percentiles(fp, "interval_us", v, n);
+    for (i = 0, n = 0; i < nsamples; i++)
+        if (samples[i].handover_ns && samples[i].read_ns >= samples[i].handover_ns)
+            v[n++] = samples[i].read_ns - samples[i].handover_ns;
+    print_percentiles(fp, "handover_to_read_us", v, n);
+
+    fprintf(fp, "  \"cpu\": {\"user_ms\": %.3f, \"sys_ms\": %.3f, \"us_per_frame\": %.2f},\n",
+            utime / 1e6, stime / 1e6, nsamples ? (utime + stime) / 1e3 / nsamples : 0.0);
+    fprintf(fp, "  \"driver\": {\"urbs_in_flight\": %u, \"packets_per_urb\": %u, \"packet_size\": %u, "
+            "\"missed_intervals\": %u, \"late_resubmits\": %u}\n",
+            geo1->in_flight, geo1->packets_per_urb, geo1->packet_size,
+            geo1->missed_intervals - geo0->missed_intervals, geo1->late_resubmits - geo0->late_resubmits);
+    fprintf(fp, "}\n");
+    free(v);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-n frames] [-d seconds] [-w warmup] [-c conceal] [-P profile] [-S fps] [-o file]\n"
+            "  -n  stop after this many frames (default: run for -d seconds, 10)\n"
+            "  -c  STREAM_CONCEAL_* (0 drop, 1 mark, 2 zero, 3 previous)\n"
+            "  -P  URB_PROFILE_* (0 throughput, 1 low latency, 2 adaptive)\n"
+            "  -S  feed the stream from the driver synthetic source at this rate\n"
+            "  -o  write the JSON report to a file instead of stdout\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    struct stream_geometry geo0, geo1;
+    struct stream_roi roi;
+    struct frame_meta meta;
+    struct rusage ru0, ru1;
+    uint32_t expected = FRAME_SIZE_640x480, cap;
+    uint64_t t0 = 0, t1, deadline = 0;
+    uint8_t *frame;
+    int opt, fd, r, i;
+    FILE *fp = stdout;
+
+    while ((opt = getopt(argc, argv, "n:d:w:c:P:S:o:h")) != -1) {
+        switch (opt) {
+        case 'n': max_frames = atoi(optarg); break;
+        case 'd': duration_s = atoi(optarg); break;
+        case 'w': warmup = atoi(optarg); break;
+        case 'c': conceal = atoi(optarg); break;
+        case 'P': profile = atoi(optarg); break;
+        case 'S': synth_fps = atoi(optarg); break;
+        case 'o': out_path = optarg; break;
+        default:  usage(argv[0]); return 2;
+        }
+    }
+
+    // room for the frames asked, or for the duration at the highest synthetic rate
+    cap = max_frames ? (uint32_t)max_frames : (uint32_t)duration_s * 1000 + 1;
+    if (cap > MAX_SAMPLES)
+        cap = MAX_SAMPLES;
+    samples = calloc(cap, sizeof(*samples));
+    frame = malloc(FRAME_SIZE_640x480);
+    if (!samples || !frame) {
+        perror("malloc");
+        return 1;
+    }
+
+    fd = open("/dev/camera_stream", O_RDWR);
+    if (fd < 0) {
+        perror("open /dev/camera_stream");
+        return 1;
+    }
+
+    // Settings, all applied before STREAMON
+    if (conceal >= 0) {
+        struct stream_conceal c = { .mode = conceal, .min_percent = 0 };
+
+        if (ioctl(fd, IOCTL_STREAM_SET_CONCEAL, &c) < 0)
+            perror("IOCTL_STREAM_SET_CONCEAL failed");
+    }
+    if (profile >= 0) {
+        struct stream_geometry g = { .profile = profile };
+
+        if (ioctl(fd, IOCTL_STREAM_SET_GEOMETRY, &g) < 0)
+            perror("IOCTL_STREAM_SET_GEOMETRY failed");
+    }
+    if (synth_fps) {
+        struct stream_synth s = { .enable = 1, .fps = synth_fps };
+
+        if (ioctl(fd, IOCTL_STREAM_SET_SYNTH, &s) < 0)
+            perror("IOCTL_STREAM_SET_SYNTH failed");
+    }
+    if (ioctl(fd, IOCTL_STREAM_GET_ROI, &roi) == 0 && roi.frame_size)
+        expected = roi.frame_size;
+
+    if (ioctl(fd, IOCTL_STREAMON, NULL) < 0) {
+        perror("IOCTL_STREAMON failed");
+        close(fd);
+        return 1;
+    }
+
+    // Warm-up: the first frames include the start of the stream
+    for (i = 0; i < warmup; i++)
+        if (read(fd, frame, FRAME_SIZE_640x480) < 0 && errno != EINTR && errno != EAGAIN)
+            break;
+
+    memset(&geo0, 0, sizeof(geo0));
+    ioctl(fd, IOCTL_STREAM_GET_GEOMETRY, &geo0);
+    getrusage(RUSAGE_SELF, &ru0);
+    t0 = now_ns();
+    if (!max_frames)
+        deadline = t0 + (uint64_t)duration_s * 1000000000ULL;
+
+    // Capture loop: read, metadata, timestamp
+    while (nsamples < cap) {
+        r = read(fd, frame, FRAME_SIZE_640x480);
+        t1 = now_ns();
+        if (r < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            perror("read failed");
+            break;
+        }
+        if (ioctl(fd, IOCTL_STREAM_GET_META, &meta) < 0)
+            memset(&meta, 0, sizeof(meta));
+        samples[nsamples].read_ns     = t1;
+        samples[nsamples].handover_ns = meta.timestamp_ns;
+        samples[nsamples].sequence    = meta.sequence;
+        samples[nsamples].flags       = meta.flags;
+        samples[nsamples].bytes       = r;
+        nsamples++;
+        if (deadline && t1 >= deadline)
+            break;
+    }
+    t1 = now_ns();
+    getrusage(RUSAGE_SELF, &ru1);
+    memset(&geo1, 0, sizeof(geo1));
+    ioctl(fd, IOCTL_STREAM_GET_GEOMETRY, &geo1);
+
+    if (ioctl(fd, IOCTL_STREAMOFF, NULL) < 0)
+        perror("IOCTL_STREAMOFF failed");
+    if (synth_fps) {
+        struct stream_synth s = { .enable = 0 };
+
+        ioctl(fd, IOCTL_STREAM_SET_SYNTH, &s);
+    }
+    close(fd);
+
+    if (out_path && !(fp = fopen(out_path, "w"))) {
+        perror(out_path);
+        fp = stdout;
+    }
+    report(fp, expected, t0, t1, &ru0, &ru1, &geo0, &geo1);
+    if (fp != stdout)
+        fclose(fp);
+
+    free(frame);
+    free(samples);
+    return nsamples ? 0 : 1;
+}
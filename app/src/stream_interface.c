@@ -1,7 +1,12 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <sys/ioctl.h>
 #include <stdbool.h>
 #include <time.h>
@@ -17,14 +22,6 @@
 #define HEIGHT 480
 #define FRAME_SIZE (WIDTH * HEIGHT * 2)
 
-// =======================================
-// Pan / Tilt ranges (from spec / lab)
-// =======================================
-#define PAN_MIN   (-4480)
-#define PAN_MAX   ( 4480)
-#define TILT_MIN  (-1920)
-#define TILT_MAX  ( 1920)
-
 // =======================================
 // Control panel width (for GUI)
 // =======================================
@@ -43,6 +40,50 @@
 #define UI_PANEL_HEIGHT         40
 #define STATUS_UPDATE_INTERVAL  500
 #define INPUT_BUF_SIZE          16
+#define WAKE_SIGNAL             SIGUSR1   // interrupts a blocking read()/ioctl() at quit
+
+// =======================================
+// Triple buffer between the capture thread and the render loop (lock-free).
+// The capture thread fills back, then swaps it with middle; the render loop
+// swaps front with middle when middle holds a frame it has not shown yet.
+// Neither side ever waits for the other and the render loop always gets the
+// newest complete frame.
+// =======================================
+#define TB_FRESH 4   // set in middle when it holds a new frame
+
+typedef struct {
+    uint8_t* buf[3];
+    atomic_uint middle;  // buffer index | TB_FRESH
+    unsigned back;       // capture thread only
+    unsigned front;      // render loop only
+} TripleBuffer;
+
+// =======================================
+// Pan/tilt worker: the moves (and the homing at startup) last seconds, they
+// run on their own thread so that the video and the window keep going.
+// The queue has one pending slot: a new command replaces the one not started
+// yet, so only the last MOVE clicked during a motion is executed after it.
+// A pending RESET is never replaced by a MOVE: the MOVE waits behind it.
+// =======================================
+typedef enum { MOTION_NONE, MOTION_RESET, MOTION_MOVE } MotionKind;
+
+typedef struct {
+    MotionKind kind;
+    int pan, tilt;      // MOTION_MOVE target
+} MotionCmd;
+
+typedef struct {
+    pthread_t       thread;
+    bool            started;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    MotionCmd       pending;     // next command (kind NONE = empty)
+    MotionCmd       after_reset; // MOVE posted behind a pending RESET
+    MotionCmd       current;     // command running (kind NONE = idle)
+    uint32_t        superseded;  // pending moves replaced before they started
+    bool            quit;
+    atomic_bool     done;        // the worker left its loop
+} MotionQueue;
 
 typedef struct {
     int fd_stream;
@@ -53,17 +94,34 @@ typedef struct {
     SDL_Texture*  texture;
     TTF_Font*     font;
 
-    bool running;
+    atomic_bool running;
     bool paused;
     bool show_info;
 
-    uint32_t frame_count;
-    uint32_t fps;
+    // Capture thread
+    pthread_t    capture_thread;
+    bool         capture_started;
+    atomic_bool  capture_done;
+    TripleBuffer tb;
+    atomic_uint  captured;        // frames read since start
+
+    // Pan/tilt worker, and the copy of its state drawn by the render loop
+    MotionQueue motion;
+    MotionCmd   moving;
+    MotionCmd   queued;
+
+    // Rates over the last second
+    uint32_t frame_count;         // frames captured since start
+    uint32_t capture_fps;
+    uint32_t render_fps;
+    uint32_t rendered;            // new frames shown during the current second
+    uint32_t last_captured;
     uint32_t last_fps_time;
     uint32_t last_status_time;
 
     int pan;
     int tilt;
+    struct pantilt_caps caps;  // ranges of this camera (IOCTL_PANTILT_GET_CAPS)
 
     char input_pan[INPUT_BUF_SIZE];
     char input_tilt[INPUT_BUF_SIZE];
@@ -112,8 +170,8 @@ static void draw_ui(CameraApp* app)
 
     char text[256];
     snprintf(text,sizeof(text),
-             "FPS:%u | Frames:%u | %s | HW-YUV | SPACE=Pause  I=Info  Q=Quit  F=Fullscreen",
-             app->fps, app->frame_count, app->paused?"PAUSED":"RUNNING");
+             "Capture:%u fps | Render:%u fps | Frames:%u | %s | SPACE=Pause  I=Info  Q=Quit  F=Fullscreen",
+             app->capture_fps, app->render_fps, app->frame_count, app->paused?"PAUSED":"RUNNING");
 
     draw_text(app, text, 10, 10, app->paused ? red : green);
 
@@ -123,8 +181,13 @@ static void draw_ui(CameraApp* app)
     draw_text(app,"640x480 YUY2",10,WINDOW_HEIGHT-25,yellow);
 
     char ctext[64];
-    snprintf(ctext,sizeof(ctext),"Center: pan=%d tilt=%d",app->pan,app->tilt);
-    draw_text(app, ctext, WINDOW_WIDTH-260, 10, white);
+    if(app->moving.kind==MOTION_MOVE)
+        snprintf(ctext,sizeof(ctext),"Moving to pan=%d tilt=%d",app->moving.pan,app->moving.tilt);
+    else if(app->moving.kind==MOTION_RESET)
+        snprintf(ctext,sizeof(ctext),"Homing...");
+    else
+        snprintf(ctext,sizeof(ctext),"Center: pan=%d tilt=%d",app->pan,app->tilt);
+    draw_text(app, ctext, WINDOW_WIDTH-260, 10, app->moving.kind!=MOTION_NONE ? yellow : white);
 }
 
 // =============================================================
@@ -154,6 +217,15 @@ static SDL_Rect get_move_btn() {
     return r;
 }
 
+// Position of (pan, tilt) in the movement range box
+static void box_point(CameraApp* app,const SDL_Rect* box,int pan,int tilt,int* x,int* y)
+{
+    float pn=(float)(pan-app->caps.pan_min)/(app->caps.pan_max-app->caps.pan_min);
+    float tn=(float)(tilt-app->caps.tilt_min)/(app->caps.tilt_max-app->caps.tilt_min);
+    *x=box->x+(int)(pn*box->w);
+    *y=box->y+(int)(tn*box->h);
+}
+
 // =============================================================
 // Draw control panel (with center display + key instructions)
 // =============================================================
@@ -198,15 +270,26 @@ static void draw_control_panel(CameraApp* app)
     SDL_RenderDrawLine(app->renderer,box.x,cy,box.x+box.w,cy);
 
     // dot showing current center
-    float pn=(float)(app->pan-PAN_MIN)/(PAN_MAX-PAN_MIN);
-    float tn=(float)(app->tilt-TILT_MIN)/(TILT_MAX-TILT_MIN);
-    int dx=box.x+(int)(pn*box.w);
-    int dy=box.y+(int)(tn*box.h);
-
+    int dx,dy;
+    box_point(app,&box,app->pan,app->tilt,&dx,&dy);
     SDL_SetRenderDrawColor(app->renderer,0,255,0,255);
     SDL_Rect dot={dx-3,dy-3,6,6};
     SDL_RenderFillRect(app->renderer,&dot);
 
+    // yellow square on the target in progress, grey on the queued one
+    if(app->moving.kind==MOTION_MOVE){
+        box_point(app,&box,app->moving.pan,app->moving.tilt,&dx,&dy);
+        SDL_SetRenderDrawColor(app->renderer,active.r,active.g,active.b,255);
+        SDL_Rect t={dx-5,dy-5,10,10};
+        SDL_RenderDrawRect(app->renderer,&t);
+    }
+    if(app->queued.kind==MOTION_MOVE){
+        box_point(app,&box,app->queued.pan,app->queued.tilt,&dx,&dy);
+        SDL_SetRenderDrawColor(app->renderer,inactive.r,inactive.g,inactive.b,255);
+        SDL_Rect t={dx-5,dy-5,10,10};
+        SDL_RenderDrawRect(app->renderer,&t);
+    }
+
     //---------------------------------------------------------
     // Input boxes + labels
     //---------------------------------------------------------
@@ -253,57 +336,255 @@ static void draw_control_panel(CameraApp* app)
 
 
 // =============================================================
-// FPS
+// Triple buffer
+// =============================================================
+static bool tb_init(TripleBuffer* tb)
+{
+    for(int i=0;i<3;i++){
+        tb->buf[i]=malloc(FRAME_SIZE);
+        if(!tb->buf[i]) return false;
+    }
+    tb->back=0;
+    atomic_store(&tb->middle,1);
+    tb->front=2;
+    return true;
+}
+
+static void tb_free(TripleBuffer* tb)
+{
+    for(int i=0;i<3;i++){ free(tb->buf[i]); tb->buf[i]=NULL; }
+}
+
+// Capture side: the frame in back is complete, publish it
+static void tb_publish(TripleBuffer* tb)
+{
+    tb->back=atomic_exchange(&tb->middle,tb->back|TB_FRESH)&3;
+}
+
+// Render side: take the newest frame if there is one not shown yet
+static bool tb_take(TripleBuffer* tb)
+{
+    if(!(atomic_load(&tb->middle)&TB_FRESH)) return false;
+    tb->front=atomic_exchange(&tb->middle,tb->front)&3;
+    return true;
+}
+
+// =============================================================
+// Capture thread: read() as fast as the driver delivers
+// =============================================================
+static void wake_handler(int sig){ (void)sig; }
+
+static void* capture_loop(void* arg)
+{
+    CameraApp* app=arg;
+
+    while(atomic_load(&app->running)){
+        int r=read(app->fd_stream,app->tb.buf[app->tb.back],FRAME_SIZE);
+        if(r<0){
+            if(errno==EINTR || errno==EAGAIN) continue;
+            perror("read stream");
+            break;
+        }
+        if(r>0){
+            tb_publish(&app->tb);
+            atomic_fetch_add(&app->captured,1);
+        }
+    }
+    atomic_store(&app->capture_done,true);
+    return NULL;
+}
+
+// No SA_RESTART: the signal makes a blocked read() or ioctl() return EINTR
+static void install_wake_signal(void)
+{
+    struct sigaction sa={0};
+    sa.sa_handler=wake_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(WAKE_SIGNAL,&sa,NULL);
+}
+
+static bool start_capture(CameraApp* app)
+{
+    if(pthread_create(&app->capture_thread,NULL,capture_loop,app)!=0){
+        fprintf(stderr,"capture thread fail\n");
+        return false;
+    }
+    app->capture_started=true;
+    return true;
+}
+
+static void stop_capture(CameraApp* app)
+{
+    if(!app->capture_started) return;
+    atomic_store(&app->running,false);
+    // read() waits for the next frame without timeout: interrupt it until the thread leaves
+    while(!atomic_load(&app->capture_done)){
+        pthread_kill(app->capture_thread,WAKE_SIGNAL);
+        usleep(10000);
+    }
+    pthread_join(app->capture_thread,NULL);
+    app->capture_started=false;
+}
+
+// =============================================================
+// FPS (capture and render, once per second)
 // =============================================================
 static void update_fps(CameraApp* app)
 {
-    static uint32_t count=0;
     uint32_t now=SDL_GetTicks();
 
-    count++;
+    app->frame_count=atomic_load(&app->captured);
     if(now-app->last_fps_time>=1000){
-        app->fps=count;
+        app->capture_fps=(app->frame_count-app->last_captured)*1000/(now-app->last_fps_time);
+        app->render_fps=app->rendered*1000/(now-app->last_fps_time);
+        app->last_captured=app->frame_count;
+        app->rendered=0;
         app->last_fps_time=now;
-        count=0;
     }
-    app->frame_count = app->fps;
 }
 
 // =============================================================
-// Movement logic
+// Movement logic (pan/tilt worker)
 // =============================================================
-static int clamp_step(int d,int lim){
-    if(d> lim) return lim;
-    if(d<-lim) return -lim;
-    return d;
+// A MOVE not started yet is dropped (called with the queue locked)
+static void motion_supersede(MotionQueue* q,MotionCmd* slot)
+{
+    if(slot->kind==MOTION_MOVE){
+        q->superseded++;
+        printf("Move pan=%d tilt=%d superseded\n",slot->pan,slot->tilt);
+    }
+    slot->kind=MOTION_NONE;
 }
 
-static void move_to_new_center(CameraApp* app,int tp,int tt)
+// Queue a command for the worker, replacing the one still pending. A MOVE
+// posted while a RESET is pending runs after the RESET.
+static void motion_post(MotionQueue* q,MotionCmd c)
 {
-    if(tp>PAN_MAX) tp=PAN_MAX;
-    if(tp<PAN_MIN) tp=PAN_MIN;
-    if(tt>TILT_MAX)tt=TILT_MAX;
-    if(tt<TILT_MIN)tt=TILT_MIN;
+    pthread_mutex_lock(&q->lock);
+    if(c.kind==MOTION_MOVE && q->pending.kind==MOTION_RESET){
+        motion_supersede(q,&q->after_reset);
+        q->after_reset=c;
+    }else{
+        motion_supersede(q,&q->pending);
+        motion_supersede(q,&q->after_reset);
+        q->pending=c;
+    }
+    pthread_cond_signal(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
 
-    int dpan=tp-app->pan;
-    int dtilt=tt-app->tilt;
+static bool motion_quit(MotionQueue* q)
+{
+    pthread_mutex_lock(&q->lock);
+    bool quit=q->quit;
+    pthread_mutex_unlock(&q->lock);
+    return quit;
+}
 
-    printf("Move request pan=%d tilt=%d delta=(%d,%d)\n",tp,tt,dpan,dtilt);
+// Runs on the worker. For a move the driver clamps the target, splits the
+// move in steps and waits for the end of each motion before sending the next one.
+static void motion_run(CameraApp* app,MotionCmd* c)
+{
+    if(c->kind==MOTION_RESET){
+        printf("RESET... "); fflush(stdout);
+        if(ioctl(app->fd_control,IOCTL_PANTILT_RESET,0)<0){
+            perror("reset failed");
+            return;
+        }
+        printf("OK\n");
+        // stop_motion() may have sent its signal before this wait started
+        if(motion_quit(&app->motion)) return;
+        // Homing time from the driver motion model instead of a fixed 5 s
+        if(ioctl(app->fd_control,IOCTL_PANTILT_WAIT,10000)<0)
+            perror("wait for homing failed");
+        return;
+    }
+
+    struct pantilt_absolute a={.pan=c->pan,.tilt=c->tilt};
+    printf("Move request pan=%d tilt=%d\n",c->pan,c->tilt);
+    if(ioctl(app->fd_control,IOCTL_PANTILT_ABSOLUTE,&a)<0)
+        perror("pantilt move failed");
+    else
+        printf("Moved to pan=%d tilt=%d in %u steps\n",a.pan,a.tilt,a.steps);
+}
 
-    while(dpan!=0 || dtilt!=0){
-        int sp=clamp_step(dpan,4480);
-        int st=clamp_step(dtilt,1920);
+static void* motion_loop(void* arg)
+{
+    CameraApp* app=arg;
+    MotionQueue* q=&app->motion;
 
-        struct pantilt_relative r={.pan=sp,.tilt=st};
-        if(ioctl(app->fd_control,IOCTL_PANTILT_RELATIVE,&r)<0){
-            perror("pantilt step failed");
-            break;
+    pthread_mutex_lock(&q->lock);
+    for(;;){
+        while(!q->quit && q->pending.kind==MOTION_NONE)
+            pthread_cond_wait(&q->cond,&q->lock);
+        if(q->quit) break;
+
+        q->current=q->pending;
+        q->pending=q->after_reset;
+        q->after_reset.kind=MOTION_NONE;
+        MotionCmd c=q->current;
+        pthread_mutex_unlock(&q->lock);
+
+        motion_run(app,&c);
+
+        pthread_mutex_lock(&q->lock);
+        q->current.kind=MOTION_NONE;
+    }
+    pthread_mutex_unlock(&q->lock);
+    atomic_store(&q->done,true);
+    return NULL;
+}
+
+static bool start_motion(CameraApp* app)
+{
+    if(pthread_create(&app->motion.thread,NULL,motion_loop,app)!=0){
+        fprintf(stderr,"motion thread fail\n");
+        return false;
+    }
+    app->motion.started=true;
+    return true;
+}
+
+static void stop_motion(CameraApp* app)
+{
+    MotionQueue* q=&app->motion;
+    if(!q->started) return;
+
+    pthread_mutex_lock(&q->lock);
+    q->quit=true;
+    pthread_cond_signal(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+    // A move in progress is interrupted (the driver waits are interruptible):
+    // signal until the worker leaves, a single signal can land between two ioctls
+    while(!atomic_load(&q->done)){
+        pthread_kill(q->thread,WAKE_SIGNAL);
+        usleep(10000);
+    }
+    pthread_join(q->thread,NULL);
+    q->started=false;
+}
+
+// Copy the worker state for drawing; the position is read from the driver
+// every STATUS_UPDATE_INTERVAL while a command runs (and once after it).
+static void update_motion(CameraApp* app)
+{
+    MotionQueue* q=&app->motion;
+    bool was_busy=app->moving.kind!=MOTION_NONE;
+    uint32_t now=SDL_GetTicks();
+
+    pthread_mutex_lock(&q->lock);
+    app->moving=q->current;
+    app->queued=q->pending;
+    pthread_mutex_unlock(&q->lock);
+
+    bool busy=app->moving.kind!=MOTION_NONE || app->queued.kind!=MOTION_NONE;
+    if((busy && now-app->last_status_time>=STATUS_UPDATE_INTERVAL) || (was_busy && !busy)){
+        struct pantilt_position pos;
+        if(ioctl(app->fd_control,IOCTL_PANTILT_GET_POSITION,&pos)==0 && pos.valid){
+            app->pan=pos.pan;
+            app->tilt=pos.tilt;
         }
-        app->pan+=sp;
-        app->tilt+=st;
-        dpan-=sp;
-        dtilt-=st;
-        sleep(1);
+        app->last_status_time=now;
     }
 }
 
@@ -315,13 +596,13 @@ static void handle_events(CameraApp* app)
     SDL_Event e;
     while(SDL_PollEvent(&e)){
         switch(e.type){
-            case SDL_QUIT: app->running=false; break;
+            case SDL_QUIT: atomic_store(&app->running,false); break;
 
             case SDL_KEYDOWN:
                 switch(e.key.keysym.sym){
                 case SDLK_q:
                 case SDLK_ESCAPE:
-                    app->running=false; break;
+                    atomic_store(&app->running,false); break;
                 case SDLK_SPACE:
                     app->paused=!app->paused; break;
                 case SDLK_i:
@@ -385,9 +666,8 @@ static void handle_events(CameraApp* app)
                     SDL_StopTextInput();
                     app->pan_input_active=false;
                     app->tilt_input_active=false;
-                    int np=atoi(app->input_pan);
-                    int nt=atoi(app->input_tilt);
-                    move_to_new_center(app,np,nt);
+                    MotionCmd c={MOTION_MOVE,atoi(app->input_pan),atoi(app->input_tilt)};
+                    motion_post(&app->motion,c);
                 }
             } break;
         }
@@ -402,14 +682,25 @@ static bool init_devices(CameraApp* app)
     app->fd_control=open("/dev/camera_control",O_RDWR);
     if(app->fd_control<0){ perror("open control"); return false; }
 
-    printf("RESET... "); fflush(stdout);
-    if(ioctl(app->fd_control,IOCTL_PANTILT_RESET,0)<0)
-        perror("reset failed");
-    else
-        printf("OK\n");
-
-    sleep(5);
-    app->pan=0; app->tilt=0;
+    // Ranges of this camera, cached by the driver
+    if(ioctl(app->fd_control,IOCTL_PANTILT_GET_CAPS,&app->caps)<0){
+        perror("GET_CAPS failed, using the Orbit ranges");
+        app->caps.pan_min=PANTILT_PAN_MIN;   app->caps.pan_max=PANTILT_PAN_MAX;
+        app->caps.tilt_min=PANTILT_TILT_MIN; app->caps.tilt_max=PANTILT_TILT_MAX;
+    }
+    printf("Pan [%d, %d] tilt [%d, %d]\n",app->caps.pan_min,app->caps.pan_max,app->caps.tilt_min,app->caps.tilt_max);
+
+    // The driver keeps the position across runs: reset only when it is unknown
+    struct pantilt_position pos;
+    if(ioctl(app->fd_control,IOCTL_PANTILT_GET_POSITION,&pos)==0 && pos.valid){
+        printf("Position pan=%d tilt=%d, no reset needed\n",pos.pan,pos.tilt);
+        app->pan=pos.pan; app->tilt=pos.tilt;
+    }else{
+        // Homing on the worker: the video starts without waiting for it
+        MotionCmd c={MOTION_RESET,0,0};
+        motion_post(&app->motion,c);
+        app->pan=0; app->tilt=0;
+    }
 
     app->fd_stream=open("/dev/camera_stream",O_RDWR);
     if(app->fd_stream<0){ perror("open stream"); return false; }
@@ -457,6 +748,10 @@ static bool init_sdl(CameraApp* app)
 // =============================================================
 static void cleanup(CameraApp* app)
 {
+    stop_capture(app);
+    stop_motion(app);
+    tb_free(&app->tb);
+
     if(app->fd_stream>=0) ioctl(app->fd_stream,IOCTL_STREAMOFF,NULL);
     if(app->fd_stream>=0) close(app->fd_stream);
     if(app->fd_control>=0) close(app->fd_control);
@@ -476,28 +771,35 @@ static void cleanup(CameraApp* app)
 int main()
 {
     CameraApp app={0};
-    app.running=true;
+    atomic_store(&app.running,true);
+    app.fd_stream=-1;
+    app.fd_control=-1;
     strcpy(app.input_pan,"0");
     strcpy(app.input_tilt,"0");
+    pthread_mutex_init(&app.motion.lock,NULL);
+    pthread_cond_init(&app.motion.cond,NULL);
+    install_wake_signal();
 
-    if(!init_devices(&app)) return 1;
+    if(!init_devices(&app)){ cleanup(&app); return 1; }
     if(!init_sdl(&app)){ cleanup(&app); return 1; }
+    if(!tb_init(&app.tb)){ fprintf(stderr,"frame buffers fail\n"); cleanup(&app); return 1; }
 
-    uint8_t* buf=malloc(FRAME_SIZE);
     app.last_fps_time=SDL_GetTicks();
+    if(!start_capture(&app) || !start_motion(&app)){ cleanup(&app); return 1; }
 
     SDL_StartTextInput();
 
-    while(app.running){
+    while(atomic_load(&app.running)){
         handle_events(&app);
+        update_motion(&app);
 
-        if(!app.paused){
-            int r=read(app.fd_stream,buf,FRAME_SIZE);
-            if(r>0){
-                SDL_UpdateTexture(app.texture,NULL,buf,WIDTH*2);
-                update_fps(&app);
-            }
+        // Newest complete frame, if the capture thread published one since the last loop
+        bool fresh=!app.paused && tb_take(&app.tb);
+        if(fresh){
+            SDL_UpdateTexture(app.texture,NULL,app.tb.buf[app.tb.front],WIDTH*2);
+            app.rendered++;
         }
+        update_fps(&app);
 
         SDL_SetRenderDrawColor(app.renderer,0,0,0,255);
         SDL_RenderClear(app.renderer);
@@ -509,9 +811,11 @@ int main()
         draw_ui(&app);
 
         SDL_RenderPresent(app.renderer);
+
+        // Nothing new to show: do not spin, events are still handled every few ms
+        if(!fresh) SDL_Delay(2);
     }
 
-    free(buf);
     cleanup(&app);
     return 0;
 }
@@ -10,6 +10,11 @@
 #define  FRAME_SIZE_160x120          38400
 #define FRAME_SIZE_640x480          (640*480*2)  // 640*480*2
 
+// Wait until the driver reports the end of the pan/tilt motion
+static void wait_motion(int fd, int timeout_ms) {
+    if (ioctl(fd, IOCTL_PANTILT_WAIT, timeout_ms) < 0)
+        perror("IOCTL_PANTILT_WAIT failed");
+}
 
 int main() {
     int fd = open("/dev/camera_control", O_RDWR);
@@ -30,9 +35,9 @@ int main() {
     if (ioctl(fd, IOCTL_PANTILT_RESET, 0) < 0) {
         perror("IOCTL_PANTILT_RESET failed");
     } else {
-        printf("RESET sent successfully! (sleep 5s)\n");
+        printf("RESET sent successfully! (waiting for homing)\n");
     }
-    sleep(5);
+    wait_motion(fd, 10000);
     
     /*********************************************
     * STREAMON + READ FRAMES + STREAMOFF
@@ -105,7 +110,7 @@ int main() {
     } else {
         printf("Pan +4000 command sent!\n");
     }
-    sleep(2);
+    wait_motion(fd, 5000);
 
     printf("\nSending PAN_RELATIVE -4000...\n");
     rel.pan = -4000;
@@ -115,7 +120,7 @@ int main() {
     } else {
         printf("Pan -4000 command sent!\n");
     }
-    sleep(2);
+    wait_motion(fd, 5000);
 
     printf("\nSending TILT_RELATIVE = 1000...\n");
     rel.pan = 0;
@@ -125,7 +130,7 @@ int main() {
     } else {
         printf("tilt 1000 command sent!\n");
     }
-    sleep(2);
+    wait_motion(fd, 5000);
 
     printf("\nSending TILT_RELATIVE = -1000...\n");
     rel.pan = 0;
@@ -135,7 +140,7 @@ int main() {
     } else {
         printf("tilt -1000 command sent!\n");
     }
-    sleep(2);
+    wait_motion(fd, 5000);
 
     // /*********************************************
     //  * 6) SEND Pan = 4000 and tilt =1000
@@ -149,7 +154,7 @@ int main() {
     } else {
         printf("pan =4000 and tilt = 1000 command sent!\n");
     }
-    sleep(1);
+    wait_motion(fd, 5000);
 
     // /*********************************************
     //  * 7) SEND Pan = -4000 and tilt =-1000
@@ -162,7 +167,7 @@ int main() {
     } else {
         printf("pan = -4000 and tilt = -1000 command #1 sent!\n");
     }
-    sleep(1);
+    wait_motion(fd, 5000);
 
     /*********************************************
      * 8) SEND Pan = -4000 and tilt =-1000
@@ -173,7 +178,7 @@ int main() {
     } else {
         printf("pan =4000 and tilt = 1000 command #2 sent!\n");
     } 
-    sleep(1);
+    wait_motion(fd, 5000);
 
     
     close(fd);
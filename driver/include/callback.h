@@ -1,16 +1,83 @@
+// Kernel primitives replaced when built in user space (app/src/replay_bench.c)
+#ifndef __KERNEL__
+#include "uspace_compat.h"
+#endif
+
 //from usb_video.h
 #define STREAM_FID                  (1 << 0)
 #define STREAM_EOF                  (1 << 1)
+#define STREAM_STI                  (1 << 5)  // still image
 #define STREAM_ERR                  (1 << 6)
 
+#define BUF_STREAM_STOPPED          (1 << 4)  // STREAMOFF, read() returns -EIO until the next STREAMON
+#define BUF_STREAM_FAILED           (1 << 3)  // watchdog gave up, read() returns -EIO
 #define BUF_STREAM_FRAME_READ       (1 << 2)
 #define BUF_STREAM_READ             (1 << 1)
 #define BUF_STREAM_EOF              (1 << 0)
 
+// Geometry of the frame sent by the camera (YUYV, 2 bytes per pixel)
+#define FRAME_WIDTH                 640
+#define FRAME_HEIGHT                480
+#define FRAME_STRIDE                (FRAME_WIDTH*2)
+
+// Largest number of URBs of a stream (low-latency and adaptive profiles)
+#define URB_MAX                     32
+// Adaptive profile: smallest in-flight depth, and clean completions before parking one URB
+#define URB_ADAPT_MIN               4
+#define URB_ADAPT_IDLE_COMPLETIONS  512
+
+// Still image capture (IOCTL_STREAM_SNAPSHOT)
+#define STILL_IDLE                  0
+#define STILL_ARMED                 1  // trigger sent, waiting for the first still packet
+#define STILL_CAPTURING             2
+#define STILL_DONE                  3
+
 // Expected frame size for validation
 #define EXPECTED_FRAME_SIZE         (640*480*2)  // 640*480*2
 
 
+// Per-device streaming statistics, exported in the stats/ sysfs directory of
+// the streaming interface. Updated by the callback only, reset from sysfs.
+struct stream_stats {
+  uint64_t    packets;            // isochronous packets completed
+  uint64_t    bytes;              // payload bytes received (headers excluded)
+  uint32_t    iso_err_missed;     // -EXDEV / -ENOSR / -ECOMM: interval missed
+  uint32_t    iso_err_proto;      // -EPROTO / -EILSEQ: bit-stuffing or CRC error
+  uint32_t    iso_err_overflow;   // -EOVERFLOW: babble
+  uint32_t    iso_err_other;
+  uint32_t    urb_errors;         // whole URB completed with an error status
+  uint32_t    header_errors;      // invalid payload header or STREAM_ERR set
+  uint32_t    frames_completed;
+  uint32_t    frames_repaired;
+  uint32_t    frames_abandoned;
+  uint32_t    frames_oversize;    // more payload than EXPECTED_FRAME_SIZE
+  uint32_t    resubmit_failures;
+  uint32_t    recoveries;         // stream restarted (watchdog, reset, resume, re-enumeration)
+  uint32_t    fps_centi;          // delivered frames per second x100 (last 30 frames)
+  uint64_t    fps_window_ns;
+  uint32_t    fps_window_frames;
+};
+
+// log2 histogram of durations in microseconds, readable in debugfs.
+// Bucket 0 counts durations under 1 us, bucket n counts [2^(n-1), 2^n) us.
+#define LATENCY_HIST_BUCKETS        24
+
+struct latency_hist {
+  uint32_t    bucket[LATENCY_HIST_BUCKETS];
+  uint64_t    count;
+  uint64_t    max_ns;
+};
+
+static inline void latency_hist_add(struct latency_hist *hist, uint64_t ns) {
+    uint64_t us = div_u64(ns, NSEC_PER_USEC);
+    int      b  = us ? min(fls64(us), LATENCY_HIST_BUCKETS - 1) : 0;
+
+    hist->bucket[b]++;
+    hist->count++;
+    if (ns > hist->max_ns)
+        hist->max_ns = ns;
+}
+
 // Structure de Buffer du Pilote
 struct driver_buffer {
   struct completion   new_frame_start;
@@ -20,247 +87,819 @@ struct driver_buffer {
   uint8_t     Status;
   int8_t      LastFID;
   uint8_t    *Data;
+
+  // Source bytes received for the frame being assembled. Differs from
+  // BytesUsed as soon as a region of interest or an output mode is active.
+  uint32_t    SrcOffset;
+
+  // Region of interest and output mode applied while copying the payload.
+  // Roi/Output are used by the frame being assembled, the Pending values
+  // are latched at the next frame start.
+  spinlock_t         Lock;
+  struct stream_roi  Roi;
+  uint8_t            Output;
+  uint32_t           FrameSize;
+  struct stream_roi  PendingRoi;
+  uint8_t            PendingOutput;
+  uint8_t            ConfigPending;
+  uint8_t            Recovered;     // next frame gets FRAME_FLAG_RECOVERED
+
+  // Frame decimation: only every DeliverEvery-th frame is assembled, the
+  // others are recognized at FID toggle and their payload is never copied.
+  uint16_t           DeliverEvery;
+  uint32_t           FrameSeq;
+
+  // Frame handoff: the callback assembles into Data, swaps it with ReadyData
+  // when a frame is done, and read() swaps ReadyData with ReadData before
+  // copying. The callback never writes the buffer being copied to user space.
+  uint8_t           *ReadyData;
+  uint8_t           *ReadData;
+  uint32_t           ReadyBytes;
+  uint32_t           ReadBytes;
+
+  // Metadata of the frame being assembled, of the ready frame and of the
+  // frame returned by the last read()
+  struct frame_meta  Meta;
+  struct frame_meta  ReadyMeta;
+  struct frame_meta  LastMeta;
+
+  // Partial-frame delivery: lost packets are accounted for with the length of
+  // the last good payload so that the following data stays at its place.
+  uint8_t            Conceal;
+  uint8_t            ConcealMinPercent;
+  uint8_t            Damaged;
+  uint32_t           LastPayload;
+  // Packets lost just before a FID toggle may have been the first ones of the
+  // new frame: its payload is then shifted and cannot be repaired.
+  uint8_t            PrevLost;
+  uint8_t            HeadLost;
+  const uint8_t     *PrevData;
+  uint32_t           PrevSize;
+
+  // URB geometry. With the adaptive profile only InFlight URBs are submitted,
+  // the others wait in Parked until missed intervals call for more depth.
+  uint8_t            Profile;
+  uint8_t            UrbCount;
+  uint8_t            InFlight;
+  uint16_t           Packets;
+  uint32_t           PacketSize;
+  struct urb        *Parked[URB_MAX];
+  uint8_t            ParkedCount;
+  uint8_t            ResubmitFailed;
+  uint32_t           CleanCompletions;
+  uint32_t           GrowEvents;
+  uint32_t           ShrinkEvents;
+
+  struct stream_stats Stats;
+
+  // Time spent in complete_callback per URB (written by the callback), and
+  // time between frame delivery and its pickup by read() (written by read())
+  struct latency_hist CallbackHist;
+  struct latency_hist ReadLatencyHist;
+
+  // Still image: buffer attached by the snapshot ioctl while StillState is
+  // not STILL_IDLE. Under Lock (still packets are rare).
+  struct completion  still_done;
+  uint8_t           *StillData;
+  uint32_t           StillMax;
+  uint32_t           StillBytes;
+  uint8_t            StillState;
+  uint8_t            StillDamaged;
+
+  // Packet trace ring (optional, see the packet_trace module parameter).
+  // Single writer (the callback): the record is written, then TraceHead is
+  // published. Readers copy it without lock and check TraceHead afterwards.
+  struct packet_record *TraceRing;
+  unsigned long      TraceMask;
+  unsigned long      TraceHead;
 };
 
+// Bytes of a delivered frame for a given region of interest and output mode
+static inline uint32_t frame_out_size(const struct stream_roi *roi, uint8_t output) {
+    uint32_t pixels = (uint32_t)(roi->width / roi->decimation) * (roi->height / roi->decimation);
 
+    return (output == STREAM_OUTPUT_GREY) ? pixels : pixels * 2;
+}
 
-static void complete_callback(struct urb *urb) {
-    struct driver_buffer  *buffer = urb->context;
-    unsigned char *UrbPacketData;
-    unsigned int   UrbPacketLength;
-    unsigned int   MaxBufLength;
-    unsigned int   nbytes;
-    void          *BufData;
-    int            i, ret;
-    uint8_t        currentFID;
-    int            has_eof, has_fid_toggle;
-    int            frame_complete;
+// Region of interest covering the whole frame, no decimation
+static inline void frame_roi_full(struct stream_roi *roi) {
+    roi->x          = 0;
+    roi->y          = 0;
+    roi->width      = FRAME_WIDTH;
+    roi->height     = FRAME_HEIGHT;
+    roi->decimation = 1;
+    roi->frame_size = frame_out_size(roi, STREAM_OUTPUT_YUYV);
+}
 
-    // Debug counters
-    static int packet_count = 0;
-    // static int frame_count = 0;
-    static int abandoned_count = 0;
+static inline int frame_roi_is_full(const struct stream_roi *roi) {
+    return roi->width == FRAME_WIDTH && roi->height == FRAME_HEIGHT && roi->decimation == 1;
+}
 
-    // Debug counters - KEEP these for FPS tracking
-    static int frame_count = 0;
-    static unsigned long last_time = 0;
-    
-    // Only process successful URBs or resubmit on recoverable errors
-    if (urb->status != 0) {
-        if (urb->status != -ENOENT && urb->status != -ECONNRESET && urb->status != -ESHUTDOWN) {
-            ret = usb_submit_urb(urb, GFP_ATOMIC);
-            if (ret < 0) {
-                printk(KERN_WARNING "ELE784 -> (%s) : Resubmit URB error => ret = %d\n", __FUNCTION__, ret);
+// Output position of byte k (Y0 U Y1 V) of output macropixel omp of output row.
+// Returns -1 for bytes dropped by the output mode.
+static inline int32_t frame_out_index(const struct driver_buffer *buffer, uint32_t row,
+                                      uint32_t omp, uint32_t k) {
+    uint32_t ow = buffer->Roi.width / buffer->Roi.decimation;
+    uint32_t oh = buffer->Roi.height / buffer->Roi.decimation;
+
+    switch (buffer->Output) {
+    case STREAM_OUTPUT_GREY:
+        return (k & 1) ? -1 : (int32_t)(row * ow + omp * 2 + k / 2);
+    case STREAM_OUTPUT_YUV422P:
+        if (!(k & 1))
+            return row * ow + omp * 2 + k / 2;
+        if (k == 1)
+            return ow * oh + row * (ow / 2) + omp;
+        return ow * oh + (ow / 2) * oh + row * (ow / 2) + omp;
+    default:
+        return row * ow * 2 + omp * 4 + k;
+    }
+}
+
+// De-interleave whole macropixel pairs (Y0 U0 Y1 V0 Y2 U1 Y3 V1) eight bytes at
+// a time using 64-bit word operations. Deliberately scalar, not SIMD: this runs
+// in the URB completion (interrupt context), where the vector registers cannot
+// be used without kernel_fpu_begin(). Returns the number of source bytes consumed.
+static uint32_t frame_deinterleave(struct driver_buffer *buffer, const uint8_t *src,
+                                   uint32_t row, uint32_t omp, uint32_t len) {
+    uint32_t ow = buffer->Roi.width / buffer->Roi.decimation;
+    uint32_t oh = buffer->Roi.height / buffer->Roi.decimation;
+    uint8_t *y  = buffer->Data + row * ow + omp * 2;
+    uint8_t *u  = buffer->Data + ow * oh + row * (ow / 2) + omp;
+    uint8_t *v  = u + (ow / 2) * oh;
+    uint32_t done = 0;
+    uint64_t w, c;
+    uint32_t y4, uv;
+    uint16_t u2, v2;
+
+    for (; done + 8 <= len; done += 8) {
+        memcpy(&w, src + done, 8);
+        w = le64_to_cpu(w);
+
+        // Y bytes sit at even positions: gather them into 32 bits
+        c  = w & 0x00FF00FF00FF00FFULL;
+        c  = (c | (c >> 8))  & 0x0000FFFF0000FFFFULL;
+        y4 = cpu_to_le32((uint32_t)(c | (c >> 16)));
+        memcpy(y, &y4, 4);
+        y += 4;
+
+        if (buffer->Output != STREAM_OUTPUT_YUV422P)
+            continue;
+
+        // U0 V0 U1 V1 sit at odd positions
+        c  = (w >> 8) & 0x00FF00FF00FF00FFULL;
+        c  = (c | (c >> 8))  & 0x0000FFFF0000FFFFULL;
+        uv = (uint32_t)(c | (c >> 16));
+        u2 = cpu_to_le16((uint16_t)((uv & 0xFF) | ((uv >> 8) & 0xFF00)));
+        v2 = cpu_to_le16((uint16_t)(((uv >> 8) & 0xFF) | ((uv >> 16) & 0xFF00)));
+        memcpy(u, &u2, 2);
+        memcpy(v, &v2, 2);
+        u += 2;
+        v += 2;
+    }
+    return done;
+}
+
+// Copy one line segment of the source frame into the region of interest.
+// Only lines and macropixels (4 bytes = 2 pixels) kept by the decimation are written.
+// With src == NULL the same output bytes are filled from prev, or zeroed.
+static void frame_emit_line(struct driver_buffer *buffer, const uint8_t *src, const uint8_t *prev,
+                            uint32_t line, uint32_t col, uint32_t run) {
+    const struct stream_roi *roi = &buffer->Roi;
+    uint32_t d  = roi->decimation;
+    uint32_t x0 = roi->x * 2;
+    uint32_t x1 = (roi->x + roi->width) * 2;
+    uint32_t start, end, b, mp, n, row, pos;
+    int32_t  idx;
+
+    if (line < roi->y || line >= roi->y + roi->height || (line - roi->y) % d)
+        return;
+
+    start = max(col, x0);
+    end   = min(col + run, x1);
+    if (start >= end)
+        return;
+
+    row = (line - roi->y) / d;
+    if (src)
+        src += start - col;
+
+    if (d == 1 && buffer->Output == STREAM_OUTPUT_YUYV) {
+        pos = row * (roi->width * 2) + (start - x0);
+        if (src)
+            memcpy(buffer->Data + pos, src, end - start);
+        else if (prev)
+            memcpy(buffer->Data + pos, prev + pos, end - start);
+        else
+            memset(buffer->Data + pos, 0, end - start);
+        return;
+    }
+
+    for (b = start; b < end; ) {
+        mp = (b - x0) / 4;
+        if (mp % d) {
+            // jump to the next macropixel kept by the decimation
+            b = x0 + (mp / d + 1) * d * 4;
+            continue;
+        }
+        if (src && d == 1 && (b - x0) % 4 == 0 && buffer->Output != STREAM_OUTPUT_YUYV) {
+            n = frame_deinterleave(buffer, src + (b - start), row, mp, end - b);
+            if (n) {
+                b += n;
+                continue;
             }
         }
+        n = min(end, x0 + mp * 4 + 4);
+        for (; b < n; b++) {
+            idx = frame_out_index(buffer, row, mp / d, (b - x0) % 4);
+            if (idx < 0)
+                continue;
+            buffer->Data[idx] = src ? src[b - start] : (prev ? prev[idx] : 0);
+        }
+    }
+}
+
+// Walk a source byte range of the frame line by line through the region of interest
+static void frame_walk(struct driver_buffer *buffer, const uint8_t *src, const uint8_t *prev,
+                       uint32_t off, uint32_t len) {
+    uint32_t line, col, run;
+
+    while (len > 0 && off < EXPECTED_FRAME_SIZE) {
+        line = off / FRAME_STRIDE;
+        col  = off % FRAME_STRIDE;
+        run  = min(len, FRAME_STRIDE - col);
+        frame_emit_line(buffer, src, prev, line, col, run);
+        if (src)
+            src += run;
+        off += run;
+        len -= run;
+    }
+}
+
+// Copy the payload of one packet into the frame buffer.
+// Without a region of interest or output mode this is a straight memcpy, as before.
+static void frame_copy_payload(struct driver_buffer *buffer, const uint8_t *src, uint32_t len) {
+    uint32_t off = buffer->SrcOffset;
+    uint32_t nbytes;
+
+    buffer->SrcOffset += len;
+    buffer->Meta.bytes_received += len;
+
+    if (frame_roi_is_full(&buffer->Roi) && buffer->Output == STREAM_OUTPUT_YUYV) {
+        if (off >= buffer->MaxLength)
+            return;
+        nbytes = min(len, buffer->MaxLength - off);
+        memcpy(buffer->Data + off, src, nbytes);
+        buffer->BytesUsed = off + nbytes;
         return;
     }
 
-    // Process all packets in this URB
-    for (i = 0; i < urb->number_of_packets; ++i) {
+    frame_walk(buffer, src, NULL, off, len);
+    buffer->BytesUsed = buffer->FrameSize;
+}
 
-        // Skip packets with errors
-        if (urb->iso_frame_desc[i].status < 0)
-            continue;
+// Reset the assembly state for a new frame and latch a pending region of interest / output mode
+static void frame_start(struct driver_buffer *buffer) {
+    uint8_t recovered;
 
-        UrbPacketData = urb->transfer_buffer + urb->iso_frame_desc[i].offset;
-        UrbPacketLength = urb->iso_frame_desc[i].actual_length;
-        
-        // Validate packet has minimum header
-        if (UrbPacketLength < 2 || UrbPacketData[0] < 2 || UrbPacketData[0] > UrbPacketLength)
-            continue;
+    spin_lock(&buffer->Lock);
+    if (buffer->ConfigPending) {
+        buffer->Roi = buffer->PendingRoi;
+        buffer->Output = buffer->PendingOutput;
+        buffer->FrameSize = frame_out_size(&buffer->Roi, buffer->Output);
+        buffer->ConfigPending = 0;
+    }
+    recovered = buffer->Recovered;
+    buffer->Recovered = 0;
+    spin_unlock(&buffer->Lock);
 
-        // Skip packets with stream errors
-        if (UrbPacketData[1] & STREAM_ERR)
-            continue;
+    buffer->BytesUsed = 0;
+    buffer->SrcOffset = 0;
+    buffer->Damaged   = 0;
+    buffer->HeadLost  = buffer->PrevLost;
+    memset(&buffer->Meta, 0, sizeof(buffer->Meta));
+    buffer->Meta.sequence = buffer->FrameSeq;
+    if (recovered)
+        buffer->Meta.flags |= FRAME_FLAG_RECOVERED;
+    trace_orbit_frame_start(buffer->FrameSeq);
+}
 
-        currentFID = UrbPacketData[1] & STREAM_FID;
-        has_eof = UrbPacketData[1] & STREAM_EOF;
-        has_fid_toggle = (buffer->LastFID != currentFID);
-        
-        // Debug: Log important packets
-        packet_count++;
-        // if (has_eof || has_fid_toggle || packet_count <= 50) {
-        //     printk(KERN_INFO "ELE784 -> [Pkt %d] FID=%d LastFID=%d Toggle=%d EOF=%d Len=%u BytesUsed=%u Status=0x%02x\n",
-        //            packet_count,
-        //            currentFID,
-        //            buffer->LastFID,
-        //            has_fid_toggle,
-        //            has_eof,
-        //            UrbPacketLength,
-        //            buffer->BytesUsed,
-        //            buffer->Status);
-        // }
+// Record a damaged source byte range of the frame being assembled
+static void frame_mark_damage(struct driver_buffer *buffer, uint32_t off, uint32_t len) {
+    struct frame_meta   *meta = &buffer->Meta;
+    struct frame_damage *last;
 
-        // =====================================================
-        // Handle packets with BOTH FID toggle AND EOF
-        // These are frame boundary markers
-        // =====================================================
-        if (has_eof && has_fid_toggle) {
-            printk(KERN_INFO "ELE784 -> [CASE 1] FID+EOF packet detected\n");
-            
-            // Copy packet data if actively capturing
-            if (buffer->Status & BUF_STREAM_FRAME_READ) {
-                UrbPacketLength -= UrbPacketData[0];
-                MaxBufLength = buffer->MaxLength - buffer->BytesUsed;
-                // printk(KERN_INFO "ELE784 -> [CASE 1] Payload=%u, Space=%u\n", UrbPacketLength, MaxBufLength);
-                
-                if (MaxBufLength > 0) {
-                    nbytes = min(UrbPacketLength, MaxBufLength);
-                    BufData = buffer->Data + buffer->BytesUsed;
-                    memcpy(BufData, UrbPacketData + UrbPacketData[0], nbytes);
-                    buffer->BytesUsed += nbytes;
-                    // printk(KERN_INFO "ELE784 -> [CASE 1] Copied %u bytes, BytesUsed now %u\n", nbytes, buffer->BytesUsed);
-                }
-                
-                // VALIDATE frame size before marking complete
-                frame_complete = (buffer->BytesUsed >= EXPECTED_FRAME_SIZE);
-                
-                if (frame_complete) {
-                    // Frame is complete - mark as done
-                    buffer->Status |= BUF_STREAM_EOF;
-                    buffer->Status &= ~BUF_STREAM_FRAME_READ;
-                    
-                    frame_count++;
-                    // printk(KERN_INFO "ELE784 -> [CASE 1] Frame #%d COMPLETE: %u bytes, Status=0x%02x\n",
-                    //        frame_count, buffer->BytesUsed, buffer->Status);
-                    // FPS counter - print every second
-                    if (frame_count % 30 == 0) {
-                        unsigned long now = jiffies;
-                        if (last_time != 0) {
-                            unsigned long diff = (now - last_time) * 1000 / HZ;
-                            printk(KERN_INFO "ELE784 -> 30 frames in %lu ms (~%lu FPS)\n", diff, 30000 / diff);
-                        }
-                        last_time = now;
-                    }
-                    complete(&(buffer->urb_completion));
-                } else {
-                    // Frame is NOT complete - ignore premature EOF
-                    // printk(KERN_WARNING "ELE784 -> [CASE 1] IGNORING premature EOF (FID+EOF): %u/%u bytes\n",
-                    //        buffer->BytesUsed, EXPECTED_FRAME_SIZE);
-                }
+    buffer->Damaged = 1;
+    if (off >= EXPECTED_FRAME_SIZE || len == 0)
+        return;
+    len = min(len, EXPECTED_FRAME_SIZE - off);
+
+    if (meta->damage_count > 0) {
+        last = &meta->damage[min(meta->damage_count, (uint32_t)FRAME_META_MAX_DAMAGE) - 1];
+        if (last->offset + last->length == off) {
+            last->length += len;
+            return;
+        }
+    }
+    if (meta->damage_count < FRAME_META_MAX_DAMAGE) {
+        meta->damage[meta->damage_count].offset = off;
+        meta->damage[meta->damage_count].length = len;
+    } else {
+        // out of slots: widen the last range so that it covers this one
+        last = &meta->damage[FRAME_META_MAX_DAMAGE - 1];
+        last->length = off + len - last->offset;
+    }
+    meta->damage_count++;
+}
+
+// A packet of the frame being assembled was lost: skip its estimated length so
+// that the following payload still lands at its place in the frame.
+static void frame_lose_packet(struct driver_buffer *buffer) {
+    if (buffer->StillState == STILL_CAPTURING)
+        buffer->StillDamaged = 1;
+    buffer->PrevLost = 1;
+    if (!(buffer->Status & BUF_STREAM_FRAME_READ))
+        return;
+    frame_mark_damage(buffer, buffer->SrcOffset, buffer->LastPayload);
+    buffer->SrcOffset += buffer->LastPayload;
+}
+
+// Hand the assembled frame over to read() and wake it up
+static void frame_deliver(struct driver_buffer *buffer, uint32_t flags) {
+    uint8_t *tmp;
+
+    buffer->Meta.flags |= flags;
+    buffer->Meta.timestamp_ns = ktime_get_ns();
+
+    if (flags & FRAME_FLAG_COMPLETE)
+        buffer->Stats.frames_completed++;
+    else
+        buffer->Stats.frames_repaired++;
+    if (buffer->SrcOffset > EXPECTED_FRAME_SIZE)
+        buffer->Stats.frames_oversize++;
+
+    trace_orbit_frame_complete(buffer->Meta.sequence, buffer->BytesUsed, buffer->Meta.flags);
+
+    spin_lock(&buffer->Lock);
+    tmp = buffer->ReadyData;
+    buffer->ReadyData  = buffer->Data;
+    buffer->Data       = tmp;
+    buffer->ReadyBytes = buffer->BytesUsed;
+    buffer->ReadyMeta  = buffer->Meta;
+    buffer->Status |= BUF_STREAM_EOF;
+    buffer->Status &= ~BUF_STREAM_FRAME_READ;
+    spin_unlock(&buffer->Lock);
+
+    // Source for "previous frame" concealment (never the buffer being assembled)
+    buffer->PrevData = buffer->ReadyData;
+    buffer->PrevSize = buffer->ReadyBytes;
+
+    complete(&(buffer->urb_completion));
+}
+
+// Conceal the damaged ranges of an incomplete frame and deliver it.
+// Returns 0 when the frame must be dropped instead.
+static int frame_repair(struct driver_buffer *buffer) {
+    const uint8_t *prev = NULL;
+    uint32_t i, n, off, len;
+
+    if (buffer->Conceal == STREAM_CONCEAL_DROP)
+        return 0;
+    if ((uint64_t)buffer->Meta.bytes_received * 100 < (uint64_t)EXPECTED_FRAME_SIZE * buffer->ConcealMinPercent)
+        return 0;
+    // Start of the frame lost: unless it still adds up, nothing is at its place
+    if (buffer->HeadLost && buffer->SrcOffset != EXPECTED_FRAME_SIZE)
+        return 0;
+
+    // Whatever did not arrive before the end of the frame is damaged too
+    if (buffer->SrcOffset < EXPECTED_FRAME_SIZE)
+        frame_mark_damage(buffer, buffer->SrcOffset, EXPECTED_FRAME_SIZE - buffer->SrcOffset);
+
+    if (buffer->Conceal == STREAM_CONCEAL_PREVIOUS && buffer->PrevSize == buffer->FrameSize)
+        prev = buffer->PrevData;
+
+    // STREAM_CONCEAL_MARK leaves the damaged bytes as they are, the map tells where they are
+    n = (buffer->Conceal == STREAM_CONCEAL_MARK) ? 0 : min(buffer->Meta.damage_count, (uint32_t)FRAME_META_MAX_DAMAGE);
+    for (i = 0; i < n; i++) {
+        off = buffer->Meta.damage[i].offset;
+        len = buffer->Meta.damage[i].length;
+        if (frame_roi_is_full(&buffer->Roi) && buffer->Output == STREAM_OUTPUT_YUYV) {
+            if (off >= buffer->MaxLength)
+                continue;
+            len = min(len, buffer->MaxLength - off);
+            if (prev)
+                memcpy(buffer->Data + off, prev + off, len);
+            else
+                memset(buffer->Data + off, 0, len);
+        } else {
+            frame_walk(buffer, NULL, prev, off, len);
+        }
+    }
+
+    buffer->BytesUsed = min(buffer->FrameSize, buffer->MaxLength);
+    frame_deliver(buffer, FRAME_FLAG_REPAIRED);
+    return 1;
+}
+
+// Record one isochronous packet in the trace ring
+static inline void packet_trace_add(struct driver_buffer *buffer, struct urb *urb, int i, uint64_t now) {
+    struct usb_iso_packet_descriptor *desc = &urb->iso_frame_desc[i];
+    struct packet_record *rec = &buffer->TraceRing[buffer->TraceHead & buffer->TraceMask];
+    const uint8_t *hdr = urb->transfer_buffer + desc->offset;
+
+    rec->timestamp_ns  = now;
+    rec->status        = desc->status;
+    rec->actual_length = desc->actual_length;
+    rec->index         = i;
+    if (desc->status == 0 && desc->actual_length >= 2) {
+        rec->header_len   = hdr[0];
+        rec->header_flags = hdr[1];
+    } else {
+        rec->header_len   = PACKET_HDR_NONE;
+        rec->header_flags = 0;
+    }
+    smp_store_release(&buffer->TraceHead, buffer->TraceHead + 1);
+}
+
+// Copy one packet of a still image into the snapshot buffer, if one is waiting
+static void still_packet(struct driver_buffer *buffer, const uint8_t *pkt, uint32_t len, int has_eof) {
+    uint32_t n;
+
+    spin_lock(&buffer->Lock);
+    if (buffer->StillState == STILL_ARMED) {
+        buffer->StillState = STILL_CAPTURING;
+        buffer->StillBytes = 0;
+    }
+    if (buffer->StillState == STILL_CAPTURING) {
+        n = min(len - pkt[0], buffer->StillMax - buffer->StillBytes);
+        memcpy(buffer->StillData + buffer->StillBytes, pkt + pkt[0], n);
+        buffer->StillBytes += n;
+        if (has_eof) {
+            buffer->StillState = STILL_DONE;
+            complete(&buffer->still_done);
+        }
+    }
+    spin_unlock(&buffer->Lock);
+}
+
+// Packet statuses reporting that an isochronous interval was missed
+static inline int urb_missed_interval(int status) {
+    return status == -EXDEV || status == -ENOSR || status == -ECOMM;
+}
+
+// FPS counter - updated (and printed) every 30 delivered frames
+static void frame_fps_tick(struct driver_buffer *buffer) {
+    struct stream_stats *st = &buffer->Stats;
+    uint64_t now, diff;
+
+    if (++st->fps_window_frames < 30)
+        return;
+
+    now = ktime_get_ns();
+    if (st->fps_window_ns != 0) {
+        diff = now - st->fps_window_ns;
+        st->fps_centi = (uint32_t)div64_u64(30ULL * 100 * NSEC_PER_SEC, diff);
+        ele784_dbg("ELE784 -> 30 frames in %llu ms (~%u FPS)\n",
+               div64_u64(diff, NSEC_PER_MSEC), st->fps_centi / 100);
+    }
+    st->fps_window_ns = now;
+    st->fps_window_frames = 0;
+}
+
+// Account a packet completed with an error status
+static void stats_iso_error(struct stream_stats *st, int status) {
+    if (urb_missed_interval(status))
+        st->iso_err_missed++;
+    else if (status == -EPROTO || status == -EILSEQ)
+        st->iso_err_proto++;
+    else if (status == -EOVERFLOW)
+        st->iso_err_overflow++;
+    else
+        st->iso_err_other++;
+}
+
+// Adaptive profile: grow the in-flight depth when intervals are missed or a
+// resubmission failed, park one URB after a long clean period.
+// Returns 1 when urb was parked and must not be resubmitted.
+static int urb_adapt(struct driver_buffer *buffer, struct urb *urb, int missed) {
+    struct urb *extra = NULL;
+    int parked = 0;
+
+    spin_lock(&buffer->Lock);
+    if (missed || buffer->ResubmitFailed) {
+        buffer->ResubmitFailed = 0;
+        buffer->CleanCompletions = 0;
+        if (buffer->ParkedCount > 0) {
+            extra = buffer->Parked[--buffer->ParkedCount];
+            buffer->InFlight++;
+            buffer->GrowEvents++;
+        }
+    } else if (++buffer->CleanCompletions >= URB_ADAPT_IDLE_COMPLETIONS && buffer->InFlight > URB_ADAPT_MIN) {
+        buffer->CleanCompletions = 0;
+        buffer->Parked[buffer->ParkedCount++] = urb;
+        buffer->InFlight--;
+        buffer->ShrinkEvents++;
+        parked = 1;
+    }
+    spin_unlock(&buffer->Lock);
+
+    if (extra && usb_submit_urb(extra, GFP_ATOMIC) < 0) {
+        spin_lock(&buffer->Lock);
+        buffer->Parked[buffer->ParkedCount++] = extra;
+        buffer->InFlight--;
+        spin_unlock(&buffer->Lock);
+    }
+    return parked;
+}
+
+// Parse one isochronous packet and advance the frame assembly state machine.
+// Independent of the URB: also built in user space by app/src/replay_bench.c.
+// Returns 1 when the packet reports a missed interval.
+static int stream_packet(struct driver_buffer *buffer, const uint8_t *UrbPacketData,
+                         unsigned int UrbPacketLength, int status) {
+    uint8_t        currentFID;
+    int            has_eof, has_fid_toggle;
+    int            frame_complete;
+
+    // Packets with errors are lost: keep the rest of the frame at its place
+    if (status < 0) {
+        stats_iso_error(&buffer->Stats, status);
+        frame_lose_packet(buffer);
+        return urb_missed_interval(status);
+    }
+
+    // Nothing sent during this interval
+    if (UrbPacketLength == 0)
+        return 0;
+    
+    // Validate packet has minimum header
+    if (UrbPacketLength < 2 || UrbPacketData[0] < 2 || UrbPacketData[0] > UrbPacketLength) {
+        buffer->Stats.header_errors++;
+        frame_lose_packet(buffer);
+        return 0;
+    }
+
+    // Skip packets with stream errors
+    if (UrbPacketData[1] & STREAM_ERR) {
+        buffer->Stats.header_errors++;
+        frame_lose_packet(buffer);
+        return 0;
+    }
+
+    currentFID = UrbPacketData[1] & STREAM_FID;
+    has_eof = UrbPacketData[1] & STREAM_EOF;
+    has_fid_toggle = (buffer->LastFID != currentFID);
+
+    // =====================================================
+    // Still image: sent between two preview frames, assembled apart
+    // =====================================================
+    if (UrbPacketData[1] & STREAM_STI) {
+        // The preview frame in progress ended here
+        if (has_fid_toggle && (buffer->Status & BUF_STREAM_FRAME_READ)) {
+            if (frame_repair(buffer)) {
+                frame_fps_tick(buffer);
+            } else {
+                buffer->Stats.frames_abandoned++;
+                buffer->Status &= ~BUF_STREAM_FRAME_READ;
             }
+        }
+        buffer->LastFID = currentFID;
+        buffer->PrevLost = 0;
+        buffer->Stats.bytes += UrbPacketLength - UrbPacketData[0];
+        still_packet(buffer, UrbPacketData, UrbPacketLength, has_eof);
+        return 0;
+    }
+
+    // Remember the usual payload length to size the gap left by a lost packet
+    if (!has_eof && UrbPacketLength > UrbPacketData[0])
+        buffer->LastPayload = UrbPacketLength - UrbPacketData[0];
+    
+    buffer->Stats.bytes += UrbPacketLength - UrbPacketData[0];
+
+    // Debug: Log important packets
+    // if (has_eof || has_fid_toggle || buffer->Stats.packets <= 50) {
+    //     printk(KERN_INFO "ELE784 -> [Pkt %llu] FID=%d LastFID=%d Toggle=%d EOF=%d Len=%u BytesUsed=%u Status=0x%02x\n",
+    //            buffer->Stats.packets,
+    //            currentFID,
+    //            buffer->LastFID,
+    //            has_fid_toggle,
+    //            has_eof,
+    //            UrbPacketLength,
+    //            buffer->BytesUsed,
+    //            buffer->Status);
+    // }
+
+    // =====================================================
+    // Handle packets with BOTH FID toggle AND EOF
+    // These are frame boundary markers
+    // =====================================================
+    if (has_eof && has_fid_toggle) {
+        ele784_dbg("ELE784 -> [CASE 1] FID+EOF packet detected\n");
+        
+        // Copy packet data if actively capturing
+        if (buffer->Status & BUF_STREAM_FRAME_READ) {
+            UrbPacketLength -= UrbPacketData[0];
+            frame_copy_payload(buffer, UrbPacketData + UrbPacketData[0], UrbPacketLength);
             
-            // Update LastFID regardless
-            buffer->LastFID = currentFID;
-            // printk(KERN_INFO "ELE784 -> [CASE 1] Updated LastFID to %d\n", currentFID);
+            // VALIDATE frame size before marking complete
+            frame_complete = (buffer->SrcOffset >= EXPECTED_FRAME_SIZE) && !buffer->Damaged;
             
-            // Skip further processing
-            continue;
+            if (frame_complete) {
+                // Frame is complete - hand it over to read()
+                frame_deliver(buffer, FRAME_FLAG_COMPLETE);
+                frame_fps_tick(buffer);
+            } else if (buffer->Damaged && frame_repair(buffer)) {
+                // Lost packets concealed, frame delivered as repaired
+                frame_fps_tick(buffer);
+            } else if (buffer->Damaged || buffer->HeadLost) {
+                // Lost packets and not repairable: the frame ends here all the same
+                buffer->Stats.frames_abandoned++;
+                buffer->Status &= ~BUF_STREAM_FRAME_READ;
+            } else {
+                // Frame is NOT complete - ignore premature EOF
+                // printk(KERN_WARNING "ELE784 -> [CASE 1] IGNORING premature EOF (FID+EOF): %u/%u bytes\n",
+                //        buffer->BytesUsed, EXPECTED_FRAME_SIZE);
+            }
         }
+        
+        // Update LastFID regardless
+        buffer->LastFID = currentFID;
+        // printk(KERN_INFO "ELE784 -> [CASE 1] Updated LastFID to %d\n", currentFID);
+        
+        // Skip further processing
+        return 0;
+    }
+
+    // =====================================================
+    // Handle FID toggle (NEW frame detection)
+    // CRITICAL: If we're currently capturing, deliver it repaired or abandon it!
+    // =====================================================
+    if (has_fid_toggle) {
+        // printk(KERN_INFO "ELE784 -> [CASE 2] FID toggle detected: %d -> %d\n", buffer->LastFID, currentFID);
 
-        // =====================================================
-        // Handle FID toggle (NEW frame detection)
-        // CRITICAL: If we're currently capturing, abandon it!
-        // =====================================================
-        if (has_fid_toggle) {
-            // printk(KERN_INFO "ELE784 -> [CASE 2] FID toggle detected: %d -> %d\n", buffer->LastFID, currentFID);
-
-            // If we were capturing a frame, abandon it (FID changed = new frame started)
-            if (buffer->Status & BUF_STREAM_FRAME_READ) {
-                abandoned_count++;
-                // printk(KERN_WARNING "ELE784 -> [CASE 2] ABANDONING incomplete frame: %u bytes (abandoned count: %d)\n",
-                //        buffer->BytesUsed, abandoned_count);
+        // If we were capturing a frame, it ended short (FID changed = new frame started)
+        if (buffer->Status & BUF_STREAM_FRAME_READ) {
+            if (frame_repair(buffer)) {
+                frame_fps_tick(buffer);
+            } else {
+                buffer->Stats.frames_abandoned++;
+                // printk(KERN_WARNING "ELE784 -> [CASE 2] ABANDONING incomplete frame: %u bytes (abandoned count: %u)\n",
+                //        buffer->BytesUsed, buffer->Stats.frames_abandoned);
                 
                 // Clear the FRAME_READ flag to stop capturing the old frame
                 buffer->Status &= ~BUF_STREAM_FRAME_READ;
             }
-
-            buffer->LastFID = currentFID;
-            
-            // Only start NEW frame if ready and not already capturing
-            if ((buffer->Status & BUF_STREAM_READ) && !(buffer->Status & BUF_STREAM_FRAME_READ)) {
-                // printk(KERN_INFO "ELE784 -> [CASE 2] Starting new frame\n");
-                
-                // Reset for new frame
-                buffer->BytesUsed = 0;
-                buffer->Status &= ~BUF_STREAM_EOF;
-                buffer->Status |= BUF_STREAM_FRAME_READ;
-                
-                complete(&(buffer->new_frame_start));
-                // printk(KERN_INFO "ELE784 -> Frame START (FID=%d)\n", currentFID);
-            } 
-            // else {
-            //     printk(KERN_INFO "ELE784 -> [CASE 2] NOT starting frame: READ=%d FRAME_READ=%d\n",
-            //            !!(buffer->Status & BUF_STREAM_READ),
-            //            !!(buffer->Status & BUF_STREAM_FRAME_READ));  
-            // }
         }
 
-        // =====================================================
-        // Copy payload data (only if actively capturing)
-        // =====================================================
-        if (buffer->Status & BUF_STREAM_FRAME_READ) {
-            // Calculate payload size
-            UrbPacketLength -= UrbPacketData[0];
+        buffer->LastFID = currentFID;
+
+        // Frame decimation: skipped frames are never started, so none of their payload is copied
+        buffer->FrameSeq++;
+        if (buffer->DeliverEvery > 1 && (buffer->FrameSeq % buffer->DeliverEvery) != 0) {
+            // This packet arrived: a loss before it must not mark the next kept frame
+            buffer->PrevLost = 0;
+            return 0;
+        }
+        
+        // Only start NEW frame if ready and not already capturing
+        if ((buffer->Status & BUF_STREAM_READ) && !(buffer->Status & BUF_STREAM_FRAME_READ)) {
+            // printk(KERN_INFO "ELE784 -> [CASE 2] Starting new frame\n");
             
-            // Calculate available space
-            MaxBufLength = buffer->MaxLength - buffer->BytesUsed;
+            // Reset for new frame (a frame waiting for read() stays in ReadyData)
+            frame_start(buffer);
+            buffer->Status |= BUF_STREAM_FRAME_READ;
             
-            // Copy data if space available
-            if (MaxBufLength > 0) {
-                nbytes = min(UrbPacketLength, MaxBufLength);
-                BufData = buffer->Data + buffer->BytesUsed;
-                memcpy(BufData, UrbPacketData + UrbPacketData[0], nbytes);
-                buffer->BytesUsed += nbytes;
-           
-                // Debug: Log data copy for first packets or EOF packets
-                // if (packet_count <= 50 || has_eof) {
-                //     printk(KERN_INFO "ELE784 -> [DATA] Copied %u bytes, BytesUsed now %u\n", nbytes, buffer->BytesUsed);
-                // }           
-            } 
-            // else if (packet_count <= 100) {
-            //     printk(KERN_WARNING "ELE784 -> [DATA] Buffer full! BytesUsed=%u, MaxLength=%u\n", 
-            //            buffer->BytesUsed, buffer->MaxLength);
-            // }
-        }
+            complete(&(buffer->new_frame_start));
+            // printk(KERN_INFO "ELE784 -> Frame START (FID=%d)\n", currentFID);
+        } 
+        // else {
+        //     printk(KERN_INFO "ELE784 -> [CASE 2] NOT starting frame: READ=%d FRAME_READ=%d\n",
+        //            !!(buffer->Status & BUF_STREAM_READ),
+        //            !!(buffer->Status & BUF_STREAM_FRAME_READ));  
+        // }
+    }
+
+    // =====================================================
+    // Copy payload data (only if actively capturing)
+    // =====================================================
+    buffer->PrevLost = 0;
+    if (buffer->Status & BUF_STREAM_FRAME_READ) {
+        // Calculate payload size
+        UrbPacketLength -= UrbPacketData[0];
+        
+        // Copy (and crop / decimate) the payload into the frame buffer
+        frame_copy_payload(buffer, UrbPacketData + UrbPacketData[0], UrbPacketLength);
+    }
 
-        // =====================================================
-        // Handle EOF (without FID toggle)
-        // CRITICAL: Validate frame size before accepting EOF
-        // =====================================================
-        if (has_eof && !has_fid_toggle) {
-            // printk(KERN_INFO "ELE784 -> [CASE 3] EOF without FID toggle detected\n");
+    // =====================================================
+    // Handle EOF (without FID toggle)
+    // CRITICAL: Validate frame size before accepting EOF
+    // =====================================================
+    if (has_eof && !has_fid_toggle) {
+        // printk(KERN_INFO "ELE784 -> [CASE 3] EOF without FID toggle detected\n");
+        
+        if (buffer->Status & BUF_STREAM_FRAME_READ) {
+            // Check if frame is actually complete
+            frame_complete = (buffer->SrcOffset >= EXPECTED_FRAME_SIZE) && !buffer->Damaged;
             
-            if (buffer->Status & BUF_STREAM_FRAME_READ) {
-                // Check if frame is actually complete
-                frame_complete = (buffer->BytesUsed >= EXPECTED_FRAME_SIZE);
-                
-                if (frame_complete) {
-                    // Frame is complete - accept the EOF
-                    buffer->Status |= BUF_STREAM_EOF;
-                    buffer->Status &= ~BUF_STREAM_FRAME_READ;
-                    
-                    frame_count++;
-                    // printk(KERN_INFO "ELE784 -> [CASE 3] Frame #%d COMPLETE: %u bytes, Status=0x%02x\n",
-                    //        frame_count, buffer->BytesUsed, buffer->Status);
-                    // FPS counter - print every second
-                    if (frame_count % 30 == 0) {
-                        unsigned long now = jiffies;
-                        if (last_time != 0) {
-                            unsigned long diff = (now - last_time) * 1000 / HZ;
-                            printk(KERN_INFO "ELE784 -> 30 frames in %lu ms (~%lu FPS)\n", 
-                                   diff, 30000 / diff);
-                        }
-                        last_time = now;
-                    }
-                    complete(&(buffer->urb_completion));
-                } 
-                // else {
-                //     // Frame is NOT complete - ignore premature EOF
-                //     printk(KERN_WARNING "ELE784 -> [CASE 3] IGNORING premature EOF: %u/%u bytes (continuing capture)\n",
-                //            buffer->BytesUsed, EXPECTED_FRAME_SIZE);
-                // }
-            } 
+            if (frame_complete) {
+                // Frame is complete - accept the EOF
+                frame_deliver(buffer, FRAME_FLAG_COMPLETE);
+                frame_fps_tick(buffer);
+            } else if (buffer->Damaged && frame_repair(buffer)) {
+                // Lost packets concealed, frame delivered as repaired
+                frame_fps_tick(buffer);
+            } else if (buffer->Damaged || buffer->HeadLost) {
+                // Lost packets and not repairable: the frame ends here all the same
+                buffer->Stats.frames_abandoned++;
+                buffer->Status &= ~BUF_STREAM_FRAME_READ;
+            }
             // else {
-            //     printk(KERN_INFO "ELE784 -> [CASE 3] EOF ignored (not capturing), Status=0x%02x\n", buffer->Status);
+            //     // Frame is NOT complete - ignore premature EOF
+            //     printk(KERN_WARNING "ELE784 -> [CASE 3] IGNORING premature EOF: %u/%u bytes (continuing capture)\n",
+            //            buffer->BytesUsed, EXPECTED_FRAME_SIZE);
             // }
+        } 
+        // else {
+        //     printk(KERN_INFO "ELE784 -> [CASE 3] EOF ignored (not capturing), Status=0x%02x\n", buffer->Status);
+        // }
+    }
+    return 0;
+}
+
+// Assemble the packets of one URB and resubmit it (body of complete_callback)
+static void complete_callback_urb(struct urb *urb) {
+    struct driver_buffer  *buffer = urb->context;
+    int            i, ret;
+    int            missed = 0;
+    uint64_t       now = 0;
+
+    // Only process successful URBs or resubmit on recoverable errors
+    if (urb->status != 0) {
+        buffer->Stats.urb_errors++;
+        if (urb->status != -ENOENT && urb->status != -ECONNRESET && urb->status != -ESHUTDOWN) {
+            ret = usb_submit_urb(urb, GFP_ATOMIC);
+            if (ret < 0) {
+                printk(KERN_WARNING "ELE784 -> (%s) : Resubmit URB error => ret = %d\n", __FUNCTION__, ret);
+                buffer->Stats.resubmit_failures++;
+                if (buffer->Profile == URB_PROFILE_ADAPTIVE) {
+                    spin_lock(&buffer->Lock);
+                    buffer->Parked[buffer->ParkedCount++] = urb;
+                    buffer->InFlight--;
+                    buffer->ResubmitFailed = 1;
+                    spin_unlock(&buffer->Lock);
+                }
+            }
         }
+        return;
     }
 
+    if (buffer->TraceRing)
+        now = ktime_get_ns();
+
+    // Process all packets in this URB
+    for (i = 0; i < urb->number_of_packets; ++i) {
+        buffer->Stats.packets++;
+        if (buffer->TraceRing)
+            packet_trace_add(buffer, urb, i, now);
+
+        missed += stream_packet(buffer, urb->transfer_buffer + urb->iso_frame_desc[i].offset,
+                                urb->iso_frame_desc[i].actual_length, urb->iso_frame_desc[i].status);
+    }
+
+    // Adaptive geometry: may submit a parked URB, or park this one
+    if (buffer->Profile == URB_PROFILE_ADAPTIVE && urb_adapt(buffer, urb, missed))
+        return;
+
     // Re-submit URB for continuous streaming
     ret = usb_submit_urb(urb, GFP_ATOMIC);
     if (ret < 0) {
         printk(KERN_WARNING "ELE784 -> URB resubmit failed: %d\n", ret);
+        buffer->Stats.resubmit_failures++;
+        if (buffer->Profile == URB_PROFILE_ADAPTIVE) {
+            // keep the URB for later and ask for more depth at the next completion
+            spin_lock(&buffer->Lock);
+            buffer->Parked[buffer->ParkedCount++] = urb;
+            buffer->InFlight--;
+            buffer->ResubmitFailed = 1;
+            spin_unlock(&buffer->Lock);
+        }
     }
 }
+
+// URB completion handler: times the processing of each URB for the
+// callback histogram and the orbit_urb_complete tracepoint
+static void complete_callback(struct urb *urb) {
+    struct driver_buffer *buffer = urb->context;
+    int      status  = urb->status;
+    int      packets = urb->number_of_packets;
+    int      errors  = urb->error_count;
+    uint64_t t0 = ktime_get_ns();
+    uint64_t dt;
+
+    complete_callback_urb(urb);
+
+    dt = ktime_get_ns() - t0;
+    latency_hist_add(&buffer->CallbackHist, dt);
+    trace_orbit_urb_complete(status, packets, errors, dt);
+}
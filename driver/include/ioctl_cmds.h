@@ -3,30 +3,272 @@
 
 #include <linux/ioctl.h>
 
+// Sparse address-space annotation: defined by the kernel headers only
+#ifndef __user
+#define __user
+#endif
+
 #define MAGIC_VAL 'R'
 
 #define IOCTL_GET                _IOWR(MAGIC_VAL, 0x10, int)
 #define IOCTL_SET                _IOW(MAGIC_VAL, 0x20, int)
+#define IOCTL_BATCH              _IOWR(MAGIC_VAL, 0x11, struct usb_request_batch)
 #define IOCTL_STREAMON           _IOW(MAGIC_VAL, 0x30, int)
 #define IOCTL_STREAMOFF          _IOW(MAGIC_VAL, 0x40, int)
+#define IOCTL_STREAM_SET_ROI     _IOWR(MAGIC_VAL, 0x31, struct stream_roi)
+#define IOCTL_STREAM_GET_ROI     _IOR(MAGIC_VAL, 0x32, struct stream_roi)
+#define IOCTL_STREAM_SET_OUTPUT  _IOWR(MAGIC_VAL, 0x33, struct stream_output)
+#define IOCTL_STREAM_SET_RATE    _IOWR(MAGIC_VAL, 0x34, struct stream_rate)
+#define IOCTL_STREAM_SET_CONCEAL _IOW(MAGIC_VAL, 0x35, struct stream_conceal)
+#define IOCTL_STREAM_GET_META    _IOR(MAGIC_VAL, 0x36, struct frame_meta)
+#define IOCTL_STREAM_SET_GEOMETRY _IOW(MAGIC_VAL, 0x37, struct stream_geometry)
+#define IOCTL_STREAM_GET_GEOMETRY _IOR(MAGIC_VAL, 0x38, struct stream_geometry)
+#define IOCTL_STREAM_SET_CFR     _IOW(MAGIC_VAL, 0x39, struct stream_cfr)
+#define IOCTL_STREAM_GET_CFR     _IOR(MAGIC_VAL, 0x3A, struct stream_cfr)
+#define IOCTL_STREAM_SNAPSHOT    _IOWR(MAGIC_VAL, 0x3B, struct stream_snapshot)
+#define IOCTL_STREAM_SET_SYNTH   _IOW(MAGIC_VAL, 0x3C, struct stream_synth)
+#define IOCTL_STREAM_GET_SYNTH   _IOR(MAGIC_VAL, 0x3D, struct stream_synth)
 #define IOCTL_PANTILT_RELATIVE   _IOW(MAGIC_VAL, 0x50, int)
+#define IOCTL_PANTILT_RELATIVE_ASYNC _IOW(MAGIC_VAL, 0x51, struct pantilt_relative)
+#define IOCTL_PANTILT_STATUS     _IOR(MAGIC_VAL, 0x52, struct pantilt_status)
+#define IOCTL_PANTILT_ABSOLUTE   _IOWR(MAGIC_VAL, 0x53, struct pantilt_absolute)
+#define IOCTL_PANTILT_GET_POSITION _IOR(MAGIC_VAL, 0x54, struct pantilt_position)
+#define IOCTL_PANTILT_WAIT       _IOW(MAGIC_VAL, 0x55, int)  // arg = timeout in ms, 0 = none
 #define IOCTL_PANTILT_RESET      _IOW(MAGIC_VAL, 0x60, int)
-#define IOCTL_PANTILT_GET_INFO   _IOR(MAGIC_VAL, 0x70, int)  // NEW
-#define IOCTL_PANTILT_GET_CAPS   _IOR(MAGIC_VAL, 0x80, int)  // NEW
+#define IOCTL_PANTILT_GET_INFO   _IOR(MAGIC_VAL, 0x70, struct pantilt_info)
+#define IOCTL_PANTILT_GET_CAPS   _IOR(MAGIC_VAL, 0x80, struct pantilt_caps)
 
 struct usb_request {
   uint8_t  request; // GET_CUR = 0x81, SET_CUR = 0x01, GET_MIN, GET_MAX, ...
   uint8_t  data_size; // wLength (payload size)
   uint16_t value; // wValue   (selector << 8)
   uint16_t index; //// wValue   (selector << 8)
-  uint16_t timeout;  // timeout in ms
+  uint16_t timeout;  // timeout in ms, 0 = driver default (4000)
   uint8_t  *data; // pointer to user buffer
 };
 
+// Batch of GET/SET requests executed back-to-back by one IOCTL_BATCH.
+// A request is a GET when bit 7 of request is set (GET_CUR = 0x81, ...),
+// a SET otherwise. The batch stops at the first failing request.
+#define USB_BATCH_MAX            64
+
+struct usb_request_batch {
+  uint32_t            count;  // number of requests in ops
+  uint32_t            done;   // (out) requests executed successfully
+  int32_t             error;  // (out) 0, or -errno of request ops[done]
+  struct usb_request __user *ops;  // user array of count requests
+};
+
 // Structure for proprietaire relative pan/tilt command
 struct pantilt_relative {
   int16_t pan;   // signed 16-bit, little endian
   int16_t tilt;  // signed 16-bit, little endian
 };
 
+// State of the asynchronous pan/tilt queue (IOCTL_PANTILT_RELATIVE_ASYNC).
+// Moves queued while one is on the wire are added up and sent as one.
+// poll() on /dev/camera_control reports POLLOUT when every move was sent.
+struct pantilt_status {
+  uint32_t submitted;     // moves accepted by IOCTL_PANTILT_RELATIVE_ASYNC
+  uint32_t sent;          // control transfers issued
+  uint32_t completed;     // control transfers finished (successfully or not)
+  uint32_t merged;        // moves added to a pending one instead of being sent alone
+  int32_t  last_error;    // status of the last transfer (0 or -errno)
+  int16_t  pending_pan;   // delta waiting for the transfer in flight
+  int16_t  pending_tilt;
+  uint8_t  busy;          // a transfer is in flight
+};
+
+// Range of the pan/tilt head of the Orbit, in device units (64 per degree)
+// from the reset position. Only a fallback: use IOCTL_PANTILT_GET_CAPS.
+#define PANTILT_PAN_MIN          (-4480)
+#define PANTILT_PAN_MAX          ( 4480)
+#define PANTILT_TILT_MIN         (-1920)
+#define PANTILT_TILT_MAX         ( 1920)
+
+// Pan/tilt capabilities, read once at probe (GET_MIN/MAX/RES/DEF of the
+// relative control) and returned from the driver cache. The limits bound one
+// relative command and, around the reset position, the absolute position.
+struct pantilt_caps {
+  int16_t  pan_min;
+  int16_t  pan_max;
+  int16_t  tilt_min;
+  int16_t  tilt_max;
+  uint16_t pan_res;
+  uint16_t tilt_res;
+  int16_t  pan_def;
+  int16_t  tilt_def;
+  uint8_t  from_device;  // 0 = the camera did not answer, Orbit defaults
+};
+
+// Identification of the pan/tilt unit (also cached at probe)
+struct pantilt_info {
+  uint8_t  info;         // GET_INFO bitmap: 1 = GET supported, 2 = SET supported, ...
+  uint8_t  from_device;  // 0 = GET_INFO failed
+  uint16_t vendor;       // idVendor
+  uint16_t product;      // idProduct
+  uint16_t release;      // bcdDevice
+};
+
+// Absolute move: the target is clamped to the range, the move is split into
+// the fewest relative commands (both axes moving in each of them) and each
+// command is sent when the previous motion should be over.
+struct pantilt_absolute {
+  int16_t  pan;    // target (in), clamped target (out)
+  int16_t  tilt;
+  uint16_t steps;  // (out) relative commands sent
+};
+
+// Motion done: no transfer queued or in flight and the modeled end of the
+// last motion (relative move or reset homing) is past. IOCTL_PANTILT_WAIT
+// blocks until then (ETIMEDOUT after the timeout); poll() on
+// /dev/camera_control reports it as POLLIN.
+
+// Position tracked by the driver since the last IOCTL_PANTILT_RESET.
+// It survives the application: a new process can read it back.
+struct pantilt_position {
+  int16_t  pan;
+  int16_t  tilt;
+  uint8_t  valid;  // 0 until the first reset
+};
+
+// Region of interest and decimation applied by the driver while it copies
+// the payload. Readers receive a frame of frame_size bytes instead of 640x480.
+struct stream_roi {
+  uint16_t x;           // left edge in pixels, must be even
+  uint16_t y;           // top edge in lines
+  uint16_t width;       // 0 = full frame, multiple of 2*decimation
+  uint16_t height;      // multiple of decimation
+  uint8_t  decimation;  // 1, 2 or 4 (keeps every Nth pixel pair and line)
+  uint32_t frame_size;  // (out) bytes per delivered frame
+};
+
+// Output layouts produced by the driver while it assembles a frame
+#define STREAM_OUTPUT_YUYV       0  // packed Y0 U Y1 V (camera native)
+#define STREAM_OUTPUT_GREY       1  // Y plane only (w*h bytes)
+#define STREAM_OUTPUT_YUV422P    2  // Y plane, then U plane, then V plane (w/2*h each)
+
+struct stream_output {
+  uint8_t  mode;        // STREAM_OUTPUT_*
+  uint32_t frame_size;  // (out) bytes per delivered frame
+};
+
+// Frame decimation: the camera keeps streaming at its native rate and the
+// driver only assembles every Nth frame. Set target_fps to let the driver
+// compute every_nth from the committed frame interval.
+struct stream_rate {
+  uint16_t every_nth;   // 1 = every frame (default)
+  uint16_t target_fps;  // 0 = use every_nth
+  uint16_t native_fps;  // (out) committed camera rate
+};
+
+// What the driver does with a frame that lost packets or ended short
+#define STREAM_CONCEAL_DROP      0  // drop it (default)
+#define STREAM_CONCEAL_MARK      1  // deliver it, damaged bytes left as they are
+#define STREAM_CONCEAL_ZERO      2  // deliver it, damaged bytes zero-filled
+#define STREAM_CONCEAL_PREVIOUS  3  // deliver it, damaged bytes taken from the previous frame
+
+struct stream_conceal {
+  uint8_t mode;         // STREAM_CONCEAL_*
+  uint8_t min_percent;  // drop anyway below this share of received bytes
+};
+
+// Metadata of the frame returned by the last read()
+#define FRAME_FLAG_COMPLETE      (1 << 0)  // every byte arrived
+#define FRAME_FLAG_REPAIRED      (1 << 1)  // delivered with damaged ranges
+#define FRAME_FLAG_RECOVERED     (1 << 2)  // first frame after a watchdog recovery
+
+#define FRAME_META_MAX_DAMAGE    8
+
+// Damaged byte range, as an offset in the 640x480 YUYV frame sent by the camera.
+// When more than FRAME_META_MAX_DAMAGE ranges are lost the last one is widened.
+struct frame_damage {
+  uint32_t offset;
+  uint32_t length;
+};
+
+struct frame_meta {
+  uint64_t timestamp_ns;    // CLOCK_MONOTONIC when the frame was handed over
+  uint32_t sequence;        // frame number (FID toggles since STREAMON)
+  uint32_t flags;           // FRAME_FLAG_*
+  uint32_t bytes_received;  // payload bytes that actually arrived
+  uint32_t damage_count;    // number of damaged ranges
+  struct frame_damage damage[FRAME_META_MAX_DAMAGE];
+};
+
+// URB geometry profiles (taken into account at the next STREAMON)
+#define URB_PROFILE_THROUGHPUT   0  // 8 URBs of up to 256 packets (default)
+#define URB_PROFILE_LOW_LATENCY  1  // 32 URBs of 8 packets
+#define URB_PROFILE_ADAPTIVE     2  // 16 packets per URB, in-flight depth from 4 to 32
+
+struct stream_geometry {
+  uint8_t  profile;           // URB_PROFILE_*
+  uint8_t  urb_count;         // (out) URBs allocated
+  uint8_t  in_flight;         // (out) URBs currently submitted
+  uint16_t packets_per_urb;   // (out)
+  uint32_t packet_size;       // (out) bytes per isochronous packet
+  uint32_t missed_intervals;  // (out) packets not transferred in their interval
+  uint32_t late_resubmits;    // (out) URB resubmissions refused by the host controller
+  uint32_t grow_events;       // (out) adaptive: URBs added to the in-flight set
+  uint32_t shrink_events;     // (out) adaptive: URBs parked after an idle period
+};
+
+// Constant frame rate: at each STREAMON the driver sets the auto-exposure
+// priority of the camera terminal to "constant frame rate" and, when the
+// exposure time is set by the host (manual or shutter priority AE), caps it
+// to the committed frame interval. The image gets darker in low light
+// instead of the rate dropping.
+struct stream_cfr {
+  uint8_t  enable;               // applied at the next STREAMON
+  uint8_t  applied;              // (out) the camera accepted the settings at the last STREAMON
+  int32_t  error;                // (out) 0, or -errno of the request that failed
+  uint32_t exposure_max;         // (out) exposure cap in 100 us units, 0 = not capped (auto AE)
+  uint32_t committed_fps_centi;  // (out) rate of the committed frame interval x100
+  uint32_t measured_fps_centi;   // (out) delivered rate x100 (last 30 frames)
+};
+
+// One still image, taken while the preview keeps streaming. The camera sends
+// it between two preview frames with the still bit set in its payload
+// headers; the driver assembles it apart from the preview.
+struct stream_snapshot {
+  uint8_t  frame_index;  // still image size (1-based, in the order of the descriptor), 0 = 1
+  uint32_t timeout_ms;   // 0 = 2000
+  uint32_t size;         // bytes of data (in), bytes of the still (out)
+  uint16_t width;        // (out) from the still image frame descriptor, 0 if unknown
+  uint16_t height;       // (out)
+  uint32_t flags;        // (out) FRAME_FLAG_COMPLETE, or FRAME_FLAG_REPAIRED if packets were lost
+  uint8_t *data;         // user buffer (YUYV)
+};
+
+// Synthetic frame source: from the next STREAMON the frame assembly is fed
+// by a timer in the driver instead of the isochronous URBs (the camera is
+// not asked to stream). The packets carry 640x480 YUYV colour bars with the
+// impairments below, at rates the camera cannot reach. The packet trace
+// ring and still images are not available in this mode.
+struct stream_synth {
+  uint8_t  enable;          // applied at the next STREAMON
+  uint16_t fps;             // 1 to 1000, 0 = 30
+  uint16_t packet_size;     // bytes per packet, header included, 64 to 32768 (0 = 3060)
+  uint16_t loss_permille;   // packets completed with -EPROTO
+  uint16_t error_permille;  // packets with the error bit set in their payload header
+  uint16_t eof_every;       // EOF in the middle of every Nth frame (0 = never)
+  uint16_t fid_every;       // one packet with the wrong FID in every Nth frame (0 = never)
+  uint32_t frames;          // (out) frames generated since STREAMON
+  uint32_t packets;         // (out) packets generated since STREAMON
+  uint32_t late_ticks;      // (out) timer expirations missed (packets sent in a burst)
+};
+
+// Record of the packet trace ring (debugfs logitech_orbit/<intf>/packets).
+// The file is a plain array of these records, oldest first, little endian.
+#define PACKET_HDR_NONE          0xff  // header_len when the packet has no header
+
+struct packet_record {
+  uint64_t timestamp_ns;    // CLOCK_MONOTONIC at the completion of the URB
+  int16_t  status;          // iso_frame_desc status (0 or -errno)
+  uint16_t actual_length;   // bytes received, header included
+  uint8_t  header_len;      // bHeaderLength, PACKET_HDR_NONE if less than 2 bytes
+  uint8_t  header_flags;    // bmHeaderInfo (FID, EOF, ERR, ...)
+  uint16_t index;           // packet number within its URB
+};
+
 #endif 
@@ -14,22 +14,108 @@
 #include <linux/usb/video.h>
 #include <linux/completion.h>
 #include <linux/uaccess.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sysfs.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <linux/kref.h>
+#include <linux/list.h>
+#include <linux/string.h>
+#include <linux/poll.h>
 
 #include <asm/atomic.h>
 #include <asm/uaccess.h>
 
-#include "callback.h"
+// quiet=1 silences the per-call / per-frame trace (ioctl entry, FPS, ...), errors are still printed
+static bool quiet;
+module_param(quiet, bool, 0644);
+MODULE_PARM_DESC(quiet, "Do not log every ioctl call and frame event");
+#define ele784_dbg(fmt, ...) do { if (!quiet) printk(KERN_INFO fmt, ##__VA_ARGS__); } while (0)
+
 #include "ioctl_cmds.h"
+#include "orbit_trace.h"
+#include "callback.h"
+#include "synth_source.h"
 #include "usb_structs.h"
 
 
 MODULE_LICENSE("GPL");
 
+// Packet trace ring: number of records kept per device (0 = disabled, rounded up to a power of two)
+#define PACKET_TRACE_MAX  (1 << 20)
+static unsigned int packet_trace;
+module_param(packet_trace, uint, 0444);
+MODULE_PARM_DESC(packet_trace, "Packets kept in the debugfs trace ring of each stream (0 = off, max 1048576)");
+
+// Stream watchdog: restart the stream when no frame completes within
+// watchdog_frames frame intervals, or when URB resubmissions keep failing
+#define WATCHDOG_RESUBMIT_STORM   8   // resubmit failures within one period
+#define WATCHDOG_MAX_RETRIES      3   // failed recoveries before giving up
+#define WATCHDOG_MIN_PERIOD_MS  100
+static unsigned int watchdog_frames = 30;
+module_param(watchdog_frames, uint, 0644);
+MODULE_PARM_DESC(watchdog_frames, "Frame intervals without a frame before the stream is restarted (0 = off)");
+
+// Re-enumeration: how long a disconnected camera is waited for before its open files fail
+static unsigned int reattach_ms = 5000;
+module_param(reattach_ms, uint, 0644);
+MODULE_PARM_DESC(reattach_ms, "Time a disconnected camera keeps its open files waiting for re-enumeration (0 = off)");
+
 // #define URB_COUNT      1
 #define URB_COUNT      8
 // #define MAX_PACKETS    128
 #define MAX_PACKETS    256
 
+// Preallocated control buffer (wLength of a usb_request is 8 bits)
+#define CTRL_BUF_SIZE  256
+// Timeout of a usb_request: 0 means TIMEOUT (usb_control_msg would wait forever)
+#define CTRL_TIMEOUT(t)  ((t) ? (t) : TIMEOUT)
+// Timeout of the pan/tilt capability reads at probe (ms)
+#define CAPS_TIMEOUT   500
+
+// Cache of the static attributes (GET_MIN/MAX/RES/LEN/DEF) of the
+// controls, per (request, selector, entity). Emptied on reset and disconnect.
+#define CTRL_ATTR_CACHE_SIZE  128
+#define CTRL_ATTR_MAX_LEN      32  // larger answers are not cached
+
+struct ctrl_attr {
+  uint8_t  request;
+  uint8_t  asked;     // wLength of the request that filled the entry
+  uint8_t  len;       // bytes returned by the camera
+  uint16_t value;     // selector << 8
+  uint16_t index;     // entity << 8 | interface
+  uint8_t  data[CTRL_ATTR_MAX_LEN];
+};
+
+// Motion-time model (the head gives no feedback): speed of each axis and
+// settle time, calibrated on the Orbit. A reset homes the head against the
+// negative end stops, then back to the centre.
+static unsigned int pan_speed = 6000;
+module_param(pan_speed, uint, 0644);
+MODULE_PARM_DESC(pan_speed, "Pan speed of the motion-time model, in units/s");
+static unsigned int tilt_speed = 3000;
+module_param(tilt_speed, uint, 0644);
+MODULE_PARM_DESC(tilt_speed, "Tilt speed of the motion-time model, in units/s");
+static unsigned int settle_ms = 50;
+module_param(settle_ms, uint, 0644);
+MODULE_PARM_DESC(settle_ms, "Time added to every modeled motion before it is reported done");
+
+// Synthetic frame source (synth_source.h) enabled on every new stream interface
+static unsigned int synth_fps;
+module_param(synth_fps, uint, 0644);
+MODULE_PARM_DESC(synth_fps, "Feed new streams from the in-driver synthetic source at this rate instead of the camera (0 = off, max 1000)");
+
+// URB geometry of the low-latency and adaptive profiles (URB_MAX is in callback.h)
+#define URB_LOW_LATENCY_PACKETS   8   // 1 ms per URB on a high-speed link
+#define URB_ADAPTIVE_PACKETS     16
+
 #define FORMAT_INDEX_UNCOMPRESSED_YUYV 1
 #define FRAME_INDEX_320x240            6
 #define FRAME_INDEX_160x120            3
@@ -63,10 +149,56 @@ static struct usb_device_id usb_device_id [] = {
 MODULE_DEVICE_TABLE(usb, usb_device_id);
 
 static int ele784_open(struct inode *inode, struct file *file);
+static int ele784_release(struct inode *inode, struct file *file);
 static long ele784_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
+static long ele784_do_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
 static ssize_t ele784_read(struct file *file, char __user *buffer, size_t count, loff_t *f_pos);
+static __poll_t ele784_poll(struct file *file, poll_table *wait);
 static int ele784_probe(struct usb_interface *interface, const struct usb_device_id *id);
 static void ele784_disconnect (struct usb_interface *intf);
+static int ele784_pre_reset(struct usb_interface *intf);
+static int ele784_post_reset(struct usb_interface *intf);
+static int ele784_suspend(struct usb_interface *intf, pm_message_t message);
+static int ele784_resume(struct usb_interface *intf);
+static int ele784_alloc_frame_buffers(struct driver_buffer *fb, uint32_t size);
+static void ele784_free_frame_buffers(struct driver_buffer *fb);
+struct orbit_driver;
+static void ele784_release_frame_buffers(struct orbit_driver *driver);
+static int ele784_stream_commit(struct orbit_driver *driver, uint8_t *data);
+static int ele784_stream_start(struct orbit_driver *driver);
+static int ele784_stream_arm(struct orbit_driver *driver);
+static int ele784_synth_arm(struct orbit_driver *driver);
+static void ele784_stream_cfr(struct orbit_driver *driver);
+static int ele784_still_capture(struct orbit_driver *driver, struct stream_snapshot *snap);
+static void ele784_watchdog_work(struct work_struct *work);
+static unsigned long ele784_watchdog_period(struct orbit_driver *driver);
+static void ele784_stream_running(struct orbit_driver *driver);
+static int ele784_stream_resume(struct orbit_driver *driver);
+static void ele784_stream_fail(struct orbit_driver *driver);
+static void ele784_delete(struct kref *kref);
+static void ele784_drop(struct orbit_driver *dev);
+static void ele784_orphan(struct orbit_driver *dev, struct usb_interface *intf);
+static struct orbit_driver *ele784_adopt_orphan(struct usb_interface *interface);
+static void ele784_orphan_expire(struct work_struct *work);
+static int ele784_ctrl_xfer(struct orbit_driver *driver, struct usb_device *udev, const struct usb_request *op, int dir);
+static int ele784_pantilt_queue(struct orbit_driver *dev, int16_t pan, int16_t tilt);
+static int ele784_pantilt_send(struct orbit_driver *dev);
+static void ele784_pantilt_complete(struct urb *urb);
+static int ele784_attr_lookup(struct orbit_driver *dev, const struct usb_request *op, uint8_t *buf);
+static void ele784_attr_store(struct orbit_driver *dev, const struct usb_request *op, const uint8_t *buf, int len);
+static void ele784_attr_invalidate(struct orbit_driver *dev);
+static void ele784_pantilt_query_caps(struct orbit_driver *dev);
+static void ele784_pantilt_timer(struct timer_list *t);
+static int ele784_pantilt_wait(struct orbit_driver *dev, unsigned int timeout_ms);
+static int ele784_pantilt_absolute(struct orbit_driver *dev, struct usb_device *udev, struct pantilt_absolute *req);
+static void ele784_stream_stop(struct orbit_driver *driver);
+static void ele784_free_urbs(struct orbit_driver *driver);
+// Streaming statistics exported in sysfs (defined at the end of logitech_orbit_driver.c)
+static const struct attribute_group ele784_stats_group;
+// Latency histograms in debugfs (logitech_orbit/ root created at module init)
+static const struct file_operations latency_hist_fops;
+static const struct file_operations packet_trace_fops;
+static struct dentry *ele784_debugfs_root;
 
 // Registers the USB driver with the kernel.
 // Kernel uses this struct to match devices and call probe or disconnect.
@@ -74,6 +206,11 @@ static struct usb_driver udriver = {
   .name = "logitech_orbit_driver",
   .probe = ele784_probe,
   .disconnect = ele784_disconnect,
+  .pre_reset = ele784_pre_reset,
+  .post_reset = ele784_post_reset,
+  .suspend = ele784_suspend,
+  .resume = ele784_resume,
+  .reset_resume = ele784_resume,
   .id_table = usb_device_id,
 };
 
@@ -83,6 +220,8 @@ static const struct file_operations fops = {
   .owner = THIS_MODULE,
   .read = ele784_read,
   .open = ele784_open,
+  .release = ele784_release,
+  .poll = ele784_poll,
   .unlocked_ioctl = ele784_ioctl,
 };
 
@@ -109,11 +248,94 @@ struct orbit_driver {
   struct usb_device		  *device;
   struct usb_interface	  *interface;
   struct usb_class_driver *class_driver;
-  struct urb			  *isoc_in_urb[URB_COUNT];
+  struct urb			  *isoc_in_urb[URB_MAX];
   struct driver_buffer     frame_buf;
+  struct dentry           *debugfs_dir;
+
+  // ioctl() and read() hold io_rwsem for reading while they run; disconnect
+  // takes it for writing before it clears interface and device (and an
+  // adopting probe before it sets them). disconnected is set first, it ends
+  // the waits of the ioctls in progress (pan/tilt motion, snapshot).
+  struct rw_semaphore      io_rwsem;
+  uint8_t                  disconnected;
+
+  // STREAMON/STREAMOFF and the watchdog recovery are serialized by stream_lock
+  struct mutex             stream_lock;
+  // Held by read() while it takes a frame and copies it out, and by
+  // STREAMOFF while it frees the frame buffers
+  struct mutex             read_lock;
+  struct delayed_work      watchdog;
+  uint8_t                  streaming;
+  uint8_t                  wd_retries;
+  uint32_t                 wd_frames;     // frames delivered at the last check
+  uint32_t                 wd_failures;   // resubmit failures at the last check
+  uint32_t                 frame_interval_us;
+  uint8_t                  resume_streaming;  // restart the stream after reset / resume / re-enumeration
+  // Constant frame rate (IOCTL_STREAM_SET_CFR), result of the last STREAMON in cfr
+  uint8_t                  cfr_enable;
+  struct stream_cfr        cfr;
+  // URB geometry (IOCTL_STREAM_SET_GEOMETRY), copied to frame_buf.Profile by the next STREAMON
+  uint8_t                  urb_profile;
+  // One snapshot at a time (IOCTL_STREAM_SNAPSHOT)
+  struct mutex             still_lock;
+  // Synthetic source (IOCTL_STREAM_SET_SYNTH): settings for the next STREAMON
+  // in synth_cfg, the running source (its own copy of them) in synth
+  struct stream_synth      synth_cfg;
+  struct synth_source      synth;
+
+  // Lifetime: one reference for the probe (or the orphan list), one per open file
+  struct kref              kref;
+  // Orphan (disconnected, waiting for the same camera to come back)
+  struct list_head         orphan_node;
+  struct delayed_work      orphan_expire;
+  char                     serial[64];
+  char                     devpath[16];
+  int                      busnum;
+  uint16_t                 vendor;
+  uint16_t                 product;
+  uint8_t                  subclass;
+
+  // Control interface: preallocated buffer of the batched requests
+  struct mutex             ctrl_lock;
+  uint8_t                 *ctrl_buf;
+
+  // Control interface: asynchronous pan/tilt queue. One control URB is in
+  // flight at most; moves queued meanwhile are merged into pt_pan/pt_tilt.
+  spinlock_t               pt_lock;
+  wait_queue_head_t        pt_wait;
+  struct urb              *pt_urb;
+  struct pantilt_xfer     *pt_xfer;
+  int16_t                  pt_pan;
+  int16_t                  pt_tilt;
+  uint8_t                  pt_pending;
+  uint8_t                  pt_busy;
+  struct pantilt_status    pt_status;
+
+  // Commanded position since the last reset (under pt_lock), end of the
+  // last commanded motion (motion-time model), and the lock serializing
+  // the synchronous moves (absolute, relative, reset)
+  struct pantilt_position  pt_pos;
+  unsigned long            pt_motion_end;
+  struct mutex             pt_move_lock;
+  // Fires at pt_motion_end to wake the waiters of pt_wait; pending while the
+  // head moves (pt_motion_end is only meaningful then)
+  struct timer_list        pt_motion_timer;
+
+  // Static control attributes already read (under ctrl_lock)
+  struct ctrl_attr         ctrl_attrs[CTRL_ATTR_CACHE_SIZE];
+  unsigned int             ctrl_attr_count;  // entries filled (round robin once full)
+
+  // Capabilities of the pan/tilt unit, read at probe (constant afterwards)
+  struct pantilt_caps      pt_caps;
+  struct pantilt_info      pt_info;
+};
+
+// Setup packet and payload of an asynchronous pan/tilt transfer (kmalloc: DMA-safe)
+struct pantilt_xfer {
+  struct usb_ctrlrequest   setup;
+  uint8_t                  data[4];
 };
 
 enum {USB_CONTROL_INTF, USB_VIDEO_INTF, NUM_INTF};
 
-//The line module_usb_driver(udriver); auto-generates the module init/exit.
-module_usb_driver(udriver);
\ No newline at end of file
+// Module init/exit are at the end of logitech_orbit_driver.c (they also own the debugfs root).
\ No newline at end of file
@@ -0,0 +1,104 @@
+// Tracepoints of the streaming path, visible with ftrace or perf:
+//   perf record -e logitech_orbit:* ...
+//   echo 1 > /sys/kernel/tracing/events/logitech_orbit/enable
+//
+// Timeline of a frame: orbit_frame_start -> orbit_urb_complete (xN)
+// -> orbit_frame_complete -> orbit_read_wakeup -> orbit_read_return
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM logitech_orbit
+
+#if !defined(_ORBIT_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _ORBIT_TRACE_H
+
+#include <linux/tracepoint.h>
+
+// One URB processed by complete_callback (duration of the handler)
+TRACE_EVENT(orbit_urb_complete,
+  TP_PROTO(int status, int packets, int errors, u64 duration_ns),
+  TP_ARGS(status, packets, errors, duration_ns),
+  TP_STRUCT__entry(
+    __field(int, status)
+    __field(int, packets)
+    __field(int, errors)
+    __field(u64, duration_ns)
+  ),
+  TP_fast_assign(
+    __entry->status      = status;
+    __entry->packets     = packets;
+    __entry->errors      = errors;
+    __entry->duration_ns = duration_ns;
+  ),
+  TP_printk("status=%d packets=%d errors=%d duration=%lluns",
+            __entry->status, __entry->packets, __entry->errors, __entry->duration_ns)
+);
+
+// First payload of a frame is about to be copied
+TRACE_EVENT(orbit_frame_start,
+  TP_PROTO(u32 sequence),
+  TP_ARGS(sequence),
+  TP_STRUCT__entry(
+    __field(u32, sequence)
+  ),
+  TP_fast_assign(
+    __entry->sequence = sequence;
+  ),
+  TP_printk("seq=%u", __entry->sequence)
+);
+
+// Frame handed over to read() (complete or repaired)
+TRACE_EVENT(orbit_frame_complete,
+  TP_PROTO(u32 sequence, u32 bytes, u32 flags),
+  TP_ARGS(sequence, bytes, flags),
+  TP_STRUCT__entry(
+    __field(u32, sequence)
+    __field(u32, bytes)
+    __field(u32, flags)
+  ),
+  TP_fast_assign(
+    __entry->sequence = sequence;
+    __entry->bytes    = bytes;
+    __entry->flags    = flags;
+  ),
+  TP_printk("seq=%u bytes=%u flags=0x%x", __entry->sequence, __entry->bytes, __entry->flags)
+);
+
+// read() took a frame; latency since the frame was complete
+TRACE_EVENT(orbit_read_wakeup,
+  TP_PROTO(u32 sequence, u64 latency_ns),
+  TP_ARGS(sequence, latency_ns),
+  TP_STRUCT__entry(
+    __field(u32, sequence)
+    __field(u64, latency_ns)
+  ),
+  TP_fast_assign(
+    __entry->sequence   = sequence;
+    __entry->latency_ns = latency_ns;
+  ),
+  TP_printk("seq=%u latency=%lluns", __entry->sequence, __entry->latency_ns)
+);
+
+// read() returns to user space; duration of copy_to_user
+TRACE_EVENT(orbit_read_return,
+  TP_PROTO(u32 sequence, long bytes, u64 copy_ns),
+  TP_ARGS(sequence, bytes, copy_ns),
+  TP_STRUCT__entry(
+    __field(u32, sequence)
+    __field(long, bytes)
+    __field(u64, copy_ns)
+  ),
+  TP_fast_assign(
+    __entry->sequence = sequence;
+    __entry->bytes    = bytes;
+    __entry->copy_ns  = copy_ns;
+  ),
+  TP_printk("seq=%u bytes=%ld copy=%lluns", __entry->sequence, __entry->bytes, __entry->copy_ns)
+);
+
+#endif /* _ORBIT_TRACE_H */
+
+// Found through the -I of the Makefile (driver/include)
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE orbit_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,194 @@
+#ifndef SYNTH_SOURCE_H
+#define SYNTH_SOURCE_H
+
+// Synthetic frame source (IOCTL_STREAM_SET_SYNTH): a high-resolution timer
+// replaces the isochronous URBs and hands UVC payload packets to
+// stream_packet(), so the frame assembly, read(), the metadata and the
+// statistics run as they do with the camera, at any rate.
+//
+// The packets of one frame are built once: a 12-byte payload header followed
+// by 640x480 YUYV colour bars. Only the flags byte of the header is rewritten
+// when a packet is sent. The packets of a frame are spread over its interval,
+// one per microframe while the frame fits in it (like the camera), closer
+// together otherwise.
+
+#include <linux/hrtimer.h>
+#include <linux/vmalloc.h>
+
+#define SYNTH_HEADER_LEN      12
+#define SYNTH_EOH             (1 << 7)
+#define SYNTH_SLOT_NS         125000ULL      // one microframe
+#define SYNTH_TICK_NS         1000000ULL     // timer period: one bus frame
+#define SYNTH_MAX_BURST       4096           // packets sent by one expiration
+#define SYNTH_DEFAULT_FPS     30
+#define SYNTH_DEFAULT_PACKET  3060
+#define SYNTH_MIN_PACKET      64
+#define SYNTH_MAX_PACKET      32768
+
+struct synth_source {
+  struct hrtimer        timer;
+  struct driver_buffer *fb;
+  struct stream_synth   cfg;        // settings latched at STREAMON
+  uint8_t              *packets;    // npk packets of cfg.packet_size bytes
+  uint32_t              built_size; // packet size of the packets built
+  uint32_t              npk;        // packets per frame
+  uint32_t              last_len;   // length of the last packet of a frame
+  uint64_t              frame_ns;
+  uint64_t              slot_ns;    // time between two packets of a frame
+  uint64_t              t_frame;    // CLOCK_MONOTONIC start of the current frame
+  uint32_t              slot;       // next packet of the current frame
+  uint8_t               fid;
+  uint32_t              rng;
+  // Counters returned by IOCTL_STREAM_GET_SYNTH
+  uint32_t              frames;
+  uint32_t              sent;
+  uint32_t              late_ticks;
+};
+
+// YUYV of 75% colour bars: white, yellow, cyan, green, magenta, red, blue, black
+static const uint8_t synth_bars[8][4] = {
+  {180, 128, 180, 128}, {162,  44, 162, 142}, {131, 156, 131,  44}, {112,  72, 112,  58},
+  { 84, 184,  84, 198}, { 65, 100,  65, 212}, { 35, 212,  35, 114}, { 16, 128,  16, 128},
+};
+
+// xorshift32: the same settings give the same impairments at every run
+static inline uint32_t synth_rand(struct synth_source *s) {
+    s->rng ^= s->rng << 13;
+    s->rng ^= s->rng >> 17;
+    s->rng ^= s->rng << 5;
+    return s->rng;
+}
+
+// Build the packets of one frame for the latched packet size (kept across STREAMON)
+static int synth_build(struct synth_source *s) {
+    uint32_t psize   = s->cfg.packet_size;
+    uint32_t payload = psize - SYNTH_HEADER_LEN;
+    uint32_t i, off, len, n;
+    uint8_t *pkt;
+
+    s->npk      = DIV_ROUND_UP(EXPECTED_FRAME_SIZE, payload);
+    s->last_len = SYNTH_HEADER_LEN + EXPECTED_FRAME_SIZE - (s->npk - 1) * payload;
+    if (s->packets && s->built_size == psize)
+        return 0;
+
+    vfree(s->packets);
+    s->packets = vmalloc((size_t)s->npk * psize);
+    if (!s->packets) {
+        s->built_size = 0;
+        return -ENOMEM;
+    }
+    s->built_size = psize;
+
+    for (i = 0; i < s->npk; i++) {
+        pkt = s->packets + (size_t)i * psize;
+        memset(pkt, 0, SYNTH_HEADER_LEN);
+        pkt[0] = SYNTH_HEADER_LEN;
+        len = (i == s->npk - 1) ? s->last_len - SYNTH_HEADER_LEN : payload;
+        for (n = 0, off = i * payload; n < len; n++, off++)
+            pkt[SYNTH_HEADER_LEN + n] = synth_bars[(off % FRAME_STRIDE) / (FRAME_STRIDE / 8)][off & 3];
+    }
+    return 0;
+}
+
+static void synth_free(struct synth_source *s) {
+    vfree(s->packets);
+    s->packets = NULL;
+    s->built_size = 0;
+}
+
+// Send the packet of the current slot through the frame assembly. Returns 1 if it was lost.
+static int synth_emit(struct synth_source *s) {
+    const struct stream_synth *cfg = &s->cfg;
+    uint8_t *pkt = s->packets + (size_t)s->slot * s->built_size;
+    uint32_t len = (s->slot == s->npk - 1) ? s->last_len : s->built_size;
+    uint32_t r   = synth_rand(s) % 1000;
+    uint8_t  flags = SYNTH_EOH | s->fid;
+
+    s->fb->Stats.packets++;
+    s->sent++;
+    if (r < cfg->loss_permille) {
+        stream_packet(s->fb, pkt, 0, -EPROTO);
+        return 1;
+    }
+    if (r < (uint32_t)cfg->loss_permille + cfg->error_permille)
+        flags |= STREAM_ERR;
+    if (s->slot == s->npk - 1)
+        flags |= STREAM_EOF;
+    if (cfg->eof_every && s->frames % cfg->eof_every == 0 && s->slot == s->npk / 3)
+        flags |= STREAM_EOF;
+    if (cfg->fid_every && s->frames % cfg->fid_every == 0 && s->slot == s->npk / 2)
+        flags ^= STREAM_FID;
+    pkt[1] = flags;
+    stream_packet(s->fb, pkt, len, 0);
+    return 0;
+}
+
+// Timer handler (softirq, like the URB completions): sends every packet whose
+// slot has started, then fires again one bus frame later. Each expiration is
+// timed in the callback histogram and traced as one URB.
+static enum hrtimer_restart synth_tick(struct hrtimer *timer) {
+    struct synth_source *s = container_of(timer, struct synth_source, timer);
+    uint64_t now = ktime_get_ns();
+    uint64_t skip;
+    int      sent = 0, errors = 0;
+    u64      overruns;
+
+    // More than a frame behind (the timer was held off): jump to the frame of
+    // now, the FID toggles so that the interrupted frame ends there
+    if (now > s->t_frame + 2 * s->frame_ns) {
+        skip = div64_u64(now - s->t_frame, s->frame_ns);
+        s->t_frame += skip * s->frame_ns;
+        s->frames  += skip;
+        s->slot = 0;
+        s->fid ^= STREAM_FID;
+    }
+
+    for (;;) {
+        if (s->slot == s->npk) {
+            s->slot = 0;
+            s->t_frame += s->frame_ns;
+            s->fid ^= STREAM_FID;
+            s->frames++;
+        }
+        if (sent == SYNTH_MAX_BURST || s->t_frame + s->slot * s->slot_ns > now)
+            break;
+        errors += synth_emit(s);
+        s->slot++;
+        sent++;
+    }
+
+    latency_hist_add(&s->fb->CallbackHist, ktime_get_ns() - now);
+    trace_orbit_urb_complete(0, sent, errors, ktime_get_ns() - now);
+
+    overruns = hrtimer_forward_now(timer, ns_to_ktime(SYNTH_TICK_NS));
+    if (overruns > 1)
+        s->late_ticks += overruns - 1;
+    return HRTIMER_RESTART;
+}
+
+static void synth_init(struct synth_source *s) {
+    hrtimer_init(&s->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS_SOFT);
+    s->timer.function = synth_tick;
+}
+
+// Start sending the frames of s->cfg into fb (packets already built)
+static void synth_start(struct synth_source *s, struct driver_buffer *fb) {
+    s->fb       = fb;
+    s->frame_ns = div_u64(NSEC_PER_SEC, s->cfg.fps);
+    s->slot_ns  = min_t(uint64_t, SYNTH_SLOT_NS, div_u64(s->frame_ns, s->npk + 1));
+    s->slot     = 0;
+    s->fid      = 0;
+    s->rng      = 0x4f524254;  // "ORBT"
+    s->frames   = 0;
+    s->sent     = 0;
+    s->late_ticks = 0;
+    s->t_frame  = ktime_get_ns();
+    hrtimer_start(&s->timer, ns_to_ktime(s->t_frame + SYNTH_TICK_NS), HRTIMER_MODE_ABS_SOFT);
+}
+
+// Waits for a handler still running
+static void synth_stop(struct synth_source *s) {
+    hrtimer_cancel(&s->timer);
+}
+
+#endif
@@ -21,6 +21,7 @@
 #define GET_MIN  0x82
 #define GET_MAX  0x83
 #define GET_RES  0x84
+#define GET_LEN  0x85
 #define GET_DEF  0x87
 #define GET_INFO 0x86
 #define GET_DEF  0x87
@@ -36,6 +37,14 @@
 #define PANTILT_RESET_CONTROL         (0x02 << 8)
 #define PANTILT_INDEX                 0x0B00
 
+// Camera terminal (entity 1 of the VideoControl interface 0)
+#define CAMERA_TERMINAL_INDEX         0x0100
+#define CT_AE_MODE_CONTROL            (0x02 << 8)
+#define CT_AE_PRIORITY_CONTROL        (0x03 << 8)
+#define CT_EXPOSURE_TIME_ABSOLUTE_CONTROL (0x04 << 8)  // 100 us units
+#define AE_MODE_MANUAL                0x01
+#define AE_MODE_SHUTTER_PRIORITY      0x04
+
 #define VS_PROBE_CONTROL_VALUE        (0x01 << 8)
 #define VS_PROBE_CONTROL_WINDEX_LE    0x0001
 #define VS_COMMIT_CONTROL_VALUE       (0x02 << 8)
@@ -44,6 +53,17 @@
 #define VS_PROBE_CONTROL_SIZE   (26u)
 // #define VS_PROBE_CONTROL_SIZE   (34u)
 
+// Still image (method 2: sent in the isochronous stream, STREAM_STI set)
+#define VS_STILL_PROBE_CONTROL_VALUE  (0x03 << 8)
+#define VS_STILL_COMMIT_CONTROL_VALUE (0x04 << 8)
+#define VS_STILL_IMAGE_TRIGGER_CONTROL_VALUE (0x05 << 8)
+#define VS_STILL_PROBE_CONTROL_SIZE   (11u)  // bFormatIndex bFrameIndex bCompressionIndex dwMaxVideoFrameSize dwMaxPayloadTransferSize
+#define STILL_TRIGGER_TRANSMIT        0x01
+
+// Class-specific VS descriptors (interface extra bytes)
+#define CS_INTERFACE                  0x24
+#define VS_STILL_IMAGE_FRAME          0x03
+
 // UVC VS Probe structure (34 bytes)
 struct vs_probe_control {
     uint16_t    bmHint;
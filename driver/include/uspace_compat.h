@@ -0,0 +1,101 @@
+#ifndef USPACE_COMPAT_H
+#define USPACE_COMPAT_H
+
+// Kernel primitives used by callback.h, for building the frame assembly in
+// user space (app/src/replay_bench.c). Single-threaded: locks do nothing.
+// Included by callback.h when __KERNEL__ is not defined.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <endian.h>
+#include <time.h>
+
+#include "ioctl_cmds.h"
+
+#define min(a, b)              ((a) < (b) ? (a) : (b))
+#define max(a, b)              ((a) > (b) ? (a) : (b))
+#define min_t(t, a, b)         min((t)(a), (t)(b))
+
+#define printk(...)            ((void)0)
+#define ele784_dbg(...)        ((void)0)
+#define KERN_INFO              ""
+#define KERN_WARNING           ""
+#define KERN_ERR               ""
+
+#define NSEC_PER_SEC           1000000000ULL
+#define NSEC_PER_MSEC          1000000ULL
+#define NSEC_PER_USEC          1000ULL
+#define div64_u64(a, b)        ((a) / (b))
+#define div_u64(a, b)          ((a) / (b))
+
+#define le64_to_cpu(x)         le64toh(x)
+#define cpu_to_le32(x)         htole32(x)
+#define cpu_to_le16(x)         htole16(x)
+
+#define smp_store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+typedef int spinlock_t;
+#define spin_lock(l)           ((void)(l))
+#define spin_unlock(l)         ((void)(l))
+
+struct completion {
+  unsigned int done;
+};
+
+static inline void complete(struct completion *c) {
+  c->done++;
+}
+
+static inline int fls64(uint64_t x) {
+  return x ? 64 - __builtin_clzll(x) : 0;
+}
+
+static inline uint64_t ktime_get_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+// Tracepoints (orbit_trace.h) compiled out
+static inline void trace_orbit_urb_complete(int status, int packets, int errors, uint64_t duration_ns) {
+  (void)status; (void)packets; (void)errors; (void)duration_ns;
+}
+
+static inline void trace_orbit_frame_start(uint32_t sequence) {
+  (void)sequence;
+}
+
+static inline void trace_orbit_frame_complete(uint32_t sequence, uint32_t bytes, uint32_t flags) {
+  (void)sequence; (void)bytes; (void)flags;
+}
+
+// Just enough of an URB for complete_callback: resubmission always succeeds
+#define GFP_ATOMIC             0
+#define USPACE_URB_PACKETS     256
+
+struct usb_iso_packet_descriptor {
+  unsigned int offset;
+  unsigned int length;
+  unsigned int actual_length;
+  int          status;
+};
+
+struct urb {
+  int       status;
+  void     *context;
+  void     *transfer_buffer;
+  int       number_of_packets;
+  int       error_count;
+  struct usb_iso_packet_descriptor iso_frame_desc[USPACE_URB_PACKETS];
+};
+
+static inline int usb_submit_urb(struct urb *urb, int mem_flags) {
+  (void)urb;
+  (void)mem_flags;
+  return 0;
+}
+
+#endif
@@ -1,13 +1,19 @@
 #include "logitech_orbit_driver.h"
 
+// Instantiate the tracepoints of orbit_trace.h in this (only) compilation unit,
+// after every other header
+#define CREATE_TRACE_POINTS
+#include "orbit_trace.h"
+
 
 
 // Event when the device is opened (Called when user-space opens /dev/camera_control or c.)
 int ele784_open(struct inode *inode, struct file *file) {
   struct usb_interface *interface;
+  struct orbit_driver *dev;
   int subminor;
   
-  printk(KERN_WARNING "ELE784 -> Open\n");
+  ele784_dbg("ELE784 -> Open\n");
   //gets the minor number assigned to /dev/camera_streamX or /dev/camera_controlX
   subminor = iminor(inode);
   
@@ -23,8 +29,23 @@ int ele784_open(struct inode *inode, struct file *file) {
 
   //Stores the per-device private data (orbit_driver struct) in file->private_data.
   // This means every call to read, ioctl, etc. can retrieve the device data 
-  file->private_data = usb_get_intfdata(interface);
+  // The file holds a reference: the device outlives a disconnect while it is open.
+  // (usb_deregister_dev() waits for a running open, so intfdata is still valid here)
+  dev = usb_get_intfdata(interface);
+  if (!dev)
+    return -ENODEV;
+  kref_get(&dev->kref);
+  file->private_data = dev;
+
+  return 0;
+}
+
+// Event when the last user of an open file closes it
+int ele784_release(struct inode *inode, struct file *file) {
+  struct orbit_driver *dev = file->private_data;
 
+  if (dev)
+    kref_put(&dev->kref, ele784_delete);
   return 0;
 }
 
@@ -34,21 +55,55 @@ int ele784_probe(struct usb_interface *interface, const struct usb_device_id *id
   struct usb_host_interface *iface_desc;
   int i,j;
   int retval;
+  int adopted = 0;
 
   printk(KERN_INFO "ELE784 -> Probe: device connected\n");
-  dev = kzalloc(sizeof(*dev), GFP_KERNEL);
-  if (!dev) {
-    dev_err(&interface->dev, "ELE784 -> Probe : Out of memory\n");
-    return -ENOMEM;
+  /* 1. A camera coming back after a reset or a brown-out takes over the
+   *    state (and the open files) of its orphaned instance.
+   */
+  dev = ele784_adopt_orphan(interface);
+  if (dev) {
+    adopted = 1;
+  } else {
+    dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+    if (!dev) {
+      dev_err(&interface->dev, "ELE784 -> Probe : Out of memory\n");
+      return -ENOMEM;
+    }
+    kref_init(&dev->kref);
+    init_rwsem(&dev->io_rwsem);
+    mutex_init(&dev->ctrl_lock);
+    spin_lock_init(&dev->pt_lock);
+    init_waitqueue_head(&dev->pt_wait);
+    mutex_init(&dev->pt_move_lock);
+    timer_setup(&dev->pt_motion_timer, ele784_pantilt_timer, 0);
+    INIT_LIST_HEAD(&dev->orphan_node);
+    INIT_DELAYED_WORK(&dev->orphan_expire, ele784_orphan_expire);
+    spin_lock_init(&dev->frame_buf.Lock);
+    init_completion(&dev->frame_buf.new_frame_start);
+    init_completion(&dev->frame_buf.urb_completion);
+    init_completion(&dev->frame_buf.still_done);
+    mutex_init(&dev->still_lock);
+    mutex_init(&dev->stream_lock);
+    mutex_init(&dev->read_lock);
+    INIT_DELAYED_WORK(&dev->watchdog, ele784_watchdog_work);
+    synth_init(&dev->synth);
+    if (synth_fps) {
+      dev->synth_cfg.enable = 1;
+      dev->synth_cfg.fps    = min(synth_fps, 1000U);
+    }
+
+    // Initialize URB pointers to NULL.
+    for (i = 0; i < URB_MAX; ++i)
+      dev->isoc_in_urb[i] = NULL;
   }
 
-  /* Save interface + device pointer */
+  /* Save interface + device pointer (the open files of an adopted orphan may be in ioctl()) */
+  down_write(&dev->io_rwsem);
   dev->device = usb_get_dev(interface_to_usbdev(interface));
   dev->interface = interface;
-
-  // Initialize URB pointers to NULL.
-  for (i = 0; i < URB_COUNT; ++i)
-    dev->isoc_in_urb[i] = NULL;
+  dev->disconnected = 0;
+  up_write(&dev->io_rwsem);
 
   // Get interface descriptor : Determine what kind of interface this is so we know whether to register camera_control or camera_stream.
   iface_desc = interface->cur_altsetting;
@@ -96,6 +151,24 @@ int ele784_probe(struct usb_interface *interface, const struct usb_device_id *id
         * This will create the device node: /dev/camera_control
         */
       dev->class_driver = &class_control_driver;
+      /* 2.B.3.
+       * Control buffer of the batched requests (kmalloc: DMA-safe), kept by an adopted device
+       */
+      if (!dev->ctrl_buf)
+        dev->ctrl_buf = kmalloc(CTRL_BUF_SIZE, GFP_KERNEL);
+      if (!dev->pt_xfer)
+        dev->pt_xfer = kmalloc(sizeof(struct pantilt_xfer), GFP_KERNEL);
+      if (!dev->pt_urb)
+        dev->pt_urb = usb_alloc_urb(0, GFP_KERNEL);
+      if (!dev->ctrl_buf || !dev->pt_xfer || !dev->pt_urb) {
+        usb_set_intfdata(interface, NULL);
+        ele784_drop(dev);
+        return -ENOMEM;
+      }
+      /* 2.B.4.
+       * Pan/tilt limits, resolution and default: read once, served from the cache
+       */
+      ele784_pantilt_query_caps(dev);
       /* 2.B.1.
         * Register the device with the USB core so that a device node is created for control.
         * usb_register_dev() connects the kernel USB interface to the character device.
@@ -110,7 +183,7 @@ int ele784_probe(struct usb_interface *interface, const struct usb_device_id *id
         */
         printk(KERN_ERR "ELE784 -> Probe : Could not register camera_control\n");
         usb_set_intfdata(interface, NULL);
-        kfree(dev);
+        ele784_drop(dev);
         dev = NULL;
         return retval;
       }
@@ -129,6 +202,15 @@ int ele784_probe(struct usb_interface *interface, const struct usb_device_id *id
        * This will create the device node: /dev/camera_stream 
        */
       dev->class_driver = &class_stream_driver;
+      /* Full frame until a region of interest is requested (an adopted device keeps its settings) */
+      if (!adopted) {
+        frame_roi_full(&dev->frame_buf.Roi);
+        dev->frame_buf.Output = STREAM_OUTPUT_YUYV;
+        dev->frame_buf.FrameSize = frame_out_size(&dev->frame_buf.Roi, STREAM_OUTPUT_YUYV);
+        dev->frame_buf.DeliverEvery = 1;
+        dev->frame_buf.Conceal = STREAM_CONCEAL_DROP;
+        dev->frame_buf.ConcealMinPercent = 50;
+      }
       /* 2.C.1. 
        *Register the device node for streaming 
        */
@@ -142,22 +224,58 @@ int ele784_probe(struct usb_interface *interface, const struct usb_device_id *id
          */
         printk(KERN_ERR "ELE784 -> Probe : Could not register camera_stream\n");
         usb_set_intfdata(interface, NULL);
-        kfree(dev);
+        ele784_drop(dev);
         dev = NULL;
         return retval;
       }
       printk(KERN_INFO "ELE784 -> Probe : Registered camera_stream device\n");
+      /* 2.C.3.
+       * Export the streaming statistics (stats/ of the interface in sysfs).
+       * The stream works without them, so a failure is only reported.
+       */
+      if (sysfs_create_group(&interface->dev.kobj, &ele784_stats_group))
+        printk(KERN_WARNING "ELE784 -> Probe : Could not create the stats sysfs group\n");
+      /* 2.C.4.
+       * Latency histograms in debugfs: logitech_orbit/<interface>/
+       */
+      dev->debugfs_dir = debugfs_create_dir(dev_name(&interface->dev), ele784_debugfs_root);
+      debugfs_create_file("callback_us", 0444, dev->debugfs_dir,
+                          &dev->frame_buf.CallbackHist, &latency_hist_fops);
+      debugfs_create_file("frame_to_read_us", 0444, dev->debugfs_dir,
+                          &dev->frame_buf.ReadLatencyHist, &latency_hist_fops);
+      /* 2.C.5.
+       * Optional packet trace ring, dumped in binary from logitech_orbit/<interface>/packets
+       */
+      if (packet_trace && !dev->frame_buf.TraceRing) {
+        unsigned long n = roundup_pow_of_two(min(packet_trace, (unsigned int)PACKET_TRACE_MAX));
+
+        dev->frame_buf.TraceRing = vzalloc(array_size(n, sizeof(struct packet_record)));
+        if (dev->frame_buf.TraceRing)
+          dev->frame_buf.TraceMask = n - 1;
+        else
+          printk(KERN_WARNING "ELE784 -> Probe : No memory for a %lu packet trace ring\n", n);
+      }
+      if (dev->frame_buf.TraceRing)
+        debugfs_create_file("packets", 0400, dev->debugfs_dir, &dev->frame_buf, &packet_trace_fops);
+      /* 2.C.6.
+       * Re-enumerated camera: restart the stream its readers were waiting on
+       */
+      if (adopted && dev->resume_streaming) {
+        mutex_lock(&dev->stream_lock);
+        ele784_stream_resume(dev);
+        mutex_unlock(&dev->stream_lock);
+      }
       return 0; // success
     }
     /* 2.D. Video class but unknown subclass */
     printk(KERN_INFO "ELE784 -> Probe : Video interface but unknown subclass\n");
     usb_set_intfdata(interface, NULL);
-    kfree(dev);
+    ele784_drop(dev);
     dev = NULL;
     return -ENODEV;
   } 
   /* Not a video interface */
-  kfree(dev);
+  ele784_drop(dev);
   dev = NULL;
   return -ENODEV;
 }
@@ -165,11 +283,10 @@ int ele784_probe(struct usb_interface *interface, const struct usb_device_id *id
 // This is the disconnect callback called by the USB core when the device is physically unplugged or the driver is removed.
 // intf is the USB interface being disconnected.
 void ele784_disconnect(struct usb_interface *intf) {
-  // i is just a loop counter for later.
-  int i; 
   // 1. usb_get_intfdata(intf) retrieves the pointer to driver’s private data (struct orbit_driver) 
   // that previously attached in probe() with usb_set_intfdata().
   struct orbit_driver *dev = usb_get_intfdata(intf); 
+  unsigned long flags;
   printk(KERN_INFO "ELE784 -> Disconnect\n");
   // 2. If the private driver data wasn’t set (somehow probe() never succeeded), there’s nothing to clean up.
   if (!dev)
@@ -179,805 +296,2282 @@ void ele784_disconnect(struct usb_interface *intf) {
    * - Removes /dev/camera_control or /dev/camera_stream from the system before freeing any memory.
    */
   usb_deregister_dev(intf, dev->class_driver);
-  /* 2.B. If URBs were allocated (streaming started) 
-   * - Checks whether any isochronous URBs were allocated. 
-   * - If the user hasn’t started streaming yet, we don’t need to touch URBs or buffers.
+  /* The ioctls waiting for a motion or a snapshot return -ENODEV, and the
+   * motion timer no longer sends the queued pan/tilt move */
+  spin_lock_irqsave(&dev->pt_lock, flags);
+  dev->disconnected = 1;
+  spin_unlock_irqrestore(&dev->pt_lock, flags);
+  /* Pan/tilt transfer in flight: the completion sees -ENOENT and drops what is pending */
+  if (dev->pt_urb)
+    usb_kill_urb(dev->pt_urb);
+  del_timer_sync(&dev->pt_motion_timer);
+  ele784_attr_invalidate(dev);
+  wake_up_interruptible(&dev->pt_wait);
+  complete(&dev->frame_buf.still_done);
+  /* Remove the statistics first: waits for the sysfs readers still using dev */
+  if (dev->class_driver == &class_stream_driver)
+    sysfs_remove_group(&intf->dev.kobj, &ele784_stats_group);
+  debugfs_remove_recursive(dev->debugfs_dir);
+  dev->debugfs_dir = NULL;
+  /* The watchdog must not restart a stream that is being torn down */
+  cancel_delayed_work_sync(&dev->watchdog);
+  /* Wait for the ioctl() and read() in progress: none of them uses interface
+   * or device past this point */
+  down_write(&dev->io_rwsem);
+  mutex_lock(&dev->stream_lock);
+  /* A stream interrupted by a suspend or a reset is still wanted by its readers */
+  dev->resume_streaming = dev->streaming || dev->resume_streaming;
+  dev->streaming = 0;
+  /* 2.B. Stop every URB and free it with its DMA buffer.
+   * - Cancels the URBs still pending (being processed by the USB core).
+   * - Prevents the kernel from accessing freed memory.
+   * The frame buffers stay: an open file may still be copying from them.
+   * They are freed with the driver struct (ele784_delete).
    */
-  if (dev->isoc_in_urb[0] != NULL) 
-  {
-    //Loop over all URBs in the driver.
-    for (i = 0; i < URB_COUNT; i++) 
-    {
-      //dev->isoc_in_urb[i] may be NULL if that URB was never allocated. (Only free URBs that exist.)
-      if (dev->isoc_in_urb[i]) 
-      {
-        /* 2.B.1. Stop URB if running.
-         * - Cancels the URB if it’s still pending (being processed by the USB core).
-         * - Prevents the kernel from accessing freed memory.
-         */
-        usb_kill_urb(dev->isoc_in_urb[i]);
-        /* 2.B.2. Free DMA buffer 
-         * - Frees the DMA buffer associated with the URB.
-         * - usb_free_coherent() releases the memory allocated by usb_alloc_coherent()
-         * - dev->frame_buf.MaxLength is the size of the buffer
-         * - Avoid memory leaks and ensure proper cleanup of USB DMA resources.
-         */
-        if (dev->isoc_in_urb[i]->transfer_buffer)
-        {
-          usb_free_coherent(dev->device,
-                            dev->frame_buf.MaxLength,
-                            dev->isoc_in_urb[i]->transfer_buffer,
-                            dev->isoc_in_urb[i]->transfer_dma);
-        }
-        /* 2.B.3. Frees the memory of the URB structure itself.
-         * - Sets the pointer to NULL to avoid dangling pointers.
-         * - Complete cleanup of all allocated URB resources.
-         */
-        usb_free_urb(dev->isoc_in_urb[i]);
-        dev->isoc_in_urb[i] = NULL;
-      }
-    }
-    /* 2.B.4. Free the frame buffer.
-     * - Frees the frame buffer used to store video frames collected from URBs.
-     * - Sets pointer to NULL to avoid dangling pointer.
-     * - Prevent memory leaks and ensure the driver struct is completely cleaned.
-     */
-    if (dev->frame_buf.Data) {
-      kfree(dev->frame_buf.Data);
-      dev->frame_buf.Data = NULL;
-    }
-  }
-  // **Null out file->private_data for all open fds**
-  // You must iterate over all open files referencing this device.
-  // Simplest workaround: store drv->file_list or just set drv->interface = NULL
+  ele784_free_urbs(dev);
+  // Open files keep their reference: ioctl() sees interface == NULL and returns -ENODEV
   dev->interface = NULL;
   /* 2.C. Detach driver data from interface 
    *    - Ensures that if open() or other calls happen after disconnect, they won’t accidentally use freed memory.
    */
   usb_set_intfdata(intf, NULL);
-  /* 2.D. Free the driver struct 
-   *    - Last step in cleanup; all sub-structures have already been freed.
+  mutex_unlock(&dev->stream_lock);
+  /* An orphan gives its usb_device back now, the new one is taken at adoption */
+  if (reattach_ms) {
+    usb_put_dev(dev->device);
+    dev->device = NULL;
+  }
+  up_write(&dev->io_rwsem);
+  /* 2.D. Keep the device as an orphan for reattach_ms, so that the same
+   *      camera re-enumerated after a reset or a brown-out resumes it.
+   *      Otherwise (or when it never comes back) the probe reference is
+   *      dropped and the struct is freed with its last open file.
    */
-  kfree(dev);
+  if (reattach_ms) {
+    ele784_orphan(dev, intf);
+  } else {
+    ele784_drop(dev);
+  }
   dev = NULL;
   printk(KERN_INFO "ELE784 -> Disconnect complete\n");
 }
 
-// IOCTL handler for camera control commands
-long ele784_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+// Last reference gone (probe/orphan and open files): free the driver struct
+void ele784_delete(struct kref *kref) {
+  struct orbit_driver *dev = container_of(kref, struct orbit_driver, kref);
+
+  ele784_free_frame_buffers(&dev->frame_buf);
+  vfree(dev->frame_buf.TraceRing);
+  synth_free(&dev->synth);
+  del_timer_sync(&dev->pt_motion_timer);
+  kfree(dev->ctrl_buf);
+  usb_free_urb(dev->pt_urb);
+  kfree(dev->pt_xfer);
+  if (dev->device)
+    usb_put_dev(dev->device);
+  kfree(dev);
+}
 
-  // Retrieve the driver data from file->private_data
-  struct orbit_driver  *driver = (struct orbit_driver *) file->private_data;
-  
-  // Validate the driver data
-  if (!driver) {
-    // If private_data is NULL, the device is disconnected or not properly opened
-    printk(KERN_ERR "ELE784 -> IOCTL called on disconnected device (private_data=NULL)\n");
-    return -ENODEV;
-  }else{
-    // Log the received IOCTL command for debugging
-    printk(KERN_INFO "ELE784 -> IOCTL called with cmd=0x%08x\n", cmd);
-  }
+// Wake the readers with -EIO (stream lost for good) and drop the probe reference
+void ele784_drop(struct orbit_driver *dev) {
+  ele784_stream_fail(dev);
+  kref_put(&dev->kref, ele784_delete);
+}
 
-  // Further validate the interface pointer
-  if (!driver->interface) {
-    // If interface is NULL, the device has been disconnected
-    printk(KERN_ERR "ELE784 -> IOCTL called on disconnected device (interface=NULL)\n");
-    return -ENODEV;
-  }else{
-    // Log that the interface is valid
-    printk(KERN_INFO "ELE784 -> IOCTL device interface is valid\n");
-  }
+// =====================================================
+// RE-ENUMERATION
+// A disconnected camera stays on the orphan list for reattach_ms. A probe of
+// the same camera (same serial number, or same port when it has none) and the
+// same interface takes the orphan over instead of allocating a new one.
+// =====================================================
+static LIST_HEAD(ele784_orphans);
+static DEFINE_MUTEX(ele784_orphans_lock);
+
+// Remember how to recognize the camera and put it on the orphan list
+// (intf is the interface being disconnected, dev->device is already released)
+void ele784_orphan(struct orbit_driver *dev, struct usb_interface *intf) {
+  struct usb_device *udev = interface_to_usbdev(intf);
+
+  dev->busnum   = udev->bus->busnum;
+  dev->vendor   = le16_to_cpu(udev->descriptor.idVendor);
+  dev->product  = le16_to_cpu(udev->descriptor.idProduct);
+  dev->subclass = intf->cur_altsetting->desc.bInterfaceSubClass;
+  strscpy(dev->devpath, udev->devpath, sizeof(dev->devpath));
+  strscpy(dev->serial, udev->serial ? udev->serial : "", sizeof(dev->serial));
+
+  mutex_lock(&ele784_orphans_lock);
+  list_add_tail(&dev->orphan_node, &ele784_orphans);
+  mutex_unlock(&ele784_orphans_lock);
+  schedule_delayed_work(&dev->orphan_expire, msecs_to_jiffies(reattach_ms));
+  printk(KERN_INFO "ELE784 -> Disconnect : waiting %u ms for %s-%s to come back\n",
+         reattach_ms, dev->serial[0] ? dev->serial : "port", dev->devpath);
+}
 
-  //device and interface pointers
-  struct usb_interface *interface = driver->interface;
-  // Get the usb_device structure for sending control messages
+// Is interface the same camera and the same interface as the orphan dev ?
+static int ele784_orphan_match(struct orbit_driver *dev, struct usb_interface *interface) {
   struct usb_device *udev = interface_to_usbdev(interface);
+  struct usb_host_interface *alts = interface->cur_altsetting;
+
+  if (alts->desc.bInterfaceClass != CC_VIDEO || alts->desc.bInterfaceSubClass != dev->subclass)
+    return 0;
+  if (le16_to_cpu(udev->descriptor.idVendor) != dev->vendor ||
+      le16_to_cpu(udev->descriptor.idProduct) != dev->product)
+    return 0;
+  if (dev->serial[0] && udev->serial)
+    return strcmp(dev->serial, udev->serial) == 0;
+  return udev->bus->busnum == dev->busnum && strcmp(udev->devpath, dev->devpath) == 0;
+}
 
-  // Local variables for USB request parameters
-  struct usb_request user_request; // structure to hold user request
-  uint8_t  request, data_size; // size of data buffer
-  uint16_t value, index, timeout; // USB request parameters
-  uint8_t  *data = NULL; // data buffer pointer
+// Take a matching orphan off the list; the orphan reference becomes the probe reference
+struct orbit_driver *ele784_adopt_orphan(struct usb_interface *interface) {
+  struct orbit_driver *dev, *found = NULL;
 
-  int i,j; // loop counters
-  long retval=0; // return value
+  mutex_lock(&ele784_orphans_lock);
+  list_for_each_entry(dev, &ele784_orphans, orphan_node) {
+    if (ele784_orphan_match(dev, interface)) {
+      found = dev;
+      list_del_init(&dev->orphan_node);
+      break;
+    }
+  }
+  mutex_unlock(&ele784_orphans_lock);
 
-  // Handle different IOCTL commands
-  switch(cmd) {
+  if (found) {
+    // A running expiry sees the orphan off the list and leaves it alone
+    cancel_delayed_work(&found->orphan_expire);
+    printk(KERN_INFO "ELE784 -> Probe : %s-%s is back, resuming its open files\n",
+           found->serial[0] ? found->serial : "port", found->devpath);
+  }
+  return found;
+}
 
-    // Handle IOCTL_GET command (get = reads from device/ ask to device)
-    case IOCTL_GET:
-      printk(KERN_INFO "ELE784 -> IOCTL_GET\n");
-      /* ---------------------------------------------------------
-      * Step 1 — Copy the usb_request header from user space
-      * --------------------------------------------------------- */
-      if (copy_from_user(&user_request, (struct usb_request __user *)arg, sizeof(struct usb_request))) {
-        printk(KERN_ERR "ELE784 -> IOCTL_GET : copy_from_user (request) failed\n");
-        retval = -EFAULT;
-        break;
-      }
-      
-      /* Basic sanity check */      
-      data_size = user_request.data_size;
-      if (data_size < 0 || data_size > 1024) {
-          printk(KERN_ERR "ELE784 -> IOCTL_GET: invalid data_size=%d [0;1024]\n", data_size);
-          retval = -EINVAL;
-          break;
-      }
-      /* ---------------------------------------------------------
-      * Step 2 — Allocate kernel buffer for receiving USB payload
-      * --------------------------------------------------------- */
-      if (data_size > 0) {
-        data = kmalloc(data_size, GFP_KERNEL);
-        if (!data) {
-          printk(KERN_ERR "ELE784 -> IOCTL_GET: kmalloc(%d) failed\n",data_size);
-          retval = -ENOMEM;
-          break;
-        }
-      }
-      /* ---------------------------------------------------------
-      * Step 3 — Perform the USB GET request (device → host)
-      * --------------------------------------------------------- */
-      retval = usb_control_msg(
-          udev,
-          usb_rcvctrlpipe(udev, 0), // Control-IN : endpoint 0
-          user_request.request,   // GET_CUR, GET_MIN, GET_MAX, ...
-          USB_DIR_IN | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
-          user_request.value,     // full 16-bit wValue already provided by user
-          user_request.index,     // full 16-bit wIndex (interface) already provided
-          data,                   // destination buffer
-          data_size,              // expected length
-          user_request.timeout
-      );
+// The camera did not come back in time
+void ele784_orphan_expire(struct work_struct *work) {
+  struct orbit_driver *dev = container_of(to_delayed_work(work), struct orbit_driver, orphan_expire);
 
-      /* ---------------------------------------------------------
-      * Step 4 — Handle USB errors
-      * --------------------------------------------------------- */
-      if(retval < 0) {
-        /* USB failure error message already contained in retval */
-        printk(KERN_ERR "ELE784 -> IOCTL_GET: usb_control_msg failed (%d)\n",retval);
-        if (data) {
-          kfree(data);
-          data = NULL;
-        }
-        break; // to freeing region at bottom       
-      }
-      /* ---------------------------------------------------------
-      * Step 5 — Warn if short packet (should never happen for UVC)
-      * --------------------------------------------------------- */
-      if (retval != data_size) {
-        /* Continue anyway, return what we received */
-        printk(KERN_WARNING "ELE784 -> IOCTL_GET: short packet (%d/%d bytes)\n",retval, data_size);
-      }
-      /* ---------------------------------------------------------
-      * Step 6 — Copy data back to user space
-      * --------------------------------------------------------- */
-      if (data_size > 0) {
-        if (copy_to_user(user_request.data, data, data_size)) {
-          printk(KERN_ERR "ELE784 -> IOCTL_GET: copy_to_user failed\n");
-          if (data) {
-            kfree(data);
-            data = NULL;
-          }
-          retval = -EFAULT;
-          break;
-        }
-      }
-      /* api de ioctl demande 0 comme retour en cas de succes 
-      * Success: use 0 as ioctl return code 
-      */
-      retval = 0;
-      /* ---------------------------------------------------------
-      * Step 7 — Free kernel buffer
-      * --------------------------------------------------------- */
-      if (data) {
-        kfree(data);
-        data = NULL;
-      }
-      break; //  Required to exit the switch
+  mutex_lock(&ele784_orphans_lock);
+  if (list_empty(&dev->orphan_node)) {
+    mutex_unlock(&ele784_orphans_lock);
+    return;
+  }
+  list_del_init(&dev->orphan_node);
+  mutex_unlock(&ele784_orphans_lock);
 
-    // set = write a value to device. 
-    case IOCTL_SET:
-        printk(KERN_INFO "ELE784 -> IOCTL_SET\n");
-        /* ---------------------------------------------------------
-        * Step 1 — Copy the usb_request header from user space
-        * --------------------------------------------------------- */
-        if (copy_from_user(&user_request,(struct usb_request __user *)arg,sizeof(struct usb_request))) {
-            printk(KERN_ERR "ELE784 -> IOCTL_SET: copy_from_user(request) failed\n");
-            retval = -EFAULT;
-            break;
-        }
-        /* Basic sanity check */
-        data_size = user_request.data_size;
-        if (data_size < 0 || data_size > 1024) {
-          printk(KERN_ERR "ELE784 -> IOCTL_SET: invalid data_size=%d [0;1024]\n",data_size);
-          retval = -EINVAL;
-          break;
-        }
-        /* ---------------------------------------------------------
-        * Step 2 — Allocate kernel buffer for sending USB payload
-        * --------------------------------------------------------- */
-        if (data_size > 0) {
-          data = kmalloc(data_size, GFP_KERNEL);
-          if (!data) {
-            printk(KERN_ERR "ELE784 -> IOCTL_SET: kmalloc(%d) failed\n",data_size);
-            retval = -ENOMEM;
-            break;
-          }
-          /* Copy payload (host → device) */
-          if (copy_from_user(data,(uint8_t __user *)user_request.data,data_size)) {
-            printk(KERN_ERR "ELE784 -> IOCTL_SET: copy_from_user(data) failed\n");
-            if (data) {
-              kfree(data);
-              data = NULL;
-            }
-            retval = -EFAULT;
-            break;
-          }
-        }
-        /* ---------------------------------------------------------
-        * Step 3 — Perform the USB SET request (host → device)
-        * --------------------------------------------------------- */
-        retval = usb_control_msg(
-            udev,
-            usb_sndctrlpipe(udev, 0),
-            user_request.request,   // Typically SET_CUR = 1
-            USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
-            user_request.value,     // full 16-bit wValue
-            user_request.index,     // full 16-bit wIndex
-            data,
-            data_size,
-            user_request.timeout
-        );
-        /* ---------------------------------------------------------
-        * Step 4 — Handle USB errors
-        * --------------------------------------------------------- */
-        if (retval < 0) {
-          printk(KERN_ERR "ELE784 -> IOCTL_SET: usb_control_msg failed (%d)\n",retval);
-          if (data) {
-            kfree(data);
-            data = NULL;
-          }
-          break; // exit this case
-        }
-        /* On success, ioctl returns 0 */
-        retval = 0;
-        /* ---------------------------------------------------------
-        * Step 5 — Free kernel buffer
-        * --------------------------------------------------------- */
-        if (data) {
-          kfree(data);
-          data = NULL;
-        }
-        break;
+  printk(KERN_INFO "ELE784 -> %s-%s did not come back, releasing it\n",
+         dev->serial[0] ? dev->serial : "port", dev->devpath);
+  ele784_drop(dev);
+}
 
-  
-    case IOCTL_PANTILT_RESET:
-      printk(KERN_INFO "ELE784 -> IOCTL_PANTILT_RESET\n");
-      /* ---------------------------------------------------------
-      * Step 1 — Allocate kernel buffer (1 byte for reset command)
-      * --------------------------------------------------------- */
-      data = kmalloc(1, GFP_KERNEL);
-      if (!data) {
-        printk(KERN_ERR "ELE784 -> IOCTL_PANTILT_RESET: kmalloc(1) failed\n");
-        retval = -ENOMEM;
-        break;
-      }
-      /* ---------------------------------------------------------
-      * Step 2 — Fill payload
-      * --------------------------------------------------------- */
-      data[0] = PANTILT_RESET_CMD;
-      /* ---------------------------------------------------------
-      * Step 3 — Perform USB SET request (host → device)
-      * --------------------------------------------------------- */
-      retval = usb_control_msg(udev,
-                              usb_sndctrlpipe(udev, 0),
-                              SET_CUR,
-                              USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
-                              PANTILT_RESET_CONTROL,
-                              PANTILT_INDEX, // wIndex interface : 00 and entity : 0B (0X0B00)
-                              data, 1, TIMEOUT);
-      /* ---------------------------------------------------------
-      * Step 4 — Handle USB errors
-      * --------------------------------------------------------- */
-      if (retval < 0) {
-        printk(KERN_ERR "ELE784 -> IOCTL_PANTILT_RESET: usb_control_msg failed (%d)\n",retval);
-        if (data) {
-          kfree(data);
-          data = NULL;
-        }
-        break;
-      }
-      /* Success return value */
-      retval = 0;
-      /* ---------------------------------------------------------
-      * Step 5 — Free buffer
-      * --------------------------------------------------------- */
-      if (data) {
-        kfree(data);
-        data = NULL;
-      }
+// Module exit: release the orphans still waiting
+static void ele784_flush_orphans(void) {
+  struct orbit_driver *dev;
+
+  for (;;) {
+    mutex_lock(&ele784_orphans_lock);
+    dev = list_first_entry_or_null(&ele784_orphans, struct orbit_driver, orphan_node);
+    if (dev)
+      list_del_init(&dev->orphan_node);
+    mutex_unlock(&ele784_orphans_lock);
+    if (!dev)
       break;
+    cancel_delayed_work_sync(&dev->orphan_expire);
+    ele784_drop(dev);
+  }
+}
 
-    case IOCTL_PANTILT_RELATIVE:
-    {
-      printk(KERN_INFO "ELE784 -> IOCTL_PANTILT_RELATIVE\n");
+// =====================================================
+// RESET / SUSPEND / RESUME
+// The URBs are stopped before a reset or a suspend and the stream is
+// committed and submitted again afterwards. The frame buffers, the settings
+// and the open files are kept: blocked readers get the next frame.
+// =====================================================
+
+// Stop the URBs, remember whether the stream has to be restarted. Called with stream_lock held.
+static void ele784_stream_pause(struct orbit_driver *dev) {
+  dev->resume_streaming = dev->streaming || dev->resume_streaming;
+  if (dev->streaming) {
+    ele784_free_urbs(dev);
+    dev->streaming = 0;
+  }
+}
 
-      /* ---------------------------------------------------------
-      * Step 1 — Copy user-space structure (relative pan/tilt)
-      * --------------------------------------------------------- */
-      struct pantilt_relative rel;
-      // read 4 bytes (two int16) from user space
-      if (copy_from_user(&rel, (void __user *)arg, sizeof(rel))){
-        printk(KERN_ERR "ELE784 -> IOCTL_PANTILT_RELATIVE: copy_from_user(rel) failed\n");
-        retval = -EFAULT;
-        break;
-      }
+// USB reset coming: stream_lock stays held until post_reset
+int ele784_pre_reset(struct usb_interface *intf) {
+  struct orbit_driver *dev = usb_get_intfdata(intf);
 
-      /* ---------------------------------------------------------
-      * Step 2 — Allocate 4-byte payload buffer
-      * --------------------------------------------------------- */
-      data = kmalloc(4, GFP_KERNEL);
-      if (!data) {
-        printk(KERN_ERR "ELE784 -> IOCTL_PANTILT_RESET: kmalloc(4) failed\n");
-        retval = -ENOMEM;
-        break;
-      }
+  if (!dev || dev->class_driver != &class_stream_driver)
+    return 0;
+  printk(KERN_INFO "ELE784 -> Pre reset\n");
+  cancel_delayed_work_sync(&dev->watchdog);
+  mutex_lock(&dev->stream_lock);
+  ele784_stream_pause(dev);
+  return 0;
+}
 
-      /* ---------------------------------------------------------
-      * Step 3 — Fill payload (little-endian pan/tilt)
-      * --------------------------------------------------------- */
-      data[0] = rel.pan & 0xFF;
-      data[1] = (rel.pan >> 8) & 0xFF;
-      data[2] = rel.tilt & 0xFF;
-      data[3] = (rel.tilt >> 8) & 0xFF;
-      /* ---------------------------------------------------------
-      * Step 4 — Send USB SET_CUR request (host → device)
-      * --------------------------------------------------------- */      
-      retval = usb_control_msg(udev,
-                               usb_sndctrlpipe(udev,0),
-                               SET_CUR, // bRequest = 1
-                               USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
-                               PANTILT_RELATIVE_CONTROL,
-                               PANTILT_INDEX,
-                               data,
-                               4,
-                               TIMEOUT);
-      /* ---------------------------------------------------------
-      * Step 5 — Handle USB errors
-      * --------------------------------------------------------- */
-      if (retval < 0) {
-          printk(KERN_ERR "ELE784 -> IOCTL_PANTILT_RELATIVE: usb_control_msg failed (%d)\n",
-                retval);
-          if (data) {
-              kfree(data);
-              data = NULL;
-          }
-          break;
-      }
+int ele784_post_reset(struct usb_interface *intf) {
+  struct orbit_driver *dev = usb_get_intfdata(intf);
+
+  // A reset camera may answer differently: read the attributes again
+  if (dev && dev->class_driver == &class_control_driver)
+    ele784_attr_invalidate(dev);
+  if (!dev || dev->class_driver != &class_stream_driver)
+    return 0;
+  printk(KERN_INFO "ELE784 -> Post reset\n");
+  if (dev->resume_streaming)
+    ele784_stream_resume(dev);
+  mutex_unlock(&dev->stream_lock);
+  return 0;
+}
 
-      /* ioctl API requires 0 on success */
-      retval = 0;
-      /* ---------------------------------------------------------
-      * Step 6 — Free payload buffer
-      * --------------------------------------------------------- */
-      if (data) {
-        kfree(data);
-        data = NULL;
-      }
-      break;
-    }
-    
-    // Handle IOCTL_STREAMON command
-    case IOCTL_STREAMON:
+int ele784_suspend(struct usb_interface *intf, pm_message_t message) {
+  struct orbit_driver *dev = usb_get_intfdata(intf);
 
-      printk(KERN_INFO "ELE784 -> IOCTL_STREAMON\n");
-      {	
-        /* ======================================================
-         *  PROBE / DEF / SET_CUR / GET_CUR / COMMIT CONTROL
-         * ====================================================== */
-
-        // allocation data buffer for 34 bytes (VS_PROBE_CONTROL message length =  VS_PROBE_CONTROL_SIZE)
-        data = kmalloc( VS_PROBE_CONTROL_SIZE, GFP_KERNEL);
-        if (!data) {
-          printk(KERN_ERR "ELE784 -> IOCTL_STREAMON : kmalloc(%d) failed\n", VS_PROBE_CONTROL_SIZE);
-          retval = -ENOMEM;
-          break;
-        }
+  if (!dev || dev->class_driver != &class_stream_driver)
+    return 0;
+  cancel_delayed_work_sync(&dev->watchdog);
+  mutex_lock(&dev->stream_lock);
+  ele784_stream_pause(dev);
+  mutex_unlock(&dev->stream_lock);
+  return 0;
+}
 
-        // 1 : PROBE_CONTROL(GET_CUR) garbage. Not recommended, used for debug and investigation
-        retval = usb_control_msg(
-            udev,
-            usb_rcvctrlpipe(udev, 0),                         // pipe de contrôle IN
-            GET_CUR,                                          // bRequest = 0x81
-            USB_DIR_IN | USB_TYPE_CLASS | USB_RECIP_INTERFACE,// bmRequestType = 0xA1
-            VS_PROBE_CONTROL_VALUE,                           // wValue = 0x0100 (Probe)
-            VS_PROBE_CONTROL_WINDEX_LE,                        // wIndex = interface 1, entity 0 (0x0001)
-            data,                                             // BUFFER
-            VS_PROBE_CONTROL_SIZE,                            // wLength = 34     
-            TIMEOUT                                              // timeout (ms)
-        );
-        if (retval < 0) {
-          printk(KERN_ERR "ELE784 -> IOCTL_STREAMON : usb_control_msg(GET_CUR,PROBE) failed, retval=%d\n",retval);
-          if(data){
-            kfree(data);
-            data = NULL;
-          }
-          break;
-        }
-        printk(KERN_INFO "ELE784 -> IOCTL_STREAMON : PROBE_CONTROL(GET_CUR) returned %d bytes:\n", retval);
-        // print_probe_control_struct(data);
-        //SHOUL SHOW WHAT GARBAGE THE DEVICE SENDS
-
-        // 2 : PROBE_CONTROL(GET_DEF) 
-        retval = usb_control_msg(
-            udev,
-            usb_rcvctrlpipe(udev, 0),                         // pipe de contrôle IN
-            GET_DEF,                                          // bRequest = 0x81
-            USB_DIR_IN | USB_TYPE_CLASS | USB_RECIP_INTERFACE,// bmRequestType = 0xA1
-            VS_PROBE_CONTROL_VALUE,                           // wValue = 0x0100 (Probe)
-            VS_PROBE_CONTROL_WINDEX_LE,                        // wIndex = interface 1, entity 0 (0x0001)
-            data,                                             // BUFFER
-            VS_PROBE_CONTROL_SIZE,                            // wLength = 34     
-            TIMEOUT                                              // timeout (ms)
-        );
-        if (retval < 0) {
-          printk(KERN_ERR "ELE784 -> IOCTL_STREAMON : usb_control_msg(GET_DEF,PROBE) failed, retval=%d\n",retval);
-          if(data){
-            kfree(data);
-            data = NULL;
-          }
+// Also used as reset_resume: the format is committed again in any case
+int ele784_resume(struct usb_interface *intf) {
+  struct orbit_driver *dev = usb_get_intfdata(intf);
+
+  if (dev && dev->class_driver == &class_control_driver)
+    ele784_attr_invalidate(dev);
+  if (!dev || dev->class_driver != &class_stream_driver)
+    return 0;
+  mutex_lock(&dev->stream_lock);
+  if (dev->resume_streaming)
+    ele784_stream_resume(dev);
+  mutex_unlock(&dev->stream_lock);
+  return 0;
+}
+
+// Allocate the three frame buffers used by the callback / read() handoff
+int ele784_alloc_frame_buffers(struct driver_buffer *fb, uint32_t size) {
+  fb->Data      = kmalloc(size, GFP_KERNEL);
+  fb->ReadyData = kmalloc(size, GFP_KERNEL);
+  fb->ReadData  = kmalloc(size, GFP_KERNEL);
+  if (!fb->Data || !fb->ReadyData || !fb->ReadData) {
+    ele784_free_frame_buffers(fb);
+    return -ENOMEM;
+  }
+  fb->ReadyBytes = 0;
+  fb->ReadBytes  = 0;
+  fb->PrevData   = NULL;
+  fb->PrevSize   = 0;
+  return 0;
+}
+
+void ele784_free_frame_buffers(struct driver_buffer *fb) {
+  kfree(fb->Data);
+  kfree(fb->ReadyData);
+  kfree(fb->ReadData);
+  fb->Data      = NULL;
+  fb->ReadyData = NULL;
+  fb->ReadData  = NULL;
+  fb->PrevData  = NULL;
+}
+
+// Stream stopped: free the frame buffers once no read() is copying from them
+// and wake the blocked readers, they get -EIO until the next STREAMON.
+// The URBs are already killed.
+void ele784_release_frame_buffers(struct orbit_driver *driver) {
+  struct driver_buffer *fb = &driver->frame_buf;
+  unsigned long flags;
+
+  mutex_lock(&driver->read_lock);
+  spin_lock_irqsave(&fb->Lock, flags);
+  fb->Status = BUF_STREAM_STOPPED;
+  spin_unlock_irqrestore(&fb->Lock, flags);
+  ele784_free_frame_buffers(fb);
+  mutex_unlock(&driver->read_lock);
+  complete_all(&fb->urb_completion);
+}
+
+// Negotiate the video format with the camera (PROBE / COMMIT).
+// On success data holds the committed VS_PROBE_CONTROL structure.
+int ele784_stream_commit(struct orbit_driver *driver, uint8_t *data) {
+  struct usb_device *udev = driver->device;
+  struct vs_probe_control probe;
+  int retval;
+
+  /* ======================================================
+   *  PROBE / DEF / SET_CUR / GET_CUR / COMMIT CONTROL
+   * ====================================================== */
+
+  // 1 : PROBE_CONTROL(GET_CUR) garbage. Not recommended, used for debug and investigation
+  retval = usb_control_msg(
+      udev,
+      usb_rcvctrlpipe(udev, 0),                         // pipe de contrôle IN
+      GET_CUR,                                          // bRequest = 0x81
+      USB_DIR_IN | USB_TYPE_CLASS | USB_RECIP_INTERFACE,// bmRequestType = 0xA1
+      VS_PROBE_CONTROL_VALUE,                           // wValue = 0x0100 (Probe)
+      VS_PROBE_CONTROL_WINDEX_LE,                        // wIndex = interface 1, entity 0 (0x0001)
+      data,                                             // BUFFER
+      VS_PROBE_CONTROL_SIZE,                            // wLength = 34     
+      TIMEOUT                                              // timeout (ms)
+  );
+  if (retval < 0) {
+    printk(KERN_ERR "ELE784 -> IOCTL_STREAMON : usb_control_msg(GET_CUR,PROBE) failed, retval=%d\n",retval);
+    return retval;
+  }
+  printk(KERN_INFO "ELE784 -> IOCTL_STREAMON : PROBE_CONTROL(GET_CUR) returned %d bytes:\n", retval);
+  // print_probe_control_struct(data);
+  //SHOUL SHOW WHAT GARBAGE THE DEVICE SENDS
+
+  // 2 : PROBE_CONTROL(GET_DEF) 
+  retval = usb_control_msg(
+      udev,
+      usb_rcvctrlpipe(udev, 0),                         // pipe de contrôle IN
+      GET_DEF,                                          // bRequest = 0x81
+      USB_DIR_IN | USB_TYPE_CLASS | USB_RECIP_INTERFACE,// bmRequestType = 0xA1
+      VS_PROBE_CONTROL_VALUE,                           // wValue = 0x0100 (Probe)
+      VS_PROBE_CONTROL_WINDEX_LE,                        // wIndex = interface 1, entity 0 (0x0001)
+      data,                                             // BUFFER
+      VS_PROBE_CONTROL_SIZE,                            // wLength = 34     
+      TIMEOUT                                              // timeout (ms)
+  );
+  if (retval < 0) {
+    printk(KERN_ERR "ELE784 -> IOCTL_STREAMON : usb_control_msg(GET_DEF,PROBE) failed, retval=%d\n",retval);
+    return retval;
+  }
+  printk(KERN_INFO "ELE784 -> IOCTL_STREAMON : PROBE_CONTROL(GET_DEF) returned %d bytes:\n", retval);
+  // print_probe_control_struct(data);
+
+
+
+    /* Basic hint: host provides frame interval */
+  probe.bmHint          = 1;          // keep same
+  probe.bFormatIndex    = FORMAT_INDEX_UNCOMPRESSED_YUYV;// FORMAT_UNCOMPRESSED (YUY2)
+  // probe.bFrameIndex     = FRAME_INDEX_320x240;          // 320*240 frame
+  // probe.bFrameIndex     = FRAME_INDEX_160x120 ;      // <-- 160*120 frame
+  probe.bFrameIndex     = FRAME_INDEX_640x480;    // <-- 640x480 frame
+  probe.dwFrameInterval = FRAME_INTERVAL_30FPS;     // 30 fps (from descriptor)
+  /* Leave these zero for uncompressed */
+  probe.wKeyFrameRate   = 0;
+  probe.wPFrameRate     = 0;
+  probe.wCompQuality    = 0;
+  probe.wCompWindowSize = 0;
+  probe.wDelay          = 0;
+  /* From lsusb for 320x240 UNCOMPRESSED */
+  // probe.dwMaxVideoFrameSize  = FRAME_SIZE_320x240; // 320*240*2
+  // probe.dwMaxVideoFrameSize      = FRAME_SIZE_160x120 ;   // 160*120*2
+  probe.dwMaxVideoFrameSize      = FRAME_SIZE_640x480 ;   // 160*120*2
+  // probe.dwMaxPayloadTransferSize = PAYLOAD_SIZE_3060 ; // e.g. 3060
+  /* From VC header */
+  // probe.dwClockFrequency = CLOCK_FREQUENCY_300MHZ; // 300 MHz
+  probe.bmFramingInfo    = 0;
+  probe.bPreferedVersion = 0;
+  probe.bMinVersion      = 0;
+  probe.bMaxVersion      = 0;
+
+  pack_probe_control(&probe, data);
+  printk(KERN_INFO "ELE784 -> IOCTL_STREAMON : PROBE_CONTROL(SET_CUR) will send :\n");
+  // print_probe_control_struct(data);
+
+  // MODIFY DATA BASED ON THE OUPUT OF THE FIRST GET_CUR. CONFIRM THAT THE DATA TO SEND IS CORRECT AND THEN SEND IT
+  // 3 : PROBE_CONTROL (SET_CUR)
+  retval = usb_control_msg(
+      udev,
+      usb_sndctrlpipe(udev, 0),                         
+      SET_CUR,                                         
+      USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+      VS_PROBE_CONTROL_VALUE,                                
+      VS_PROBE_CONTROL_WINDEX_LE,                                           
+      data,                                             
+      VS_PROBE_CONTROL_SIZE,                                       
+      TIMEOUT                                              
+  );
+  if (retval < 0) {
+    printk(KERN_ERR "ELE784 -> IOCTL_STREAMON : usb_control_msg(SET_CUR/PROBE) failed, retval=%d\n",retval);
+    return retval;
+  }
+  printk(KERN_INFO "ELE784 -> IOCTL_STREAMON : PROBE_CONTROL(SET_CUR) returned %d bytes:\n", retval);
+
+
+  // 4.PROBE_CONTROL (GET_CUR)
+  retval = usb_control_msg(
+      udev,
+      usb_rcvctrlpipe(udev, 0),                         // pipe de contrôle IN
+      GET_CUR,                                          // bRequest = 0x81
+      USB_DIR_IN | USB_TYPE_CLASS | USB_RECIP_INTERFACE,// bmRequestType = 0xA1
+      VS_PROBE_CONTROL_VALUE,                           // wValue = 0x0100 (Probe)
+      VS_PROBE_CONTROL_WINDEX_LE,                        // wIndex = interface 1, entity 0 
+      data,                                             // BUFFER
+      VS_PROBE_CONTROL_SIZE,                            // wLength = 34     
+      TIMEOUT                                           // timeout (ms)
+  );
+  if (retval < 0) {
+    printk(KERN_ERR "ELE784 -> IOCTL_STREAMON : usb_control_msg(GET_CUR,PROBE) failed, retval=%d\n",retval);
+    return retval;
+  }
+  printk(KERN_INFO "ELE784 -> IOCTL_STREAMON : PROBE_CONTROL(GET_CUR) returned %d bytes:\n", retval);
+  // print_probe_control_struct(data);
+
+  /* 4) SET_CUR(COMMIT) – commit the settings */
+  // this dont have the rigth format 
+  retval = usb_control_msg(
+      udev,
+      usb_sndctrlpipe(udev, 0),
+      SET_CUR,
+      USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+      VS_COMMIT_CONTROL_VALUE,
+      VS_COMMIT_CONTROL_WINDEX_LE,
+      data,
+      VS_PROBE_CONTROL_SIZE,
+      TIMEOUT);
+  if (retval < 0) {
+      printk(KERN_ERR "STREAMON: SET_CUR(COMMIT) failed (%d)\n", retval);
+      return retval;
+  }
+
+  return 0;
+}
+
+// Constant frame rate: AE priority "constant frame rate" and, when the host
+// sets the exposure time, an exposure cap of one frame interval. A camera
+// refusing the settings does not prevent the stream from starting.
+void ele784_stream_cfr(struct orbit_driver *driver) {
+  struct usb_device *udev = driver->device;
+  struct stream_cfr *cfr = &driver->cfr;
+  uint32_t cap, exposure;
+  uint8_t *buf;
+  int retval;
+
+  cfr->applied = 0;
+  cfr->error = 0;
+  cfr->exposure_max = 0;
+  if (!driver->cfr_enable)
+    return;
+  buf = kmalloc(4, GFP_KERNEL);
+  if (!buf) {
+    cfr->error = -ENOMEM;
+    return;
+  }
+
+  // 1. AE priority: 0 = the frame rate stays constant, 1 = it may vary
+  buf[0] = 0;
+  retval = usb_control_msg(udev, usb_sndctrlpipe(udev, 0), SET_CUR,
+                           USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+                           CT_AE_PRIORITY_CONTROL, CAMERA_TERMINAL_INDEX, buf, 1, TIMEOUT);
+  if (retval < 0)
+    goto out;
+
+  // 2. Exposure time chosen by the host: keep it within one frame interval
+  retval = usb_control_msg(udev, usb_rcvctrlpipe(udev, 0), GET_CUR,
+                           USB_DIR_IN | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+                           CT_AE_MODE_CONTROL, CAMERA_TERMINAL_INDEX, buf, 1, TIMEOUT);
+  if (retval < 0)
+    goto out;
+  if (buf[0] & (AE_MODE_MANUAL | AE_MODE_SHUTTER_PRIORITY)) {
+    cap = max(driver->frame_interval_us / 100, 1U);
+    retval = usb_control_msg(udev, usb_rcvctrlpipe(udev, 0), GET_CUR,
+                             USB_DIR_IN | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+                             CT_EXPOSURE_TIME_ABSOLUTE_CONTROL, CAMERA_TERMINAL_INDEX, buf, 4, TIMEOUT);
+    if (retval < 0)
+      goto out;
+    exposure = buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+    if (exposure > cap) {
+      buf[0] = cap & 0xFF;
+      buf[1] = (cap >> 8) & 0xFF;
+      buf[2] = (cap >> 16) & 0xFF;
+      buf[3] = (cap >> 24) & 0xFF;
+      retval = usb_control_msg(udev, usb_sndctrlpipe(udev, 0), SET_CUR,
+                               USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+                               CT_EXPOSURE_TIME_ABSOLUTE_CONTROL, CAMERA_TERMINAL_INDEX, buf, 4, TIMEOUT);
+      if (retval < 0)
+        goto out;
+      printk(KERN_INFO "ELE784 -> Constant frame rate: exposure %u -> %u (x100us)\n", exposure, cap);
+    }
+    cfr->exposure_max = cap;
+  }
+  retval = 0;
+  cfr->applied = 1;
+
+out:
+  if (retval < 0) {
+    cfr->error = retval;
+    printk(KERN_WARNING "ELE784 -> Constant frame rate not applied (%d), the rate may drop in low light\n", retval);
+  }
+  kfree(buf);
+}
+
+// Size of still image pattern index (1-based) from the VS_STILL_IMAGE_FRAME
+// descriptor of the streaming interface. 0x0 when it is not described.
+static void ele784_still_size(struct usb_interface *interface, uint8_t index, uint16_t *width, uint16_t *height) {
+  const uint8_t *p = interface->altsetting[0].extra;
+  int left = interface->altsetting[0].extralen;
+
+  *width = 0;
+  *height = 0;
+  while (left >= 2 && p[0] >= 2 && p[0] <= left) {
+    // bLength bDescriptorType bDescriptorSubtype bEndpointAddress bNumImageSizePatterns {wWidth wHeight}*
+    if (p[0] >= 5 && p[1] == CS_INTERFACE && p[2] == VS_STILL_IMAGE_FRAME) {
+      if (index <= p[4] && p[0] >= 5 + 4 * index) {
+        *width  = p[5 + 4 * (index - 1)] | (p[6 + 4 * (index - 1)] << 8);
+        *height = p[7 + 4 * (index - 1)] | (p[8 + 4 * (index - 1)] << 8);
+      }
+      return;
+    }
+    left -= p[0];
+    p += p[0];
+  }
+}
+
+// Take one still image while the preview keeps streaming (UVC method 2):
+// negotiate it (STILL_PROBE / STILL_COMMIT), attach a buffer to the callback,
+// trigger it and wait until its last packet arrived.
+int ele784_still_capture(struct orbit_driver *driver, struct stream_snapshot *snap) {
+  struct usb_device *udev = driver->device;
+  struct driver_buffer *fb = &driver->frame_buf;
+  uint8_t *ctrl, *still = NULL;
+  uint32_t size;
+  unsigned long flags;
+  long left;
+  int retval, streaming;
+
+  mutex_lock(&driver->stream_lock);
+  streaming = driver->streaming;
+  mutex_unlock(&driver->stream_lock);
+  if (!streaming)
+    return -EINVAL;  // the still travels with the preview: STREAMON first
+  if (!snap->frame_index)
+    snap->frame_index = 1;
+  if (!snap->timeout_ms)
+    snap->timeout_ms = 2000;
+  ele784_still_size(driver->interface, snap->frame_index, &snap->width, &snap->height);
+
+  ctrl = kzalloc(VS_STILL_PROBE_CONTROL_SIZE, GFP_KERNEL);
+  if (!ctrl)
+    return -ENOMEM;
+  mutex_lock(&driver->still_lock);
+
+  // 1. STILL_PROBE (SET_CUR then GET_CUR): same format as the preview, wanted size
+  ctrl[0] = FORMAT_INDEX_UNCOMPRESSED_YUYV;
+  ctrl[1] = snap->frame_index;
+  ctrl[2] = 1;  // bCompressionIndex
+  retval = usb_control_msg(udev, usb_sndctrlpipe(udev, 0), SET_CUR,
+                           USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+                           VS_STILL_PROBE_CONTROL_VALUE, VS_PROBE_CONTROL_WINDEX_LE,
+                           ctrl, VS_STILL_PROBE_CONTROL_SIZE, TIMEOUT);
+  if (retval >= 0)
+    retval = usb_control_msg(udev, usb_rcvctrlpipe(udev, 0), GET_CUR,
+                             USB_DIR_IN | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+                             VS_STILL_PROBE_CONTROL_VALUE, VS_PROBE_CONTROL_WINDEX_LE,
+                             ctrl, VS_STILL_PROBE_CONTROL_SIZE, TIMEOUT);
+  // 2. STILL_COMMIT
+  if (retval >= 0)
+    retval = usb_control_msg(udev, usb_sndctrlpipe(udev, 0), SET_CUR,
+                             USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+                             VS_STILL_COMMIT_CONTROL_VALUE, VS_PROBE_CONTROL_WINDEX_LE,
+                             ctrl, VS_STILL_PROBE_CONTROL_SIZE, TIMEOUT);
+  if (retval < 0) {
+    printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SNAPSHOT: still probe/commit failed (%d)\n", retval);
+    goto out;
+  }
+
+  // 3. Buffer of dwMaxVideoFrameSize (or the descriptor size), attached to the callback
+  size = ctrl[3] | (ctrl[4] << 8) | (ctrl[5] << 16) | ((uint32_t)ctrl[6] << 24);
+  if (size == 0)
+    size = (uint32_t)snap->width * snap->height * 2;
+  if (size == 0 || size > 32 * EXPECTED_FRAME_SIZE) {
+    printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SNAPSHOT: unusable still size %u\n", size);
+    retval = -EIO;
+    goto out;
+  }
+  still = vmalloc(size);
+  if (!still) {
+    retval = -ENOMEM;
+    goto out;
+  }
+  // Armed under stream_lock: a STREAMOFF from here on completes still_done
+  mutex_lock(&driver->stream_lock);
+  if (!driver->streaming) {
+    mutex_unlock(&driver->stream_lock);
+    retval = -EIO;
+    goto out;
+  }
+  spin_lock_irqsave(&fb->Lock, flags);
+  fb->StillData    = still;
+  fb->StillMax     = size;
+  fb->StillBytes   = 0;
+  fb->StillDamaged = 0;
+  fb->StillState   = STILL_ARMED;
+  reinit_completion(&fb->still_done);
+  spin_unlock_irqrestore(&fb->Lock, flags);
+  mutex_unlock(&driver->stream_lock);
+
+  // 4. STILL_IMAGE_TRIGGER: the camera sends it after the current preview frame
+  ctrl[0] = STILL_TRIGGER_TRANSMIT;
+  retval = usb_control_msg(udev, usb_sndctrlpipe(udev, 0), SET_CUR,
+                           USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+                           VS_STILL_IMAGE_TRIGGER_CONTROL_VALUE, VS_PROBE_CONTROL_WINDEX_LE,
+                           ctrl, 1, TIMEOUT);
+  if (retval >= 0 && driver->disconnected) {
+    retval = -ENODEV;  // disconnect completed still_done before the reinit above
+  } else if (retval >= 0) {
+    left = wait_for_completion_interruptible_timeout(&fb->still_done, msecs_to_jiffies(snap->timeout_ms));
+    retval = (left < 0) ? left : 0;
+  }
+
+  // 5. Detach the buffer (the callback stops using it under Lock)
+  spin_lock_irqsave(&fb->Lock, flags);
+  if (retval == 0 && fb->StillState != STILL_DONE)
+    retval = (fb->Status & (BUF_STREAM_FAILED | BUF_STREAM_STOPPED)) ? -EIO : -ETIMEDOUT;
+  fb->StillState = STILL_IDLE;
+  fb->StillData  = NULL;
+  spin_unlock_irqrestore(&fb->Lock, flags);
+  if (retval < 0) {
+    printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SNAPSHOT: no still image (%d)\n", retval);
+    goto out;
+  }
+
+  snap->flags = fb->StillDamaged ? FRAME_FLAG_REPAIRED : FRAME_FLAG_COMPLETE;
+  if (copy_to_user((void __user *)snap->data, still, min(snap->size, fb->StillBytes)))
+    retval = -EFAULT;
+  snap->size = fb->StillBytes;
+  ele784_dbg("ELE784 -> IOCTL_STREAM_SNAPSHOT: %u bytes (%ux%u)\n", snap->size, snap->width, snap->height);
+
+out:
+  mutex_unlock(&driver->still_lock);
+  vfree(still);
+  kfree(ctrl);
+  return retval;
+}
+
+// Start streaming (IOCTL_STREAMON) and arm the watchdog. A stream already
+// running is left alone (-EBUSY). Called with stream_lock held.
+int ele784_stream_start(struct orbit_driver *driver) {
+  int retval;
+
+  if (driver->streaming)
+    return -EBUSY;
+  retval = ele784_stream_arm(driver);
+  if (retval < 0) {
+    ele784_free_urbs(driver);
+    ele784_release_frame_buffers(driver);
+    return retval;
+  }
+
+  driver->resume_streaming = 0;
+  ele784_stream_running(driver);
+  return 0;
+}
+
+// Stream is submitted: mark it running and (re)arm the watchdog
+static void ele784_stream_running(struct orbit_driver *driver) {
+  struct driver_buffer *fb = &driver->frame_buf;
+
+  driver->streaming   = 1;
+  driver->wd_retries  = 0;
+  driver->wd_frames   = fb->Stats.frames_completed + fb->Stats.frames_repaired;
+  driver->wd_failures = fb->Stats.resubmit_failures;
+  if (watchdog_frames)
+    schedule_delayed_work(&driver->watchdog, ele784_watchdog_period(driver));
+}
+
+// Restart a stream interrupted by a reset, a suspend or a re-enumeration:
+// the format is committed again and the URBs resubmitted, the frame buffers
+// are kept. The next frame is flagged FRAME_FLAG_RECOVERED. Called with stream_lock held.
+int ele784_stream_resume(struct orbit_driver *driver) {
+  struct driver_buffer *fb = &driver->frame_buf;
+  unsigned long flags;
+  int retval;
+
+  driver->resume_streaming = 0;
+  retval = ele784_stream_arm(driver);
+  if (retval < 0) {
+    printk(KERN_ERR "ELE784 -> Resume : stream restart failed (%d)\n", retval);
+    ele784_stream_fail(driver);
+    return retval;
+  }
+  spin_lock_irqsave(&fb->Lock, flags);
+  fb->Recovered = 1;
+  spin_unlock_irqrestore(&fb->Lock, flags);
+  fb->Stats.recoveries++;
+  ele784_stream_running(driver);
+  printk(KERN_INFO "ELE784 -> Resume : stream restarted\n");
+  return 0;
+}
+
+// The stream is lost for good: wake the readers, they get -EIO until the next STREAMON
+void ele784_stream_fail(struct orbit_driver *driver) {
+  struct driver_buffer *fb = &driver->frame_buf;
+  unsigned long flags;
+
+  spin_lock_irqsave(&fb->Lock, flags);
+  fb->Status |= BUF_STREAM_FAILED;
+  spin_unlock_irqrestore(&fb->Lock, flags);
+  complete_all(&fb->urb_completion);
+  complete(&fb->still_done);
+  driver->streaming = 0;
+}
+
+// Negotiate the format, select the alternate setting, allocate the frame
+// buffers (kept when their size did not change, so a watchdog recovery does
+// not free them under a reader) and the URBs of the selected geometry
+// profile, then submit them. On failure the frame buffers are left allocated.
+int ele784_stream_arm(struct orbit_driver *driver) {
+  struct usb_device *udev = driver->device;
+  struct usb_interface *interface = driver->interface;
+  struct driver_buffer *fb = &driver->frame_buf;
+  uint32_t bandwidth, psize, size, npackets, urb_size, urb_count, in_flight;
+  struct usb_host_endpoint *ep = NULL;
+  struct usb_host_interface *alts;
+  int	   best_altset;
+  uint8_t *data;
+  unsigned long flags;
+  int i, j, retval;
+
+  // Profile set since the last STREAMON; the URBs of the previous one are freed
+  fb->Profile = driver->urb_profile;
+
+  // Synthetic source: the camera is not asked to stream
+  if (driver->synth_cfg.enable)
+    return ele784_synth_arm(driver);
+
+  // allocation data buffer for 34 bytes (VS_PROBE_CONTROL message length =  VS_PROBE_CONTROL_SIZE)
+  data = kmalloc( VS_PROBE_CONTROL_SIZE, GFP_KERNEL);
+  if (!data) {
+    printk(KERN_ERR "ELE784 -> IOCTL_STREAMON : kmalloc(%d) failed\n", VS_PROBE_CONTROL_SIZE);
+    return -ENOMEM;
+  }
+
+  retval = ele784_stream_commit(driver, data);
+  if (retval < 0) {
+    kfree(data);
+    return retval;
+  }
+  // Committed frame interval (100 ns units), used by the watchdog
+  driver->frame_interval_us = ((((uint32_t) data[7]) << 24) | (((uint32_t) data[6]) << 16) |
+                               (((uint32_t) data[5]) << 8) | ((uint32_t) data[4])) / 10;
+  if (driver->frame_interval_us == 0)
+    driver->frame_interval_us = FRAME_INTERVAL_30FPS / 10;
+  // Hold that interval in low light (IOCTL_STREAM_SET_CFR)
+  ele784_stream_cfr(driver);
+
+  printk(KERN_INFO "ELE784 -> IOCTL_STREAMON: VS interface #1 has %u altsettings\n",interface->num_altsetting);
+  
+  //not sure about the bandwidth and size calculation, need to check with teacher's macros
+  // avec les infos du get_cur
+
+  // À partir des données de configurations obtenues, détermine la Bande Passante et la taille des transferts :	  
+  bandwidth = (((uint32_t) data[25]) << 24) | (((uint32_t) data[24]) << 16) | (((uint32_t) data[23]) << 8) | (((uint32_t) data[22]) << 0);
+  size      = (((uint32_t) data[21]) << 24) | (((uint32_t) data[20]) << 16) | (((uint32_t) data[19]) << 8) | (((uint32_t) data[18]) << 0);
+  kfree(data);
+  data = NULL;
+  printk(KERN_INFO "ELE784 -> IOCTL_STREAMON: bandwidth = %u  size = %u\n",bandwidth, size);
+  // Selon la Bande Passante et la taille des Paquets, trouve la meilleure "Interface Alternative" a utiliser (dépend de la résolution Video choisie)
+  // Note :	Chacune de ces "Interfaces Alternatives" n'a qu'un seul Endpoint...donc on conserve l'info sur ce Endpoint.
+  for (best_altset = 0; best_altset < interface->num_altsetting; best_altset++) {
+    alts = &(interface->altsetting[best_altset]);
+    if (alts->desc.bNumEndpoints < 1)
+      continue;
+    ep = &(alts->endpoint[0]);
+
+
+    /* Skip anything that is NOT isochronous */
+    if (!usb_endpoint_xfer_isoc(&ep->desc)) {
+        printk(KERN_INFO "ELE784 -> alt=%d: not isochronous, skipping\n",best_altset);
+        ep = NULL;
+        continue;
+    }
+    psize = (ep->desc.wMaxPacketSize & 0x07ff) * (((ep->desc.wMaxPacketSize >> 11) & 0x0003) + 1);
+    if (psize >= bandwidth)
+      break;
+  }
+  if (ep == NULL) {
+    printk(KERN_WARNING "ELE784 -> IOCTL_STREAMON : No Endpoint found error");
+    return -ENOMEM;
+  }
+
+  // Géométrie des Urbs selon le profil choisi (nombre d'Urbs, paquets par Urb, Urbs soumis au départ).
+  switch (fb->Profile) {
+  case URB_PROFILE_LOW_LATENCY:
+    urb_count = URB_MAX;
+    npackets  = URB_LOW_LATENCY_PACKETS;
+    in_flight = URB_MAX;
+    break;
+  case URB_PROFILE_ADAPTIVE:
+    urb_count = URB_MAX;
+    npackets  = URB_ADAPTIVE_PACKETS;
+    in_flight = URB_COUNT;
+    break;
+  default:
+    // Avec l'interface choisie, on détermine le nombre de Paquets que chaque Urb aura à transporter.
+    urb_count = URB_COUNT;
+    npackets  = ((size % psize) > 0) ? (size/psize + 1) : (size/psize);
+    in_flight = URB_COUNT;
+    break;
+  }
+
+  //need to clamp npackets to MAX_PACKETS
+  if (npackets > MAX_PACKETS) {
+    npackets = MAX_PACKETS;
+  }
+  urb_size = psize*npackets;
+  printk(KERN_INFO "ELE784 -> IOCTL_STREAMON : bandwidth = %u psize = %u npackets = %u urb_size = %u best_altset = %u urbs = %u/%u\n",
+         bandwidth, psize, npackets, urb_size, best_altset, in_flight, urb_count);
+  // Et on alloue dynamiquement (obligatoire) le tampon où seront placées les données récoltées par les Urbs.   		
+  if ((!fb->Data || fb->MaxLength != size) && ele784_alloc_frame_buffers(fb, size) < 0) {
+    printk(KERN_WARNING "ELE784 -> IOCTL_STREAMON : No memory for frame buffer (%u bytes)\n", size);
+    return -ENOMEM;
+  }
+  fb->MaxLength = size;
+
+  // Géométrie active et compteurs de l'adaptation
+  fb->UrbCount      = urb_count;
+  fb->InFlight      = in_flight;
+  fb->Packets       = npackets;
+  fb->PacketSize    = psize;
+  fb->ParkedCount   = 0;
+  fb->CleanCompletions = 0;
+
+  // On a besoin d'un mécanisme de synchro pour la détection du début d'un "Frame" (une image) et la détection de la fin de chaque Urb.
+  // (initialisés au probe, un read() peut donc attendre avant STREAMON)
+  reinit_completion(&(fb->new_frame_start));
+  reinit_completion(&(fb->urb_completion));
+
+  // read() and the callback use these under fb->Lock (the watchdog re-arms a live stream)
+  spin_lock_irqsave(&fb->Lock, flags);
+  fb->BytesUsed = 0;
+  fb->SrcOffset = 0;
+  fb->LastFID = -1; // <-- Initialize ONCE during STREAMON
+  fb->Status = BUF_STREAM_READ;
+  spin_unlock_irqrestore(&fb->Lock, flags);
+
+  // Ici, on rend "courante" l'interface alternative choisie comme étant la meilleure.
+  retval = usb_set_interface(udev, 1, best_altset); //Important pour mettre la camera dans le bon mode
+  if (retval < 0) {
+    return retval;
+  }
+  printk(KERN_INFO "ELE784 -> IOCTL_STREAMON : usb_set_interface successful retval = %d\n",retval);
+
+  // Finalement, on créé les Urbs Isochronous (un total de urb_count Urbs).
+  for (i = 0; i < urb_count; i++) {
+    struct urb *urb = usb_alloc_urb(npackets, GFP_KERNEL);
+    if (urb == NULL) {
+      printk(KERN_WARNING "ELE784 -> IOCTL_STREAMON : URB allocation error");
+      retval = -ENOMEM;
+      break;
+    }
+    driver->isoc_in_urb[i] = urb;
+
+    urb->transfer_buffer = usb_alloc_coherent(udev, urb_size, GFP_KERNEL, &(urb->transfer_dma));
+    if (urb->transfer_buffer == NULL) {
+      printk(KERN_WARNING "ELE784 -> IOCTL_STREAMON : Transfert buffer allocation error");
+      retval = -ENOMEM;
+      break;
+    }
+
+    /*******************************************************************************
+    Ici, il s'agit d'initialiser l'Urb Isochronous (voir acétate 16 du cours # 5)
+    Suggestion :	Attacher la structure (driver->frame_buf) au champ "context" de la structure du Urb.
+    ******* ************************************************************************/
+    /* Pointeur vers le device */
+    urb->dev = udev;
+    /* Contexte transmis au callback */
+    urb->context = fb;
+    /* Endpoint Isochronous IN */
+    urb->pipe = usb_rcvisocpipe(udev, ep->desc.bEndpointAddress);
+    /* Flags recommandés */
+    urb->transfer_flags = URB_ISO_ASAP | URB_NO_TRANSFER_DMA_MAP;
+    /* Intervalle d'interrogation (polling) */
+    urb->interval = ep->desc.bInterval;
+    /* Callback qui sera appelé quand l’URB est complété */
+    urb->complete = complete_callback;
+    /* Nombre de paquets dans l’URB */
+    urb->number_of_packets = npackets;
+    /* Taille totale du buffer */
+    urb->transfer_buffer_length = urb_size;
+    /* Configurer les paquets ISO individuellement */
+    for (j = 0; j < npackets; j++) {
+        urb->iso_frame_desc[j].offset = j * psize;
+        urb->iso_frame_desc[j].length = psize;
+    }
+  }
+  if (retval < 0) {
+    ele784_free_urbs(driver);
+    usb_set_interface(udev, 1, 0);
+    return retval;
+  }
+
+  // Les Urbs au-delà de la profondeur initiale sont gardés en réserve pour le profil adaptatif.
+  for (i = in_flight; i < urb_count; i++) {
+    fb->Parked[fb->ParkedCount++] = driver->isoc_in_urb[i];
+  }
+
+  // Et on lance tous les Urbs actifs. 
+  /* ====== ÉTAPE 3 : Soumission des URBs ====== */
+  for (i = 0; i < in_flight; i++) {
+    retval = usb_submit_urb(driver->isoc_in_urb[i], GFP_KERNEL);
+    if (retval < 0) {
+      printk(KERN_ERR "ELE784 -> IOCTL_STREAMON: usb_submit_urb[%d] failed (%d)\n",i, retval);
+      /* rollback: kill + free every URB (the caller frees the frame buffers) */
+      ele784_free_urbs(driver);
+      usb_set_interface(udev, 1, 0);
+      return retval;
+    }
+  } 
+
+  printk(KERN_INFO "ELE784 -> IOCTL_STREAMON: streaming started (%u URBs submitted)\n", in_flight);
+  return 0;
+}
+
+// Feed the frame assembly from the synthetic source (IOCTL_STREAM_SET_SYNTH)
+// instead of the URBs. The settings are latched here, the frame buffers are
+// set up as for the camera. Called from ele784_stream_arm.
+int ele784_synth_arm(struct orbit_driver *driver) {
+  struct driver_buffer *fb = &driver->frame_buf;
+  struct synth_source *synth = &driver->synth;
+  unsigned long flags;
+  int retval;
+
+  synth->cfg = driver->synth_cfg;
+  if (synth->cfg.fps == 0)
+    synth->cfg.fps = SYNTH_DEFAULT_FPS;
+  if (synth->cfg.packet_size == 0)
+    synth->cfg.packet_size = SYNTH_DEFAULT_PACKET;
+  retval = synth_build(synth);
+  if (retval < 0) {
+    printk(KERN_WARNING "ELE784 -> IOCTL_STREAMON : No memory for the synthetic packets\n");
+    return retval;
+  }
+  driver->frame_interval_us = USEC_PER_SEC / synth->cfg.fps;
+
+  if ((!fb->Data || fb->MaxLength != EXPECTED_FRAME_SIZE) && ele784_alloc_frame_buffers(fb, EXPECTED_FRAME_SIZE) < 0) {
+    printk(KERN_WARNING "ELE784 -> IOCTL_STREAMON : No memory for frame buffer (%u bytes)\n", EXPECTED_FRAME_SIZE);
+    return -ENOMEM;
+  }
+  fb->MaxLength = EXPECTED_FRAME_SIZE;
+
+  // No URB: the geometry reports the packets sent per timer expiration
+  fb->UrbCount      = 0;
+  fb->InFlight      = 0;
+  fb->PacketSize    = synth->cfg.packet_size;
+  fb->ParkedCount   = 0;
+  fb->CleanCompletions = 0;
+
+  reinit_completion(&(fb->new_frame_start));
+  reinit_completion(&(fb->urb_completion));
+  spin_lock_irqsave(&fb->Lock, flags);
+  fb->BytesUsed = 0;
+  fb->SrcOffset = 0;
+  fb->LastFID   = -1;
+  fb->Status    = BUF_STREAM_READ;
+  spin_unlock_irqrestore(&fb->Lock, flags);
+
+  synth_start(synth, fb);
+  fb->Packets = min_t(uint64_t, SYNTH_MAX_BURST, div64_u64(SYNTH_TICK_NS, synth->slot_ns));
+  printk(KERN_INFO "ELE784 -> IOCTL_STREAMON: synthetic source, %u fps, %u packets of %u bytes per frame\n",
+         synth->cfg.fps, synth->npk, synth->cfg.packet_size);
+  return 0;
+}
+
+// Kill and free every URB (and its DMA buffer) of the stream
+void ele784_free_urbs(struct orbit_driver *driver) {
+  int i;
+
+  /* 0) Synthetic source: stop its timer (it has no URB) */
+  synth_stop(&driver->synth);
+
+  /* 1) Kill all URBs. Poisoning also blocks a parked URB that the adaptive
+   *    profile would try to submit from the callback in the meantime. */
+  for (i = 0; i < URB_MAX; i++) {
+    if (driver->isoc_in_urb[i]) {
+      usb_poison_urb(driver->isoc_in_urb[i]);
+    }
+  }
+
+  /* 2) Free URB resources */
+  for (i = 0; i < URB_MAX; i++) {
+    if (driver->isoc_in_urb[i]) {
+      if (driver->isoc_in_urb[i]->transfer_buffer) {
+        usb_free_coherent(driver->device,
+              driver->isoc_in_urb[i]->transfer_buffer_length,
+              driver->isoc_in_urb[i]->transfer_buffer,
+              driver->isoc_in_urb[i]->transfer_dma);
+      }
+      usb_free_urb(driver->isoc_in_urb[i]);
+      driver->isoc_in_urb[i] = NULL;
+    }
+  }
+  driver->frame_buf.ParkedCount = 0;
+  driver->frame_buf.InFlight = 0;
+}
+
+// Stop streaming: kill the URBs, free the buffers and go back to altsetting 0.
+// Called with stream_lock held, the watchdog already cancelled.
+void ele784_stream_stop(struct orbit_driver *driver) {
+  driver->streaming = 0;
+  driver->resume_streaming = 0;
+  ele784_free_urbs(driver);
+
+  /* 3) Free frame buffer (after a read() still copying) and wake the blocked readers */
+  ele784_release_frame_buffers(driver);
+
+  /* A snapshot still waiting gives up */
+  complete(&driver->frame_buf.still_done);
+
+  /* 4) Set altsetting 0 (stop streaming) */
+  usb_set_interface(driver->device, 1, 0);
+
+  /* 5) Reset completions (read() re-arms urb_completion itself, under fb->Lock) */
+  reinit_completion(&driver->frame_buf.new_frame_start);
+}
+
+// Watchdog period: watchdog_frames delivered-frame intervals (decimation included)
+static unsigned long ele784_watchdog_period(struct orbit_driver *driver) {
+  uint64_t us = (uint64_t)watchdog_frames * driver->frame_interval_us * max_t(uint16_t, driver->frame_buf.DeliverEvery, 1);
+
+  return usecs_to_jiffies(max_t(uint64_t, us, WATCHDOG_MIN_PERIOD_MS * 1000));
+}
+
+// Stream watchdog: when no frame was delivered during a whole period, or the
+// URB resubmissions keep failing, kill the URBs and redo the commit,
+// altsetting and submission. The frame buffers are kept, so a blocked
+// read() simply gets the next frame, flagged FRAME_FLAG_RECOVERED.
+// After WATCHDOG_MAX_RETRIES failed recoveries read() returns -EIO.
+void ele784_watchdog_work(struct work_struct *work) {
+  struct orbit_driver  *driver = container_of(to_delayed_work(work), struct orbit_driver, watchdog);
+  struct driver_buffer *fb = &driver->frame_buf;
+  uint32_t frames, failures;
+  unsigned long flags;
+  int stalled, storm, retval;
+
+  mutex_lock(&driver->stream_lock);
+  if (!driver->streaming || !watchdog_frames) {
+    mutex_unlock(&driver->stream_lock);
+    return;
+  }
+
+  frames   = fb->Stats.frames_completed + fb->Stats.frames_repaired;
+  failures = fb->Stats.resubmit_failures;
+  stalled  = (frames == driver->wd_frames);
+  storm    = (failures - driver->wd_failures >= WATCHDOG_RESUBMIT_STORM);
+
+  if (stalled || storm) {
+    printk(KERN_WARNING "ELE784 -> Watchdog : stream stalled (%s), restarting it\n",
+           storm ? "URB resubmit errors" : "no frame");
+    ele784_free_urbs(driver);
+    usb_set_interface(driver->device, 1, 0);
+    retval = ele784_stream_arm(driver);
+
+    if (retval < 0) {
+      printk(KERN_ERR "ELE784 -> Watchdog : restart failed (%d), attempt %u/%u\n",
+             retval, driver->wd_retries + 1, WATCHDOG_MAX_RETRIES);
+      if (++driver->wd_retries >= WATCHDOG_MAX_RETRIES) {
+        // Give up: wake the readers, they get -EIO until the next STREAMON
+        ele784_stream_fail(driver);
+        mutex_unlock(&driver->stream_lock);
+        return;
+      }
+    } else {
+      driver->wd_retries = 0;
+      spin_lock_irqsave(&fb->Lock, flags);
+      fb->Recovered = 1;
+      spin_unlock_irqrestore(&fb->Lock, flags);
+      fb->Stats.recoveries++;
+    }
+    frames   = fb->Stats.frames_completed + fb->Stats.frames_repaired;
+    failures = fb->Stats.resubmit_failures;
+  }
+
+  driver->wd_frames   = frames;
+  driver->wd_failures = failures;
+  mutex_unlock(&driver->stream_lock);
+  schedule_delayed_work(&driver->watchdog, ele784_watchdog_period(driver));
+}
+
+// =====================================================
+// STATIC ATTRIBUTE CACHE
+// Min, max, resolution, length and default of a control do not change
+// while the camera is attached: the first answer is kept and served again.
+// GET_INFO is not cached, its state bits follow other controls (e.g. an
+// auto mode disables the manual one). Called with ctrl_lock held.
+// =====================================================
+static bool ele784_attr_static(uint8_t request) {
+  return request == GET_MIN || request == GET_MAX || request == GET_RES ||
+         request == GET_LEN || request == GET_DEF;
+}
+
+static struct ctrl_attr *ele784_attr_find(struct orbit_driver *dev, const struct usb_request *op) {
+  unsigned int i, n = min(dev->ctrl_attr_count, (unsigned int)CTRL_ATTR_CACHE_SIZE);
+
+  for (i = 0; i < n; i++) {
+    struct ctrl_attr *a = &dev->ctrl_attrs[i];
+
+    if (a->request == op->request && a->value == op->value && a->index == op->index)
+      return a;
+  }
+  return NULL;
+}
+
+// Cached answer copied to buf: number of bytes, or -ENOENT
+int ele784_attr_lookup(struct orbit_driver *dev, const struct usb_request *op, uint8_t *buf) {
+  struct ctrl_attr *a;
+  int len;
+
+  if (!ele784_attr_static(op->request))
+    return -ENOENT;
+  a = ele784_attr_find(dev, op);
+  // An entry filled by a shorter request cannot answer a longer one
+  if (!a || op->data_size > a->asked)
+    return -ENOENT;
+  len = min_t(int, a->len, op->data_size);
+  memcpy(buf, a->data, len);
+  return len;
+}
+
+void ele784_attr_store(struct orbit_driver *dev, const struct usb_request *op, const uint8_t *buf, int len) {
+  struct ctrl_attr *a;
+
+  if (!ele784_attr_static(op->request) || op->data_size > CTRL_ATTR_MAX_LEN || len < 0)
+    return;
+  a = ele784_attr_find(dev, op);
+  if (!a)
+    a = &dev->ctrl_attrs[dev->ctrl_attr_count++ % CTRL_ATTR_CACHE_SIZE];
+  a->request = op->request;
+  a->value   = op->value;
+  a->index   = op->index;
+  a->asked   = op->data_size;
+  a->len     = len;
+  memcpy(a->data, buf, len);
+}
+
+void ele784_attr_invalidate(struct orbit_driver *dev) {
+  mutex_lock(&dev->ctrl_lock);
+  dev->ctrl_attr_count = 0;
+  mutex_unlock(&dev->ctrl_lock);
+}
+
+// One class request on the default pipe, through the preallocated control
+// buffer (data_size is 8 bits, CTRL_BUF_SIZE bytes always fit). dir is
+// USB_DIR_IN for a GET, USB_DIR_OUT for a SET. Called with ctrl_lock held.
+static int ele784_ctrl_xfer(struct orbit_driver *driver, struct usb_device *udev, const struct usb_request *op, int dir) {
+  int in = (dir == USB_DIR_IN);
+  int retval;
+
+  if (!in && op->data_size && copy_from_user(driver->ctrl_buf, (void __user *)op->data, op->data_size))
+    return -EFAULT;
+  if (in) {
+    retval = ele784_attr_lookup(driver, op, driver->ctrl_buf);
+    if (retval >= 0) {
+      if (retval > 0 && copy_to_user((void __user *)op->data, driver->ctrl_buf, retval))
+        return -EFAULT;
+      return 0;
+    }
+  }
+
+  retval = usb_control_msg(udev,
+                           in ? usb_rcvctrlpipe(udev, 0) : usb_sndctrlpipe(udev, 0),
+                           op->request,
+                           (in ? USB_DIR_IN : USB_DIR_OUT) | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+                           op->value,
+                           op->index,
+                           driver->ctrl_buf,
+                           op->data_size,
+                           CTRL_TIMEOUT(op->timeout));
+  if (retval < 0)
+    return retval;
+  if (in)
+    ele784_attr_store(driver, op, driver->ctrl_buf, retval);
+  if (in && retval > 0 && copy_to_user((void __user *)op->data, driver->ctrl_buf, retval))
+    return -EFAULT;
+  return 0;
+}
+
+// =====================================================
+// ASYNCHRONOUS PAN/TILT
+// =====================================================
+
+// Read the capabilities of the pan/tilt unit (probe). Each request that
+// fails keeps the Orbit defaults, so the driver works with any variant. A
+// camera that does not answer GET_INFO is not asked the rest, so probe
+// waits at most CAPS_TIMEOUT for it.
+void ele784_pantilt_query_caps(struct orbit_driver *dev) {
+  static const uint8_t requests[] = { GET_MIN, GET_MAX, GET_RES, GET_DEF };
+  struct usb_device *udev = dev->device;
+  struct pantilt_caps caps = {
+    .pan_min  = PANTILT_PAN_MIN,  .pan_max  = PANTILT_PAN_MAX,
+    .tilt_min = PANTILT_TILT_MIN, .tilt_max = PANTILT_TILT_MAX,
+    .pan_res  = 64,               .tilt_res = 64,  // one degree
+  };
+  int16_t value[ARRAY_SIZE(requests)][2];
+  int i, ret;
+
+  dev->pt_info.vendor  = le16_to_cpu(udev->descriptor.idVendor);
+  dev->pt_info.product = le16_to_cpu(udev->descriptor.idProduct);
+  dev->pt_info.release = le16_to_cpu(udev->descriptor.bcdDevice);
+
+  mutex_lock(&dev->ctrl_lock);
+  ret = usb_control_msg(udev, usb_rcvctrlpipe(udev, 0), GET_INFO,
+                        USB_DIR_IN | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+                        PANTILT_RELATIVE_CONTROL, PANTILT_INDEX, dev->ctrl_buf, 1, CAPS_TIMEOUT);
+  dev->pt_info.from_device = (ret == 1);
+  dev->pt_info.info = (ret == 1) ? dev->ctrl_buf[0] : 0;
+
+  for (i = 0; ret != -ETIMEDOUT && i < ARRAY_SIZE(requests); i++) {
+    struct usb_request op = {
+      .request = requests[i], .data_size = 4,
+      .value = PANTILT_RELATIVE_CONTROL, .index = PANTILT_INDEX,
+    };
+
+    ret = usb_control_msg(udev, usb_rcvctrlpipe(udev, 0), requests[i],
+                          USB_DIR_IN | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+                          PANTILT_RELATIVE_CONTROL, PANTILT_INDEX, dev->ctrl_buf, 4, CAPS_TIMEOUT);
+    if (ret != 4)
+      break;
+    // Prefetched for IOCTL_GET as well
+    ele784_attr_store(dev, &op, dev->ctrl_buf, ret);
+    value[i][0] = (int16_t)(dev->ctrl_buf[0] | (dev->ctrl_buf[1] << 8));
+    value[i][1] = (int16_t)(dev->ctrl_buf[2] | (dev->ctrl_buf[3] << 8));
+  }
+  mutex_unlock(&dev->ctrl_lock);
+
+  // Keep the answer only when it is complete and describes a range around 0
+  if (i == ARRAY_SIZE(requests) &&
+      value[0][0] < 0 && value[1][0] > 0 && value[0][1] < 0 && value[1][1] > 0) {
+    caps.pan_min  = value[0][0];
+    caps.tilt_min = value[0][1];
+    caps.pan_max  = value[1][0];
+    caps.tilt_max = value[1][1];
+    caps.pan_res  = value[2][0] > 0 ? value[2][0] : caps.pan_res;
+    caps.tilt_res = value[2][1] > 0 ? value[2][1] : caps.tilt_res;
+    caps.pan_def  = value[3][0];
+    caps.tilt_def = value[3][1];
+    caps.from_device = 1;
+  } else {
+    printk(KERN_WARNING "ELE784 -> Pan/tilt capabilities not reported (%d), using the Orbit defaults\n", ret);
+  }
+  dev->pt_caps = caps;
+  printk(KERN_INFO "ELE784 -> Pan/tilt: pan [%d, %d] tilt [%d, %d] res %u/%u info 0x%02x\n",
+         caps.pan_min, caps.pan_max, caps.tilt_min, caps.tilt_max,
+         caps.pan_res, caps.tilt_res, dev->pt_info.info);
+}
+
+// Motion-time model: how long the head needs to travel pan and tilt units
+// (both axes move at the same time)
+static unsigned long ele784_pantilt_motion_time(int pan, int tilt) {
+  unsigned int pan_ms  = abs(pan) * 1000 / max(pan_speed, 1U);
+  unsigned int tilt_ms = abs(tilt) * 1000 / max(tilt_speed, 1U);
+
+  return msecs_to_jiffies(max(pan_ms, tilt_ms) + settle_ms);
+}
+
+// The modeled motion is not over: its timer has not fired yet. (Comparing
+// jiffies with a stale pt_motion_end would flip after LONG_MAX jiffies.)
+static bool ele784_pantilt_moving(struct orbit_driver *dev) {
+  return timer_pending(&dev->pt_motion_timer);
+}
+
+// New end of motion; the timer wakes the waiters then. A motion still in
+// progress that ends later is kept. Called with pt_lock held.
+static void ele784_pantilt_motion(struct orbit_driver *dev, unsigned long duration) {
+  unsigned long end = jiffies + duration;
+
+  if (ele784_pantilt_moving(dev) && !time_after(end, dev->pt_motion_end))
+    return;
+  dev->pt_motion_end = end;
+  mod_timer(&dev->pt_motion_timer, dev->pt_motion_end);
+}
+
+// A relative move was commanded: update the tracked position (the head
+// stops at the end of its range) and the end of motion. Called with pt_lock held.
+static void ele784_pantilt_moved(struct orbit_driver *dev, int pan, int tilt) {
+  int from_pan = dev->pt_pos.pan, from_tilt = dev->pt_pos.tilt;
+
+  dev->pt_pos.pan  = clamp_t(int, dev->pt_pos.pan + pan, dev->pt_caps.pan_min, dev->pt_caps.pan_max);
+  dev->pt_pos.tilt = clamp_t(int, dev->pt_pos.tilt + tilt, dev->pt_caps.tilt_min, dev->pt_caps.tilt_max);
+  if (dev->pt_pos.valid)
+    ele784_pantilt_motion(dev, ele784_pantilt_motion_time(dev->pt_pos.pan - from_pan, dev->pt_pos.tilt - from_tilt));
+  else
+    ele784_pantilt_motion(dev, ele784_pantilt_motion_time(pan, tilt));
+}
+
+// Reset: the head runs to its negative end stops, then back to the centre.
+// From an unknown position the worst case (positive end stop) is assumed.
+// Called with pt_lock held.
+static void ele784_pantilt_homing(struct orbit_driver *dev) {
+  int pan  = dev->pt_pos.valid ? dev->pt_pos.pan  : dev->pt_caps.pan_max;
+  int tilt = dev->pt_pos.valid ? dev->pt_pos.tilt : dev->pt_caps.tilt_max;
+
+  ele784_pantilt_motion(dev, ele784_pantilt_motion_time(pan - 2 * dev->pt_caps.pan_min, tilt - 2 * dev->pt_caps.tilt_min));
+  dev->pt_pos.pan = 0;
+  dev->pt_pos.tilt = 0;
+  dev->pt_pos.valid = 1;
+}
+
+// The head takes a new command: no transfer in flight and the modeled
+// motion is over (it ignores a command received while it is still moving).
+// Called with pt_lock held.
+static bool ele784_pantilt_ready(struct orbit_driver *dev) {
+  return !dev->pt_busy && !ele784_pantilt_moving(dev);
+}
+
+// No transfer queued or in flight, and the modeled motion is over
+static bool ele784_pantilt_idle(struct orbit_driver *dev) {
+  unsigned long flags;
+  bool idle;
+
+  spin_lock_irqsave(&dev->pt_lock, flags);
+  idle = ele784_pantilt_ready(dev) && !dev->pt_pending;
+  spin_unlock_irqrestore(&dev->pt_lock, flags);
+  return idle;
+}
+
+// Send the queued move if the head takes it now; otherwise the motion timer
+// (or the completion of the transfer in flight) sends it later. Called with pt_lock held.
+static int ele784_pantilt_kick(struct orbit_driver *dev) {
+  if (!dev->pt_pending || dev->disconnected || !ele784_pantilt_ready(dev))
+    return 0;
+  return ele784_pantilt_send(dev);
+}
+
+// End of the modeled motion: send the queued move, wake the waiters
+void ele784_pantilt_timer(struct timer_list *t) {
+  struct orbit_driver *dev = from_timer(dev, t, pt_motion_timer);
+  unsigned long flags;
+
+  spin_lock_irqsave(&dev->pt_lock, flags);
+  ele784_pantilt_kick(dev);
+  spin_unlock_irqrestore(&dev->pt_lock, flags);
+  wake_up_interruptible(&dev->pt_wait);
+}
+
+// Block until the motion is done (0), the timeout expires (-ETIMEDOUT, never
+// with timeout_ms = 0), a signal arrives or the camera goes away
+int ele784_pantilt_wait(struct orbit_driver *dev, unsigned int timeout_ms) {
+  long ret;
+
+  if (!timeout_ms) {
+    ret = wait_event_interruptible(dev->pt_wait, ele784_pantilt_idle(dev) || dev->disconnected);
+  } else {
+    ret = wait_event_interruptible_timeout(dev->pt_wait, ele784_pantilt_idle(dev) || dev->disconnected,
+                                           msecs_to_jiffies(timeout_ms));
+    if (ret == 0)
+      return -ETIMEDOUT;
+  }
+  if (ret < 0)
+    return ret;
+  return dev->disconnected ? -ENODEV : 0;
+}
+
+// Send the pending delta with the control URB. Called with pt_lock held.
+static int ele784_pantilt_send(struct orbit_driver *dev) {
+  struct pantilt_xfer *x = dev->pt_xfer;
+  int retval;
+
+  x->data[0] = dev->pt_pan & 0xFF;
+  x->data[1] = (dev->pt_pan >> 8) & 0xFF;
+  x->data[2] = dev->pt_tilt & 0xFF;
+  x->data[3] = (dev->pt_tilt >> 8) & 0xFF;
+  x->setup.bRequestType = USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE;
+  x->setup.bRequest     = SET_CUR;
+  x->setup.wValue       = cpu_to_le16(PANTILT_RELATIVE_CONTROL);
+  x->setup.wIndex       = cpu_to_le16(PANTILT_INDEX);
+  x->setup.wLength      = cpu_to_le16(4);
+  usb_fill_control_urb(dev->pt_urb, dev->device, usb_sndctrlpipe(dev->device, 0),
+                       (unsigned char *)&x->setup, x->data, 4, ele784_pantilt_complete, dev);
+
+  dev->pt_pan = 0;
+  dev->pt_tilt = 0;
+  dev->pt_pending = 0;
+  retval = usb_submit_urb(dev->pt_urb, GFP_ATOMIC);
+  dev->pt_busy = (retval == 0);
+  if (retval == 0) {
+    dev->pt_status.sent++;
+    ele784_pantilt_moved(dev, (int16_t)(x->data[0] | (x->data[1] << 8)), (int16_t)(x->data[2] | (x->data[3] << 8)));
+  } else {
+    dev->pt_status.last_error = retval;
+  }
+  return retval;
+}
+
+// Queue a relative move: sent at once when the head is ready, otherwise
+// added to the move waiting for the transfer in flight or the end of the motion.
+int ele784_pantilt_queue(struct orbit_driver *dev, int16_t pan, int16_t tilt) {
+  unsigned long flags;
+  int retval = 0;
+
+  spin_lock_irqsave(&dev->pt_lock, flags);
+  dev->pt_status.submitted++;
+  if (dev->pt_pending)
+    dev->pt_status.merged++;
+  dev->pt_pan  = clamp_t(int, dev->pt_pan + pan, S16_MIN, S16_MAX);
+  dev->pt_tilt = clamp_t(int, dev->pt_tilt + tilt, S16_MIN, S16_MAX);
+  dev->pt_pending = 1;
+  retval = ele784_pantilt_kick(dev);
+  spin_unlock_irqrestore(&dev->pt_lock, flags);
+  return retval;
+}
+
+// Control URB done: send the merged pending move, if any, once the motion is over
+void ele784_pantilt_complete(struct urb *urb) {
+  struct orbit_driver *dev = urb->context;
+  unsigned long flags;
+
+  spin_lock_irqsave(&dev->pt_lock, flags);
+  dev->pt_status.completed++;
+  dev->pt_status.last_error = urb->status;
+  dev->pt_busy = 0;
+  if (urb->status == -ENOENT || urb->status == -ECONNRESET || urb->status == -ESHUTDOWN) {
+    // Killed (disconnect): the camera is gone, forget the pending move
+    dev->pt_pending = 0;
+    dev->pt_pan = 0;
+    dev->pt_tilt = 0;
+  } else {
+    ele784_pantilt_kick(dev);
+  }
+  spin_unlock_irqrestore(&dev->pt_lock, flags);
+  wake_up_interruptible(&dev->pt_wait);
+}
+
+// Wait until the head takes a command, then set pt_busy for a synchronous
+// transfer: the asynchronous queue does not send in the meantime.
+// Called with pt_move_lock held.
+static int ele784_pantilt_claim(struct orbit_driver *dev) {
+  unsigned long flags;
+  int retval;
+
+  for (;;) {
+    retval = ele784_pantilt_wait(dev, 0);
+    if (retval < 0)
+      return retval;
+    spin_lock_irqsave(&dev->pt_lock, flags);
+    if (ele784_pantilt_ready(dev)) {
+      dev->pt_busy = 1;
+      spin_unlock_irqrestore(&dev->pt_lock, flags);
+      return 0;
+    }
+    // An asynchronous move was sent after the wait: wait for it too
+    spin_unlock_irqrestore(&dev->pt_lock, flags);
+  }
+}
+
+// One relative command sent synchronously through the control buffer, once
+// the head takes it: the tracked position only counts commands it executes.
+// Called with pt_move_lock held.
+static int ele784_pantilt_step(struct orbit_driver *dev, struct usb_device *udev, int pan, int tilt) {
+  unsigned long flags;
+  int retval;
+
+  retval = ele784_pantilt_claim(dev);
+  if (retval < 0)
+    return retval;
+
+  mutex_lock(&dev->ctrl_lock);
+  dev->ctrl_buf[0] = pan & 0xFF;
+  dev->ctrl_buf[1] = (pan >> 8) & 0xFF;
+  dev->ctrl_buf[2] = tilt & 0xFF;
+  dev->ctrl_buf[3] = (tilt >> 8) & 0xFF;
+  retval = usb_control_msg(udev, usb_sndctrlpipe(udev, 0), SET_CUR,
+                           USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+                           PANTILT_RELATIVE_CONTROL, PANTILT_INDEX,
+                           dev->ctrl_buf, 4, TIMEOUT);
+  mutex_unlock(&dev->ctrl_lock);
+
+  spin_lock_irqsave(&dev->pt_lock, flags);
+  dev->pt_busy = 0;
+  if (retval >= 0)
+    ele784_pantilt_moved(dev, pan, tilt);
+  else
+    ele784_pantilt_kick(dev);  // nothing moved: a queued move can go now
+  spin_unlock_irqrestore(&dev->pt_lock, flags);
+  wake_up_interruptible(&dev->pt_wait);
+  return retval < 0 ? retval : 0;
+}
+
+// Absolute move from the tracked position. The fewest commands are
+// max(|dpan| / pan_max, |dtilt| / tilt_max) rounded up; the delta
+// of each axis is spread evenly over them so both axes always move together.
+// Each command waits for the modeled end of the previous motion.
+int ele784_pantilt_absolute(struct orbit_driver *dev, struct usb_device *udev, struct pantilt_absolute *req) {
+  struct pantilt_position pos;
+  unsigned long flags;
+  int dpan, dtilt, n, i, sp, st;
+  int retval = 0;
+
+  mutex_lock(&dev->pt_move_lock);
+  spin_lock_irqsave(&dev->pt_lock, flags);
+  pos = dev->pt_pos;
+  spin_unlock_irqrestore(&dev->pt_lock, flags);
+  if (!pos.valid) {
+    // Position unknown: a reset is needed first
+    mutex_unlock(&dev->pt_move_lock);
+    return -ENODATA;
+  }
+
+  req->pan  = clamp_t(int, req->pan, dev->pt_caps.pan_min, dev->pt_caps.pan_max);
+  req->tilt = clamp_t(int, req->tilt, dev->pt_caps.tilt_min, dev->pt_caps.tilt_max);
+  dpan  = req->pan - pos.pan;
+  dtilt = req->tilt - pos.tilt;
+  // Largest relative command of each axis (the limits are symmetric on the Orbit)
+  n = max(DIV_ROUND_UP(abs(dpan), min(-dev->pt_caps.pan_min, (int)dev->pt_caps.pan_max)),
+          DIV_ROUND_UP(abs(dtilt), min(-dev->pt_caps.tilt_min, (int)dev->pt_caps.tilt_max)));
+
+  for (i = 0; i < n; i++) {
+    sp = dpan * (i + 1) / n - dpan * i / n;
+    st = dtilt * (i + 1) / n - dtilt * i / n;
+    // Sent once the previous motion is over
+    retval = ele784_pantilt_step(dev, udev, sp, st);
+    if (retval < 0)
+      break;
+  }
+  req->steps = i;
+  mutex_unlock(&dev->pt_move_lock);
+  return retval;
+}
+
+// poll(): on the control node, POLLOUT once every queued pan/tilt move was sent
+// (POLLERR if the last one failed). The stream node keeps the default behaviour.
+__poll_t ele784_poll(struct file *file, poll_table *wait) {
+  struct orbit_driver *dev = file->private_data;
+  unsigned long flags;
+  __poll_t mask = 0;
+
+  if (!dev)
+    return EPOLLERR | EPOLLHUP;
+  if (dev->class_driver != &class_control_driver)
+    return DEFAULT_POLLMASK;
+
+  poll_wait(file, &dev->pt_wait, wait);
+  spin_lock_irqsave(&dev->pt_lock, flags);
+  if (!dev->pt_busy && !dev->pt_pending) {
+    mask |= EPOLLOUT | EPOLLWRNORM;
+    if (!ele784_pantilt_moving(dev))
+      mask |= EPOLLIN | EPOLLRDNORM;  // motion done
+  }
+  if (dev->pt_status.last_error < 0)
+    mask |= EPOLLERR;
+  spin_unlock_irqrestore(&dev->pt_lock, flags);
+  if (!dev->interface)
+    mask |= EPOLLHUP;
+  return mask;
+}
+
+// IOCTL handler: runs the command under io_rwsem, so that a disconnect
+// cannot clear interface and device (or drop the usb_device) in the middle
+long ele784_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+  struct orbit_driver *driver = file->private_data;
+  long retval;
+
+  if (!driver)
+    return -ENODEV;
+  if (down_read_interruptible(&driver->io_rwsem))
+    return -ERESTARTSYS;
+  retval = ele784_do_ioctl(file, cmd, arg);
+  up_read(&driver->io_rwsem);
+  return retval;
+}
+
+// IOCTL handler for camera control commands (io_rwsem held)
+long ele784_do_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+
+  // Retrieve the driver data from file->private_data
+  struct orbit_driver  *driver = (struct orbit_driver *) file->private_data;
+  
+  // Validate the driver data
+  if (!driver) {
+    // If private_data is NULL, the device is disconnected or not properly opened
+    printk(KERN_ERR "ELE784 -> IOCTL called on disconnected device (private_data=NULL)\n");
+    return -ENODEV;
+  }else{
+    // Log the received IOCTL command for debugging
+    ele784_dbg("ELE784 -> IOCTL called with cmd=0x%08x\n", cmd);
+  }
+
+  // Further validate the interface pointer
+  if (!driver->interface || !driver->device) {
+    // If interface is NULL, the device has been disconnected
+    printk(KERN_ERR "ELE784 -> IOCTL called on disconnected device (interface=NULL)\n");
+    return -ENODEV;
+  }else{
+    // Log that the interface is valid
+    ele784_dbg("ELE784 -> IOCTL device interface is valid\n");
+  }
+
+  //device and interface pointers
+  struct usb_interface *interface = driver->interface;
+  // Get the usb_device structure for sending control messages
+  struct usb_device *udev = interface_to_usbdev(interface);
+
+  // Local variables for USB request parameters
+  struct usb_request user_request; // structure to hold user request
+  uint8_t  request;
+  uint16_t value, index, timeout; // USB request parameters
+  uint8_t  *data = NULL; // data buffer pointer
+
+  int i,j; // loop counters
+  long retval=0; // return value
+
+  // Handle different IOCTL commands
+  switch(cmd) {
+
+    // Handle IOCTL_GET command (get = reads from device/ ask to device)
+    case IOCTL_GET:
+      ele784_dbg("ELE784 -> IOCTL_GET\n");
+      /* ---------------------------------------------------------
+      * Step 1 — Copy the usb_request header from user space
+      * --------------------------------------------------------- */
+      if (copy_from_user(&user_request, (struct usb_request __user *)arg, sizeof(struct usb_request))) {
+        printk(KERN_ERR "ELE784 -> IOCTL_GET : copy_from_user (request) failed\n");
+        retval = -EFAULT;
+        break;
+      }
+      if (!driver->ctrl_buf) {
+        retval = -ENOTTY;  // streaming interface
+        break;
+      }
+      /* ---------------------------------------------------------
+      * Step 2 — Perform the USB GET request (device → host) through the
+      *          preallocated control buffer; a static attribute (GET_MIN,
+      *          GET_MAX, ...) already read is served without USB transfer
+      * --------------------------------------------------------- */
+      mutex_lock(&driver->ctrl_lock);
+      retval = ele784_ctrl_xfer(driver, udev, &user_request, USB_DIR_IN);
+      mutex_unlock(&driver->ctrl_lock);
+      if (retval < 0)
+        printk(KERN_ERR "ELE784 -> IOCTL_GET: request 0x%02x failed (%ld)\n", user_request.request, retval);
+      break; //  Required to exit the switch
+
+    // Several GET/SET requests back-to-back, through the preallocated control buffer
+    case IOCTL_BATCH:
+    {
+      struct usb_request_batch batch;
+      struct usb_request op;
+
+      ele784_dbg("ELE784 -> IOCTL_BATCH\n");
+      if (copy_from_user(&batch, (void __user *)arg, sizeof(batch))) {
+        printk(KERN_ERR "ELE784 -> IOCTL_BATCH: copy_from_user failed\n");
+        retval = -EFAULT;
+        break;
+      }
+      if (batch.count > USB_BATCH_MAX) {
+        printk(KERN_ERR "ELE784 -> IOCTL_BATCH: %u requests (max %u)\n", batch.count, USB_BATCH_MAX);
+        retval = -EINVAL;
+        break;
+      }
+      if (!driver->ctrl_buf) {
+        retval = -ENOTTY;  // streaming interface
+        break;
+      }
+
+      batch.done  = 0;
+      batch.error = 0;
+      mutex_lock(&driver->ctrl_lock);
+      for (i = 0; i < batch.count; i++) {
+        if (copy_from_user(&op, &batch.ops[i], sizeof(op))) {
+          batch.error = -EFAULT;
           break;
         }
-        printk(KERN_INFO "ELE784 -> IOCTL_STREAMON : PROBE_CONTROL(GET_DEF) returned %d bytes:\n", retval);
-        // print_probe_control_struct(data);
-
-
-
-        struct vs_probe_control probe;
-        /* Basic hint: host provides frame interval */
-        probe.bmHint          = 1;          // keep same
-        probe.bFormatIndex    = FORMAT_INDEX_UNCOMPRESSED_YUYV;// FORMAT_UNCOMPRESSED (YUY2)
-        // probe.bFrameIndex     = FRAME_INDEX_320x240;          // 320*240 frame
-        // probe.bFrameIndex     = FRAME_INDEX_160x120 ;      // <-- 160*120 frame
-        probe.bFrameIndex     = FRAME_INDEX_640x480;    // <-- 640x480 frame
-        probe.dwFrameInterval = FRAME_INTERVAL_30FPS;     // 30 fps (from descriptor)
-        /* Leave these zero for uncompressed */
-        probe.wKeyFrameRate   = 0;
-        probe.wPFrameRate     = 0;
-        probe.wCompQuality    = 0;
-        probe.wCompWindowSize = 0;
-        probe.wDelay          = 0;
-        /* From lsusb for 320x240 UNCOMPRESSED */
-        // probe.dwMaxVideoFrameSize  = FRAME_SIZE_320x240; // 320*240*2
-        // probe.dwMaxVideoFrameSize      = FRAME_SIZE_160x120 ;   // 160*120*2
-        probe.dwMaxVideoFrameSize      = FRAME_SIZE_640x480 ;   // 160*120*2
-        // probe.dwMaxPayloadTransferSize = PAYLOAD_SIZE_3060 ; // e.g. 3060
-        /* From VC header */
-        // probe.dwClockFrequency = CLOCK_FREQUENCY_300MHZ; // 300 MHz
-        probe.bmFramingInfo    = 0;
-        probe.bPreferedVersion = 0;
-        probe.bMinVersion      = 0;
-        probe.bMaxVersion      = 0;
-
-        pack_probe_control(&probe, data);
-        printk(KERN_INFO "ELE784 -> IOCTL_STREAMON : PROBE_CONTROL(SET_CUR) will send :\n");
-        // print_probe_control_struct(data);
-
-        // MODIFY DATA BASED ON THE OUPUT OF THE FIRST GET_CUR. CONFIRM THAT THE DATA TO SEND IS CORRECT AND THEN SEND IT
-        // 3 : PROBE_CONTROL (SET_CUR)
-        retval = usb_control_msg(
-            udev,
-            usb_sndctrlpipe(udev, 0),                         
-            SET_CUR,                                         
-            USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
-            VS_PROBE_CONTROL_VALUE,                                
-            VS_PROBE_CONTROL_WINDEX_LE,                                           
-            data,                                             
-            VS_PROBE_CONTROL_SIZE,                                       
-            TIMEOUT                                              
-        );
-        if (retval < 0) {
-          printk(KERN_ERR "ELE784 -> IOCTL_STREAMON : usb_control_msg(SET_CUR/PROBE) failed, retval=%d\n",retval);
-          if(data){
-            kfree(data);
-            data = NULL;
-          }
+        // A GET when bit 7 of the request is set (GET_CUR = 0x81, ...)
+        batch.error = ele784_ctrl_xfer(driver, udev, &op, op.request & USB_DIR_IN);
+        if (batch.error < 0)
           break;
+        batch.done++;
+      }
+      mutex_unlock(&driver->ctrl_lock);
+      if (batch.error < 0)
+        printk(KERN_ERR "ELE784 -> IOCTL_BATCH: request %u failed (%d)\n", batch.done, batch.error);
+
+      if (copy_to_user((void __user *)arg, &batch, sizeof(batch))) {
+        retval = -EFAULT;
+        break;
+      }
+      retval = batch.error;
+      break;
+    }
+
+    // set = write a value to device. 
+    case IOCTL_SET:
+        ele784_dbg("ELE784 -> IOCTL_SET\n");
+        /* ---------------------------------------------------------
+        * Step 1 — Copy the usb_request header from user space
+        * --------------------------------------------------------- */
+        if (copy_from_user(&user_request,(struct usb_request __user *)arg,sizeof(struct usb_request))) {
+            printk(KERN_ERR "ELE784 -> IOCTL_SET: copy_from_user(request) failed\n");
+            retval = -EFAULT;
+            break;
         }
-        printk(KERN_INFO "ELE784 -> IOCTL_STREAMON : PROBE_CONTROL(SET_CUR) returned %d bytes:\n", retval);
-
-
-        // 4.PROBE_CONTROL (GET_CUR)
-        retval = usb_control_msg(
-            udev,
-            usb_rcvctrlpipe(udev, 0),                         // pipe de contrôle IN
-            GET_CUR,                                          // bRequest = 0x81
-            USB_DIR_IN | USB_TYPE_CLASS | USB_RECIP_INTERFACE,// bmRequestType = 0xA1
-            VS_PROBE_CONTROL_VALUE,                           // wValue = 0x0100 (Probe)
-            VS_PROBE_CONTROL_WINDEX_LE,                        // wIndex = interface 1, entity 0 
-            data,                                             // BUFFER
-            VS_PROBE_CONTROL_SIZE,                            // wLength = 34     
-            TIMEOUT                                           // timeout (ms)
-        );
-        if (retval < 0) {
-          printk(KERN_ERR "ELE784 -> IOCTL_STREAMON : usb_control_msg(GET_CUR,PROBE) failed, retval=%d\n",retval);
-          if(data){
-            kfree(data);
-            data = NULL;
-          }
+        if (!driver->ctrl_buf) {
+          retval = -ENOTTY;  // streaming interface
           break;
         }
-        printk(KERN_INFO "ELE784 -> IOCTL_STREAMON : PROBE_CONTROL(GET_CUR) returned %d bytes:\n", retval);
-        // print_probe_control_struct(data);
-
-        /* 4) SET_CUR(COMMIT) – commit the settings */
-        // this dont have the rigth format 
-        retval = usb_control_msg(
-            udev,
-            usb_sndctrlpipe(udev, 0),
-            SET_CUR,
-            USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
-            VS_COMMIT_CONTROL_VALUE,
-            VS_COMMIT_CONTROL_WINDEX_LE,
-            data,
-            VS_PROBE_CONTROL_SIZE,
-            TIMEOUT);
-        if (retval < 0) {
-            printk(KERN_ERR "STREAMON: SET_CUR(COMMIT) failed (%d)\n", retval);
-            kfree(data);
-            data = NULL;
-            break;
+        /* ---------------------------------------------------------
+        * Step 2 — Perform the USB SET request (host → device) through
+        *          the preallocated control buffer
+        * --------------------------------------------------------- */
+        mutex_lock(&driver->ctrl_lock);
+        retval = ele784_ctrl_xfer(driver, udev, &user_request, USB_DIR_OUT);
+        mutex_unlock(&driver->ctrl_lock);
+        if (retval < 0)
+          printk(KERN_ERR "ELE784 -> IOCTL_SET: request 0x%02x failed (%ld)\n", user_request.request, retval);
+        break;
+
+  
+    case IOCTL_PANTILT_RESET:
+    {
+      unsigned long flags;
+
+      ele784_dbg("ELE784 -> IOCTL_PANTILT_RESET\n");
+      /* ---------------------------------------------------------
+      * Step 1 — Allocate kernel buffer (1 byte for reset command)
+      * --------------------------------------------------------- */
+      data = kmalloc(1, GFP_KERNEL);
+      if (!data) {
+        printk(KERN_ERR "ELE784 -> IOCTL_PANTILT_RESET: kmalloc(1) failed\n");
+        retval = -ENOMEM;
+        break;
+      }
+      /* ---------------------------------------------------------
+      * Step 2 — Fill payload
+      * --------------------------------------------------------- */
+      data[0] = PANTILT_RESET_CMD;
+      /* ---------------------------------------------------------
+      * Step 3 — Perform USB SET request (host → device), not in the
+      *          middle of an absolute or relative move, once the head
+      *          takes commands. A queued relative move is dropped: the
+      *          head homes to the centre.
+      * --------------------------------------------------------- */
+      mutex_lock(&driver->pt_move_lock);
+      spin_lock_irqsave(&driver->pt_lock, flags);
+      driver->pt_pending = 0;
+      driver->pt_pan = 0;
+      driver->pt_tilt = 0;
+      spin_unlock_irqrestore(&driver->pt_lock, flags);
+      retval = ele784_pantilt_claim(driver);
+      if (retval < 0) {
+        mutex_unlock(&driver->pt_move_lock);
+        kfree(data);
+        break;
+      }
+      retval = usb_control_msg(udev,
+                              usb_sndctrlpipe(udev, 0),
+                              SET_CUR,
+                              USB_DIR_OUT | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+                              PANTILT_RESET_CONTROL,
+                              PANTILT_INDEX, // wIndex interface : 00 and entity : 0B (0X0B00)
+                              data, 1, TIMEOUT);
+      // The head homes back to its origin: the tracked position becomes valid
+      spin_lock_irqsave(&driver->pt_lock, flags);
+      driver->pt_busy = 0;
+      if (retval >= 0)
+        ele784_pantilt_homing(driver);
+      else
+        ele784_pantilt_kick(driver);  // nothing moved: a move queued since can go now
+      spin_unlock_irqrestore(&driver->pt_lock, flags);
+      wake_up_interruptible(&driver->pt_wait);
+      mutex_unlock(&driver->pt_move_lock);
+      /* ---------------------------------------------------------
+      * Step 4 — Handle USB errors
+      * --------------------------------------------------------- */
+      if (retval < 0) {
+        printk(KERN_ERR "ELE784 -> IOCTL_PANTILT_RESET: usb_control_msg failed (%d)\n",retval);
+        if (data) {
+          kfree(data);
+          data = NULL;
         }
+        break;
+      }
+      /* Success return value */
+      retval = 0;
+      /* ---------------------------------------------------------
+      * Step 5 — Free buffer
+      * --------------------------------------------------------- */
+      if (data) {
+        kfree(data);
+        data = NULL;
+      }
+      break;
+    }
+
+    case IOCTL_PANTILT_RELATIVE:
+    {
+      ele784_dbg("ELE784 -> IOCTL_PANTILT_RELATIVE\n");
+
+      /* ---------------------------------------------------------
+      * Step 1 — Copy user-space structure (relative pan/tilt)
+      * --------------------------------------------------------- */
+      struct pantilt_relative rel;
+      // read 4 bytes (two int16) from user space
+      if (copy_from_user(&rel, (void __user *)arg, sizeof(rel))){
+        printk(KERN_ERR "ELE784 -> IOCTL_PANTILT_RELATIVE: copy_from_user(rel) failed\n");
+        retval = -EFAULT;
+        break;
+      }
+
+      if (!driver->ctrl_buf) {
+        retval = -ENOTTY;  // streaming interface
+        break;
+      }
+      /* ---------------------------------------------------------
+      * Step 2 — Send USB SET_CUR request (host → device) once the
+      *          previous motion is over: the head ignores a command
+      *          received while it is still moving
+      * --------------------------------------------------------- */
+      mutex_lock(&driver->pt_move_lock);
+      retval = ele784_pantilt_step(driver, udev, rel.pan, rel.tilt);
+      mutex_unlock(&driver->pt_move_lock);
+      if (retval < 0)
+        printk(KERN_ERR "ELE784 -> IOCTL_PANTILT_RELATIVE: failed (%ld)\n", retval);
+      break;
+    }
+    
+    // Queue a relative move and return at once (see ele784_pantilt_queue)
+    case IOCTL_PANTILT_RELATIVE_ASYNC:
+    {
+      struct pantilt_relative rel;
 
-        /* ======= END PROBE/COMMIT ======= */
-
-
-        uint32_t bandwidth, psize, size, npackets, urb_size;
-        struct usb_host_endpoint *ep = NULL;
-        struct usb_host_interface *alts;
-        int	   best_altset;
-
-        printk(KERN_INFO "ELE784 -> IOCTL_STREAMON: VS interface #1 has %u altsettings\n",interface->num_altsetting);
-        
-        //not sure about the bandwidth and size calculation, need to check with teacher's macros
-        // avec les infos du get_cur
-
-        // À partir des données de configurations obtenues, détermine la Bande Passante et la taille des transferts :	  
-        bandwidth = (((uint32_t) data[25]) << 24) | (((uint32_t) data[24]) << 16) | (((uint32_t) data[23]) << 8) | (((uint32_t) data[22]) << 0);
-        size      = (((uint32_t) data[21]) << 24) | (((uint32_t) data[20]) << 16) | (((uint32_t) data[19]) << 8) | (((uint32_t) data[18]) << 0);
-        printk(KERN_INFO "ELE784 -> IOCTL_STREAMON: bandwidth = %u  size = %u\n",bandwidth, size);
-        // Selon la Bande Passante et la taille des Paquets, trouve la meilleure "Interface Alternative" a utiliser (dépend de la résolution Video choisie)
-        // Note :	Chacune de ces "Interfaces Alternatives" n'a qu'un seul Endpoint...donc on conserve l'info sur ce Endpoint.
-        for (best_altset = 0; best_altset < interface->num_altsetting; best_altset++) {
-          alts = &(interface->altsetting[best_altset]);
-          if (alts->desc.bNumEndpoints < 1)
-            continue;
-          ep = &(alts->endpoint[0]);
-
-
-          /* Skip anything that is NOT isochronous */
-          if (!usb_endpoint_xfer_isoc(&ep->desc)) {
-              printk(KERN_INFO "ELE784 -> alt=%d: not isochronous, skipping\n",best_altset);
-              ep = NULL;
-              continue;
-          }
-          psize = (ep->desc.wMaxPacketSize & 0x07ff) * (((ep->desc.wMaxPacketSize >> 11) & 0x0003) + 1);
-          if (psize >= bandwidth)
-            break;
-        }
-        if (ep == NULL) {
-          printk(KERN_WARNING "ELE784 -> IOCTL_STREAMON : No Endpoint found error");
-          if(data){
-            kfree(data);
-            data = NULL;
-          }
-          retval = -ENOMEM;
-          break;
-        }
-            
-        // Avec l'interface choisie, on détermine le nombre de Paquets que chaque Urb aura à transporter.
-        npackets = ((size % psize) > 0) ? (size/psize + 1) : (size/psize);
+      if (copy_from_user(&rel, (void __user *)arg, sizeof(rel))) {
+        printk(KERN_ERR "ELE784 -> IOCTL_PANTILT_RELATIVE_ASYNC: copy_from_user(rel) failed\n");
+        retval = -EFAULT;
+        break;
+      }
+      if (!driver->pt_urb) {
+        retval = -ENOTTY;  // streaming interface
+        break;
+      }
+      retval = ele784_pantilt_queue(driver, rel.pan, rel.tilt);
+      if (retval < 0)
+        printk(KERN_ERR "ELE784 -> IOCTL_PANTILT_RELATIVE_ASYNC: usb_submit_urb failed (%ld)\n", retval);
+      break;
+    }
 
-        //need to clamp npackets to MAX_PACKETS
-        if (npackets > MAX_PACKETS) {
-          npackets = MAX_PACKETS;
-        }
-        urb_size = psize*npackets;
-        printk(KERN_INFO "ELE784 -> IOCTL_STREAMON : bandwidth = %u psize = %u npackets = %u urb_size = %u best_altset = %u\n", bandwidth, psize, npackets, urb_size, best_altset);
-        // Et on alloue dynamiquement (obligatoire) le tampon où seront placées les données récoltées par les Urbs.   		
-        driver->frame_buf.Data = kmalloc(size, GFP_KERNEL);
-        if (driver->frame_buf.Data == NULL) {
-          // printk(KERN_WARNING "ELE784 -> IOCTL_STREAMON : No memory for URB buffer[0]");
-          printk(KERN_WARNING "ELE784 -> IOCTL_STREAMON : No memory for frame buffer (%u bytes)\n", size);
-          if(data){
-            kfree(data);
-            data =NULL;
-          }
-          retval = -ENOMEM;
-          break;
-        }
-        driver->frame_buf.MaxLength = size;
-        driver->frame_buf.BytesUsed = 0; 
-        driver->frame_buf.LastFID = -1;
-        driver->frame_buf.Status = 0;  // <-- IMPORTANT: Initialize to 0
-        driver->frame_buf.LastFID = -1; // <-- Initialize ONCE during STREAMON
+    case IOCTL_PANTILT_ABSOLUTE:
+    {
+      struct pantilt_absolute move;
 
+      if (copy_from_user(&move, (void __user *)arg, sizeof(move))) {
+        printk(KERN_ERR "ELE784 -> IOCTL_PANTILT_ABSOLUTE: copy_from_user failed\n");
+        retval = -EFAULT;
+        break;
+      }
+      if (!driver->ctrl_buf) {
+        retval = -ENOTTY;  // streaming interface
+        break;
+      }
+      retval = ele784_pantilt_absolute(driver, udev, &move);
+      if (retval == -ENODATA)
+        printk(KERN_WARNING "ELE784 -> IOCTL_PANTILT_ABSOLUTE: position unknown, IOCTL_PANTILT_RESET first\n");
+      else if (retval < 0)
+        printk(KERN_ERR "ELE784 -> IOCTL_PANTILT_ABSOLUTE: failed after %u steps (%ld)\n", move.steps, retval);
+      if (copy_to_user((void __user *)arg, &move, sizeof(move)))
+        retval = -EFAULT;
+      break;
+    }
 
-        // On a besoin d'un mécanisme de synchro pour la détection du début d'un "Frame" (une image) et la détection de la fin de chaque Urb.
-        init_completion(&(driver->frame_buf.new_frame_start));
-        init_completion(&(driver->frame_buf.urb_completion));
-            
+    // Wait for the end of the current motion (IOCTL_PANTILT_RESET included)
+    case IOCTL_PANTILT_WAIT:
+      if (!driver->ctrl_buf) {
+        retval = -ENOTTY;  // streaming interface
+        break;
+      }
+      retval = ele784_pantilt_wait(driver, (unsigned int)arg);
+      break;
 
-        driver->frame_buf.Status |= BUF_STREAM_READ;  // <-- ADD THIS LINE!
-    
-        // Ici, on rend "courante" l'interface alternative choisie comme étant la meilleure.
-        retval = usb_set_interface(udev, 1, best_altset); //Important pour mettre la camera dans le bon mode
-        if (retval < 0) {
-            if (data){
-              kfree(data);
-              data=NULL;
-            }
-            if (driver->frame_buf.Data){ 
-              kfree(driver->frame_buf.Data);
-              driver->frame_buf.Data = NULL;
-            }
-            break;
-        }else{
-          printk(KERN_INFO "ELE784 -> IOCTL_STREAMON : usb_set_interface successful retval = %d\n",retval);
-        }
-        // Finalement, on créé les Urbs Isochronous (un total de URB_COUNT Urbs).
-        for (i = 0; i < URB_COUNT; i++) {
-          driver->isoc_in_urb[i] = usb_alloc_urb(npackets, GFP_KERNEL);
-          if (driver->isoc_in_urb[i] == NULL) {
-            printk(KERN_WARNING "ELE784 -> IOCTL_STREAMON : URB allocation error");
-            if(data){
-              kfree(data);
-              data =NULL;
-            }
-            if (driver->frame_buf.Data) {
-              kfree(driver->frame_buf.Data);
-              driver->frame_buf.Data = NULL;
-            }
-            retval = -ENOMEM;
-            break;
-          }
-
-          driver->isoc_in_urb[i]->transfer_buffer = usb_alloc_coherent(udev, urb_size, GFP_KERNEL, &(driver->isoc_in_urb[i]->transfer_dma));
-          if (driver->isoc_in_urb[i]->transfer_buffer == NULL) {
-            printk(KERN_WARNING "ELE784 -> IOCTL_STREAMON : Transfert buffer allocation error");
-            usb_free_urb(driver->isoc_in_urb[i]);
-            if(data){
-              kfree(data);
-              data =NULL;
-            }
-            if (driver->frame_buf.Data) {
-              kfree(driver->frame_buf.Data);
-              driver->frame_buf.Data = NULL;
-            }
-            retval = -ENOMEM;
-            break;
-          }
-
-          /*******************************************************************************
-          Ici, il s'agit d'initialiser l'Urb Isochronous (voir acétate 16 du cours # 5)
-          Suggestion :	Attacher la structure (driver->frame_buf) au champ "context" de la structure du Urb.
-          ******* ************************************************************************/
-          struct urb *urb = driver->isoc_in_urb[i];
-          /* Pointeur vers le device */
-          urb->dev = udev;
-          /* Contexte transmis au callback */
-          urb->context = &(driver->frame_buf);
-          /* Endpoint Isochronous IN */
-          urb->pipe = usb_rcvisocpipe(udev, ep->desc.bEndpointAddress);
-          /* Flags recommandés */
-          urb->transfer_flags = URB_ISO_ASAP | URB_NO_TRANSFER_DMA_MAP;
-          /* Intervalle d'interrogation (polling) */
-          urb->interval = ep->desc.bInterval;
-          /* Callback qui sera appelé quand l’URB est complété */
-          urb->complete = complete_callback;
-          /* Nombre de paquets dans l’URB */
-          urb->number_of_packets = npackets;
-          /* Taille totale du buffer */
-          urb->transfer_buffer_length = urb_size;
-          /* Configurer les paquets ISO individuellement */
-          for (j = 0; j < npackets; j++) {
-              urb->iso_frame_desc[j].offset = j * psize;
-              urb->iso_frame_desc[j].length = psize;
-          }
-        }
-        
-        // Et on lance tous les Urbs créés. 
-        /*******************************************************************************
-        Ici, il s'agit de soumettre tous les Urbs créés ci-dessus.
-        *******************************************************************************/
-        /* ====== ÉTAPE 3 : Soumission des URBs ====== */
-        for (i = 0; i < URB_COUNT; i++) {
-          retval = usb_submit_urb(driver->isoc_in_urb[i], GFP_KERNEL);
-          if (retval < 0) {
-            printk(KERN_ERR "ELE784 -> IOCTL_STREAMON: usb_submit_urb[%d] failed (%d)\n",i, retval);
-            /* First, free the current (failed) URB i */
-            usb_free_coherent(udev,
-                urb_size,
-                driver->isoc_in_urb[i]->transfer_buffer,
-                driver->isoc_in_urb[i]->transfer_dma);
-            usb_free_urb(driver->isoc_in_urb[i]);
-            driver->isoc_in_urb[i] = NULL;
-            /* rollback: kill + free previously submitted URBs   0..i-1*/
-            while (--i >= 0) {
-              usb_kill_urb(driver->isoc_in_urb[i]);
-              usb_free_coherent(udev,
-                  urb_size,
-                  driver->isoc_in_urb[i]->transfer_buffer,
-                  driver->isoc_in_urb[i]->transfer_dma);
-              usb_free_urb(driver->isoc_in_urb[i]);
-              driver->isoc_in_urb[i] = NULL;
-            }
-            /* free frame buffer */
-            if (driver->frame_buf.Data) {
-                kfree(driver->frame_buf.Data);
-                driver->frame_buf.Data = NULL;
-            }
-            /* free probe data */
-            if (data) {
-                kfree(data);
-                data = NULL;
-            }
-            break; /* leave STREAMON case */
-          }
-        } 
-
-        if (retval >= 0) {
-          printk(KERN_INFO "ELE784 -> IOCTL_STREAMON: streaming started (%d URBs submitted)\n",URB_COUNT);
-        }
-      
-      } 
-      if (data) {
-        kfree(data);
-        data = NULL;
+    case IOCTL_PANTILT_GET_POSITION:
+    {
+      struct pantilt_position pos;
+      unsigned long flags;
+
+      spin_lock_irqsave(&driver->pt_lock, flags);
+      pos = driver->pt_pos;
+      spin_unlock_irqrestore(&driver->pt_lock, flags);
+      if (copy_to_user((void __user *)arg, &pos, sizeof(pos))) {
+        retval = -EFAULT;
+        break;
+      }
+      retval = 0;
+      break;
+    }
+
+    case IOCTL_PANTILT_STATUS:
+    {
+      struct pantilt_status status;
+      unsigned long flags;
+
+      spin_lock_irqsave(&driver->pt_lock, flags);
+      status = driver->pt_status;
+      status.pending_pan  = driver->pt_pending ? driver->pt_pan : 0;
+      status.pending_tilt = driver->pt_pending ? driver->pt_tilt : 0;
+      status.busy         = driver->pt_busy;
+      spin_unlock_irqrestore(&driver->pt_lock, flags);
+      if (copy_to_user((void __user *)arg, &status, sizeof(status))) {
+        retval = -EFAULT;
+        break;
       }
+      retval = 0;
+      break;
+    }
+
+    // Handle IOCTL_STREAMON command
+    case IOCTL_STREAMON:
+      ele784_dbg("ELE784 -> IOCTL_STREAMON\n");
+      mutex_lock(&driver->stream_lock);
+      retval = ele784_stream_start(driver);
+      mutex_unlock(&driver->stream_lock);
       break;
 
     // Handle IOCTL_STREAMOFF command
   case IOCTL_STREAMOFF:
-      printk(KERN_INFO "ELE784 -> IOCTL_STREAMOFF\n");
+      ele784_dbg("ELE784 -> IOCTL_STREAMOFF\n");
+      cancel_delayed_work_sync(&driver->watchdog);
+      mutex_lock(&driver->stream_lock);
+      ele784_stream_stop(driver);
+      mutex_unlock(&driver->stream_lock);
+      retval = 0;
+      break;
 
-      /* 1) Kill all URBs */
-      for (i = 0; i < URB_COUNT; i++) {
-        if (driver->isoc_in_urb[i]) {
-          usb_kill_urb(driver->isoc_in_urb[i]);
-        }
+    // Still image at its own resolution, the preview keeps streaming
+    case IOCTL_STREAM_SNAPSHOT:
+    {
+      struct stream_snapshot snap;
+
+      ele784_dbg("ELE784 -> IOCTL_STREAM_SNAPSHOT\n");
+      if (copy_from_user(&snap, (void __user *)arg, sizeof(snap))) {
+        printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SNAPSHOT: copy_from_user failed\n");
+        retval = -EFAULT;
+        break;
+      }
+      retval = ele784_still_capture(driver, &snap);
+      if (retval == 0 && copy_to_user((void __user *)arg, &snap, sizeof(snap)))
+        retval = -EFAULT;
+      break;
+    }
+
+    // Constant frame rate, applied by the next STREAMON
+    case IOCTL_STREAM_SET_CFR:
+    {
+      struct stream_cfr cfr;
+
+      ele784_dbg("ELE784 -> IOCTL_STREAM_SET_CFR\n");
+      if (copy_from_user(&cfr, (void __user *)arg, sizeof(cfr))) {
+        printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SET_CFR: copy_from_user failed\n");
+        retval = -EFAULT;
+        break;
+      }
+      driver->cfr_enable = !!cfr.enable;
+      retval = 0;
+      break;
+    }
+
+    // Committed rate against the delivered one
+    case IOCTL_STREAM_GET_CFR:
+    {
+      struct stream_cfr cfr;
+
+      mutex_lock(&driver->stream_lock);
+      cfr = driver->cfr;
+      cfr.enable = driver->cfr_enable;
+      cfr.committed_fps_centi = driver->frame_interval_us ? 100000000 / driver->frame_interval_us : 0;
+      mutex_unlock(&driver->stream_lock);
+      cfr.measured_fps_centi = driver->frame_buf.Stats.fps_centi;
+      if (copy_to_user((void __user *)arg, &cfr, sizeof(cfr))) {
+        retval = -EFAULT;
+        break;
+      }
+      retval = 0;
+      break;
+    }
+
+    // Synthetic frame source used by the next STREAMON
+    case IOCTL_STREAM_SET_SYNTH:
+    {
+      struct stream_synth synth;
+
+      ele784_dbg("ELE784 -> IOCTL_STREAM_SET_SYNTH\n");
+      if (copy_from_user(&synth, (void __user *)arg, sizeof(synth))) {
+        printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SET_SYNTH: copy_from_user failed\n");
+        retval = -EFAULT;
+        break;
+      }
+      if (synth.fps > 1000 || (synth.packet_size && (synth.packet_size < SYNTH_MIN_PACKET || synth.packet_size > SYNTH_MAX_PACKET)) ||
+          synth.loss_permille + synth.error_permille > 1000) {
+        printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SET_SYNTH: invalid settings (%u fps, %u bytes, %u+%u per mille)\n",
+               synth.fps, synth.packet_size, synth.loss_permille, synth.error_permille);
+        retval = -EINVAL;
+        break;
+      }
+      synth.enable = !!synth.enable;
+      synth.frames = synth.packets = synth.late_ticks = 0;
+      mutex_lock(&driver->stream_lock);
+      driver->synth_cfg = synth;
+      mutex_unlock(&driver->stream_lock);
+      retval = 0;
+      break;
+    }
+
+    // Settings for the next STREAMON, counters of the running source
+    case IOCTL_STREAM_GET_SYNTH:
+    {
+      struct stream_synth synth;
+
+      mutex_lock(&driver->stream_lock);
+      synth = driver->synth_cfg;
+      synth.frames     = driver->synth.frames;
+      synth.packets    = driver->synth.sent;
+      synth.late_ticks = driver->synth.late_ticks;
+      mutex_unlock(&driver->stream_lock);
+      if (copy_to_user((void __user *)arg, &synth, sizeof(synth))) {
+        retval = -EFAULT;
+        break;
+      }
+      retval = 0;
+      break;
+    }
+
+    // URB geometry profile used by the next STREAMON
+    case IOCTL_STREAM_SET_GEOMETRY:
+    {
+      struct stream_geometry geo;
+
+      ele784_dbg("ELE784 -> IOCTL_STREAM_SET_GEOMETRY\n");
+      if (copy_from_user(&geo, (void __user *)arg, sizeof(geo))) {
+        printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SET_GEOMETRY: copy_from_user failed\n");
+        retval = -EFAULT;
+        break;
+      }
+      if (geo.profile > URB_PROFILE_ADAPTIVE) {
+        printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SET_GEOMETRY: invalid profile %u\n", geo.profile);
+        retval = -EINVAL;
+        break;
+      }
+      mutex_lock(&driver->stream_lock);
+      driver->urb_profile = geo.profile;
+      mutex_unlock(&driver->stream_lock);
+      retval = 0;
+      break;
+    }
+
+    // Active URB geometry and underrun counters
+    case IOCTL_STREAM_GET_GEOMETRY:
+    {
+      struct stream_geometry geo;
+      struct driver_buffer *fb = &driver->frame_buf;
+
+      memset(&geo, 0, sizeof(geo));
+      geo.profile          = fb->Profile;
+      geo.urb_count        = fb->UrbCount;
+      geo.in_flight        = fb->InFlight;
+      geo.packets_per_urb  = fb->Packets;
+      geo.packet_size      = fb->PacketSize;
+      geo.missed_intervals = fb->Stats.iso_err_missed;
+      geo.late_resubmits   = fb->Stats.resubmit_failures;
+      geo.grow_events      = fb->GrowEvents;
+      geo.shrink_events    = fb->ShrinkEvents;
+
+      if (copy_to_user((void __user *)arg, &geo, sizeof(geo))) {
+        retval = -EFAULT;
+        break;
+      }
+      retval = 0;
+      break;
+    }
+
+    // Crop / decimate the frames delivered to readers
+    case IOCTL_STREAM_SET_ROI:
+    {
+      struct stream_roi roi;
+      unsigned long flags;
+
+      ele784_dbg("ELE784 -> IOCTL_STREAM_SET_ROI\n");
+      if (copy_from_user(&roi, (void __user *)arg, sizeof(roi))) {
+        printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SET_ROI: copy_from_user failed\n");
+        retval = -EFAULT;
+        break;
+      }
+      /* width = 0 selects the full frame */
+      if (roi.width == 0) {
+        frame_roi_full(&roi);
       }
+      if ((roi.decimation != 1 && roi.decimation != 2 && roi.decimation != 4) ||
+          (roi.x % 2) || (roi.width % (2 * roi.decimation)) || roi.height == 0 ||
+          (roi.height % roi.decimation) ||
+          roi.x + roi.width > FRAME_WIDTH || roi.y + roi.height > FRAME_HEIGHT) {
+        printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SET_ROI: invalid roi %ux%u+%u+%u /%u\n",
+               roi.width, roi.height, roi.x, roi.y, roi.decimation);
+        retval = -EINVAL;
+        break;
+      }
+      /* Applied by the callback at the next frame start */
+      spin_lock_irqsave(&driver->frame_buf.Lock, flags);
+      if (!driver->frame_buf.ConfigPending) {
+        driver->frame_buf.PendingOutput = driver->frame_buf.Output;
+      }
+      roi.frame_size = frame_out_size(&roi, driver->frame_buf.PendingOutput);
+      driver->frame_buf.PendingRoi = roi;
+      driver->frame_buf.ConfigPending = 1;
+      spin_unlock_irqrestore(&driver->frame_buf.Lock, flags);
+
+      if (copy_to_user((void __user *)arg, &roi, sizeof(roi))) {
+        retval = -EFAULT;
+        break;
+      }
+      retval = 0;
+      break;
+    }
+
+    case IOCTL_STREAM_GET_ROI:
+    {
+      struct stream_roi roi;
+      unsigned long flags;
+
+      spin_lock_irqsave(&driver->frame_buf.Lock, flags);
+      if (driver->frame_buf.ConfigPending) {
+        roi = driver->frame_buf.PendingRoi;
+        roi.frame_size = frame_out_size(&roi, driver->frame_buf.PendingOutput);
+      } else {
+        roi = driver->frame_buf.Roi;
+        roi.frame_size = driver->frame_buf.FrameSize;
+      }
+      spin_unlock_irqrestore(&driver->frame_buf.Lock, flags);
+
+      if (copy_to_user((void __user *)arg, &roi, sizeof(roi))) {
+        retval = -EFAULT;
+        break;
+      }
+      retval = 0;
+      break;
+    }
+
+    // Select packed YUYV, luma only or planar output
+    case IOCTL_STREAM_SET_OUTPUT:
+    {
+      struct stream_output out;
+      unsigned long flags;
+
+      ele784_dbg("ELE784 -> IOCTL_STREAM_SET_OUTPUT\n");
+      if (copy_from_user(&out, (void __user *)arg, sizeof(out))) {
+        printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SET_OUTPUT: copy_from_user failed\n");
+        retval = -EFAULT;
+        break;
+      }
+      if (out.mode != STREAM_OUTPUT_YUYV && out.mode != STREAM_OUTPUT_GREY &&
+          out.mode != STREAM_OUTPUT_YUV422P) {
+        printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SET_OUTPUT: invalid mode %u\n", out.mode);
+        retval = -EINVAL;
+        break;
+      }
+      /* Applied by the callback at the next frame start */
+      spin_lock_irqsave(&driver->frame_buf.Lock, flags);
+      if (!driver->frame_buf.ConfigPending) {
+        driver->frame_buf.PendingRoi = driver->frame_buf.Roi;
+      }
+      out.frame_size = frame_out_size(&driver->frame_buf.PendingRoi, out.mode);
+      driver->frame_buf.PendingOutput = out.mode;
+      driver->frame_buf.ConfigPending = 1;
+      spin_unlock_irqrestore(&driver->frame_buf.Lock, flags);
+
+      if (copy_to_user((void __user *)arg, &out, sizeof(out))) {
+        retval = -EFAULT;
+        break;
+      }
+      retval = 0;
+      break;
+    }
 
-      /* 2) Free URB resources */
-      for (i = 0; i < URB_COUNT; i++) {
-        if (driver->isoc_in_urb[i]) {
-          usb_free_coherent(udev,
-                // urb_size,
-                // driver->frame_buf.MaxLength,
-                driver->isoc_in_urb[i]->transfer_buffer_length,
-                driver->isoc_in_urb[i]->transfer_buffer,
-                driver->isoc_in_urb[i]->transfer_dma);
+    // Deliver only every Nth frame
+    case IOCTL_STREAM_SET_RATE:
+    {
+      struct stream_rate rate;
 
-          usb_free_urb(driver->isoc_in_urb[i]);
-          driver->isoc_in_urb[i] = NULL;
+      ele784_dbg("ELE784 -> IOCTL_STREAM_SET_RATE\n");
+      if (copy_from_user(&rate, (void __user *)arg, sizeof(rate))) {
+        printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SET_RATE: copy_from_user failed\n");
+        retval = -EFAULT;
+        break;
+      }
+      // committed rate of the running stream (the synthetic source may be faster than the camera)
+      rate.native_fps = driver->frame_interval_us ? USEC_PER_SEC / driver->frame_interval_us
+                                                  : 10000000 / FRAME_INTERVAL_30FPS;
+      if (rate.target_fps) {
+        if (rate.target_fps > rate.native_fps) {
+          rate.target_fps = rate.native_fps;
         }
+        /* nearest integer divider of the native rate */
+        rate.every_nth = (rate.native_fps + rate.target_fps / 2) / rate.target_fps;
       }
+      if (rate.every_nth == 0) {
+        rate.every_nth = 1;
+      }
+      driver->frame_buf.DeliverEvery = rate.every_nth;
 
-      /* 3) Free frame buffer */
-      if (driver->frame_buf.Data) {
-        kfree(driver->frame_buf.Data);
-        driver->frame_buf.Data = NULL;
+      if (copy_to_user((void __user *)arg, &rate, sizeof(rate))) {
+        retval = -EFAULT;
+        break;
       }
+      retval = 0;
+      break;
+    }
 
-      /* 4) Set altsetting 0 (stop streaming) */
-      usb_set_interface(udev, 1, 0);
+    // Deliver incomplete frames with a damage map instead of dropping them
+    case IOCTL_STREAM_SET_CONCEAL:
+    {
+      struct stream_conceal conceal;
+
+      ele784_dbg("ELE784 -> IOCTL_STREAM_SET_CONCEAL\n");
+      if (copy_from_user(&conceal, (void __user *)arg, sizeof(conceal))) {
+        printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SET_CONCEAL: copy_from_user failed\n");
+        retval = -EFAULT;
+        break;
+      }
+      if (conceal.mode > STREAM_CONCEAL_PREVIOUS || conceal.min_percent > 100) {
+        printk(KERN_ERR "ELE784 -> IOCTL_STREAM_SET_CONCEAL: invalid mode %u / %u%%\n",
+               conceal.mode, conceal.min_percent);
+        retval = -EINVAL;
+        break;
+      }
+      driver->frame_buf.ConcealMinPercent = conceal.min_percent;
+      driver->frame_buf.Conceal = conceal.mode;
+      retval = 0;
+      break;
+    }
+
+    // Metadata of the frame returned by the last read()
+    case IOCTL_STREAM_GET_META:
+    {
+      struct frame_meta meta;
+      unsigned long flags;
+
+      spin_lock_irqsave(&driver->frame_buf.Lock, flags);
+      meta = driver->frame_buf.LastMeta;
+      spin_unlock_irqrestore(&driver->frame_buf.Lock, flags);
+
+      if (copy_to_user((void __user *)arg, &meta, sizeof(meta))) {
+        retval = -EFAULT;
+        break;
+      }
+      retval = 0;
+      break;
+    }
 
-      /* 5) Reset completions */
-      reinit_completion(&driver->frame_buf.new_frame_start);
-      reinit_completion(&driver->frame_buf.urb_completion);
+    // Capabilities cached at probe: no USB traffic
+    case IOCTL_PANTILT_GET_INFO:
+      if (!driver->ctrl_buf) {
+        retval = -ENOTTY;  // streaming interface
+        break;
+      }
+      if (copy_to_user((void __user *)arg, &driver->pt_info, sizeof(driver->pt_info))) {
+        retval = -EFAULT;
+        break;
+      }
+      retval = 0;
+      break;
 
+    case IOCTL_PANTILT_GET_CAPS:
+      if (!driver->ctrl_buf) {
+        retval = -ENOTTY;  // streaming interface
+        break;
+      }
+      if (copy_to_user((void __user *)arg, &driver->pt_caps, sizeof(driver->pt_caps))) {
+        retval = -EFAULT;
+        break;
+      }
       retval = 0;
       break;
 
@@ -996,6 +2590,9 @@ ssize_t ele784_read(struct file *file,char __user *buffer,size_t count,loff_t *f
     struct orbit_driver *dev = file->private_data;
     struct driver_buffer *fb;
     size_t bytes_to_copy;
+    unsigned long flags;
+    uint8_t *tmp;
+    uint64_t now;
 
     if (!dev)
         return -ENODEV;
@@ -1003,50 +2600,256 @@ ssize_t ele784_read(struct file *file,char __user *buffer,size_t count,loff_t *f
     fb = &dev->frame_buf;
 
     // =====================================================
-    // CRITICAL FIX: Wait for FID toggle BEFORE resetting
+    // Wait until the callback hands over a complete frame
     // =====================================================
-    
-    // Wait for the START of a new frame (FID toggle)
-    if (wait_for_completion_interruptible(&fb->new_frame_start)) {
+    // read_lock is held from the handover to the end of the copy: STREAMOFF
+    // waits for it before freeing the buffers. io_rwsem (taken first, as in
+    // ioctl()) is not held while waiting: the readers of an orphan keep
+    // waiting for the camera to come back.
+    for (;;) {
+      if (down_read_interruptible(&dev->io_rwsem))
         return -ERESTARTSYS;
-    }
-    // NOW reset for this frame (callback has already started filling buffer)
-    // But DON'T reset LastFID - let callback track it across frames
-    reinit_completion(&fb->new_frame_start);
-    reinit_completion(&fb->urb_completion);
-
-
-    // =====================================================
-    // Wait until callback signals EOF of this frame
-    // =====================================================
-    while (!(fb->Status & BUF_STREAM_EOF)) {
+      if (mutex_lock_interruptible(&dev->read_lock)) {
+        up_read(&dev->io_rwsem);
+        return -ERESTARTSYS;
+      }
+      spin_lock_irqsave(&fb->Lock, flags);
+      // The watchdog could not restart the stream, or STREAMOFF
+      if (fb->Status & (BUF_STREAM_FAILED | BUF_STREAM_STOPPED)) {
+        spin_unlock_irqrestore(&fb->Lock, flags);
+        mutex_unlock(&dev->read_lock);
+        up_read(&dev->io_rwsem);
+        return -EIO;
+      }
+      if (fb->Status & BUF_STREAM_EOF) {
+        // Take the ready frame: the callback keeps assembling into its own buffer
+        tmp = fb->ReadData;
+        fb->ReadData  = fb->ReadyData;
+        fb->ReadyData = tmp;
+        fb->ReadBytes = fb->ReadyBytes;
+        fb->LastMeta  = fb->ReadyMeta;
+        fb->Status &= ~BUF_STREAM_EOF;
+        spin_unlock_irqrestore(&fb->Lock, flags);
+
+        // Frame-to-read latency: how long the frame waited for this read()
+        now = ktime_get_ns();
+        latency_hist_add(&fb->ReadLatencyHist, now - fb->LastMeta.timestamp_ns);
+        trace_orbit_read_wakeup(fb->LastMeta.sequence, now - fb->LastMeta.timestamp_ns);
+        break;
+      }
+      // Re-armed under the lock: a frame delivered after this point completes it again
+      reinit_completion(&fb->urb_completion);
+      spin_unlock_irqrestore(&fb->Lock, flags);
+      mutex_unlock(&dev->read_lock);
+      up_read(&dev->io_rwsem);
 
       if (wait_for_completion_interruptible(&fb->urb_completion)) {
-        fb->Status &= ~(BUF_STREAM_READ | BUF_STREAM_EOF | BUF_STREAM_FRAME_READ);
         return -ERESTARTSYS;
       }
-
-      reinit_completion(&fb->urb_completion);
     }
 
     // =====================================================
     // COPY FRAME TO USER BUFFER
     // =====================================================
-    bytes_to_copy = min((size_t)fb->BytesUsed, count);
+    bytes_to_copy = min((size_t)fb->ReadBytes, count);
 
-    if (copy_to_user(buffer, fb->Data, bytes_to_copy)) {
-      fb->Status &= ~(BUF_STREAM_READ | BUF_STREAM_EOF | BUF_STREAM_FRAME_READ);
-      fb->BytesUsed = 0;
+    now = ktime_get_ns();
+    if (copy_to_user(buffer, fb->ReadData, bytes_to_copy)) {
+      mutex_unlock(&dev->read_lock);
+      up_read(&dev->io_rwsem);
       return -EFAULT;
     }
+    mutex_unlock(&dev->read_lock);
+    up_read(&dev->io_rwsem);
+    trace_orbit_read_return(fb->LastMeta.sequence, bytes_to_copy, ktime_get_ns() - now);
     // printk(KERN_INFO "ELE784 -> read() returning %zu bytes\n", bytes_to_copy);
 
-    // =====================================================
-    // CLEAN UP FOR NEXT READ()
-    // =====================================================
-    // fb->Status &= ~(BUF_STREAM_READ | BUF_STREAM_EOF | BUF_STREAM_FRAME_READ);
-    // fb->Status &= ~(BUF_STREAM_EOF | BUF_STREAM_FRAME_READ);
-    fb->Status &= ~BUF_STREAM_EOF;
-
     return bytes_to_copy;
-}
\ No newline at end of file
+}
+
+// =====================================================
+// STREAMING STATISTICS (sysfs)
+// /sys/bus/usb/devices/<intf>/stats/<counter>, one value per file
+// =====================================================
+#define ELE784_STAT_ATTR(name, fmt)                                              \
+static ssize_t name##_show(struct device *dev, struct device_attribute *attr, char *buf) { \
+  struct orbit_driver *driver = usb_get_intfdata(to_usb_interface(dev));         \
+  return sysfs_emit(buf, fmt "\n", driver->frame_buf.Stats.name);               \
+}                                                                                \
+static DEVICE_ATTR_RO(name)
+
+ELE784_STAT_ATTR(packets, "%llu");
+ELE784_STAT_ATTR(bytes, "%llu");
+ELE784_STAT_ATTR(iso_err_missed, "%u");
+ELE784_STAT_ATTR(iso_err_proto, "%u");
+ELE784_STAT_ATTR(iso_err_overflow, "%u");
+ELE784_STAT_ATTR(iso_err_other, "%u");
+ELE784_STAT_ATTR(urb_errors, "%u");
+ELE784_STAT_ATTR(header_errors, "%u");
+ELE784_STAT_ATTR(frames_completed, "%u");
+ELE784_STAT_ATTR(frames_repaired, "%u");
+ELE784_STAT_ATTR(frames_abandoned, "%u");
+ELE784_STAT_ATTR(frames_oversize, "%u");
+ELE784_STAT_ATTR(resubmit_failures, "%u");
+ELE784_STAT_ATTR(recoveries, "%u");
+
+// Current rate, e.g. "29.97"
+static ssize_t fps_show(struct device *dev, struct device_attribute *attr, char *buf) {
+  struct orbit_driver *driver = usb_get_intfdata(to_usb_interface(dev));
+  uint32_t fps = driver->frame_buf.Stats.fps_centi;
+
+  return sysfs_emit(buf, "%u.%02u\n", fps / 100, fps % 100);
+}
+static DEVICE_ATTR_RO(fps);
+
+// Rate of the committed frame interval, to compare with fps
+static ssize_t committed_fps_show(struct device *dev, struct device_attribute *attr, char *buf) {
+  struct orbit_driver *driver = usb_get_intfdata(to_usb_interface(dev));
+  uint32_t fps = driver->frame_interval_us ? 100000000 / driver->frame_interval_us : 0;
+
+  return sysfs_emit(buf, "%u.%02u\n", fps / 100, fps % 100);
+}
+static DEVICE_ATTR_RO(committed_fps);
+
+// Writing anything to reset clears every counter. The callback does not take
+// the lock for its counters: an increment racing with the reset may survive it.
+static ssize_t reset_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+  struct orbit_driver *driver = usb_get_intfdata(to_usb_interface(dev));
+  unsigned long flags;
+
+  spin_lock_irqsave(&driver->frame_buf.Lock, flags);
+  memset(&driver->frame_buf.Stats, 0, sizeof(driver->frame_buf.Stats));
+  spin_unlock_irqrestore(&driver->frame_buf.Lock, flags);
+  return count;
+}
+static DEVICE_ATTR_WO(reset);
+
+static struct attribute *ele784_stats_attrs[] = {
+  &dev_attr_packets.attr,
+  &dev_attr_bytes.attr,
+  &dev_attr_iso_err_missed.attr,
+  &dev_attr_iso_err_proto.attr,
+  &dev_attr_iso_err_overflow.attr,
+  &dev_attr_iso_err_other.attr,
+  &dev_attr_urb_errors.attr,
+  &dev_attr_header_errors.attr,
+  &dev_attr_frames_completed.attr,
+  &dev_attr_frames_repaired.attr,
+  &dev_attr_frames_abandoned.attr,
+  &dev_attr_frames_oversize.attr,
+  &dev_attr_resubmit_failures.attr,
+  &dev_attr_recoveries.attr,
+  &dev_attr_fps.attr,
+  &dev_attr_committed_fps.attr,
+  &dev_attr_reset.attr,
+  NULL,
+};
+
+static const struct attribute_group ele784_stats_group = {
+  .name  = "stats",
+  .attrs = ele784_stats_attrs,
+};
+
+// =====================================================
+// LATENCY HISTOGRAMS (debugfs)
+// /sys/kernel/debug/logitech_orbit/<intf>/{callback_us,frame_to_read_us}
+// =====================================================
+static int latency_hist_show(struct seq_file *m, void *v) {
+  struct latency_hist *hist = m->private;
+  uint64_t low, high;
+  int b;
+
+  seq_printf(m, "%12s : count\n", "usecs");
+  for (b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+    if (!hist->bucket[b])
+      continue;
+    low  = b ? 1ULL << (b - 1) : 0;
+    high = 1ULL << b;
+    if (b == LATENCY_HIST_BUCKETS - 1)
+      seq_printf(m, "%5llu -> ... : %u\n", low, hist->bucket[b]);
+    else
+      seq_printf(m, "%5llu -> %-5llu : %u\n", low, high, hist->bucket[b]);
+  }
+  seq_printf(m, "count %llu, max %llu us\n", hist->count, div_u64(hist->max_ns, NSEC_PER_USEC));
+  return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(latency_hist);
+
+// =====================================================
+// PACKET TRACE RING (debugfs, binary)
+// The ring is copied when the file is opened, so a slow reader never holds
+// back the callback. Records the callback overwrote during the copy are dropped.
+// =====================================================
+struct packet_trace_snapshot {
+  size_t               count;
+  struct packet_record rec[];
+};
+
+static int packet_trace_open(struct inode *inode, struct file *file) {
+  struct driver_buffer *fb = inode->i_private;
+  unsigned long size = fb->TraceMask + 1;
+  unsigned long head, last, first, i, skip;
+  struct packet_trace_snapshot *snap;
+
+  snap = vmalloc(struct_size(snap, rec, size));
+  if (!snap)
+    return -ENOMEM;
+
+  head  = smp_load_acquire(&fb->TraceHead);
+  first = head > size ? head - size : 0;
+  for (i = first; i != head; i++)
+    snap->rec[i - first] = fb->TraceRing[i & fb->TraceMask];
+  smp_rmb();
+
+  // Records older than last - size may have been overwritten during the copy
+  last = READ_ONCE(fb->TraceHead);
+  skip = last - first > size ? min(last - first - size, head - first) : 0;
+  snap->count = head - first - skip;
+  if (skip)
+    memmove(snap->rec, snap->rec + skip, snap->count * sizeof(struct packet_record));
+
+  file->private_data = snap;
+  return 0;
+}
+
+static ssize_t packet_trace_read(struct file *file, char __user *buf, size_t count, loff_t *ppos) {
+  struct packet_trace_snapshot *snap = file->private_data;
+
+  return simple_read_from_buffer(buf, count, ppos, snap->rec,
+                                 snap->count * sizeof(struct packet_record));
+}
+
+static int packet_trace_release(struct inode *inode, struct file *file) {
+  vfree(file->private_data);
+  return 0;
+}
+
+static const struct file_operations packet_trace_fops = {
+  .owner   = THIS_MODULE,
+  .open    = packet_trace_open,
+  .read    = packet_trace_read,
+  .release = packet_trace_release,
+  .llseek  = default_llseek,
+};
+
+// Explicit module init/exit (instead of module_usb_driver) to own the debugfs root
+static int __init ele784_init(void) {
+  int retval;
+
+  ele784_debugfs_root = debugfs_create_dir("logitech_orbit", NULL);
+  retval = usb_register(&udriver);
+  if (retval) {
+    printk(KERN_ERR "ELE784 -> usb_register failed: %d\n", retval);
+    debugfs_remove_recursive(ele784_debugfs_root);
+  }
+  return retval;
+}
+
+static void __exit ele784_exit(void) {
+  usb_deregister(&udriver);
+  ele784_flush_orphans();
+  debugfs_remove_recursive(ele784_debugfs_root);
+}
+
+module_init(ele784_init);
+module_exit(ele784_exit);
\ No newline at end of file
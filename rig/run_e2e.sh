@@ -0,0 +1,37 @@
+#!/bin/sh
+# End-to-end run on the emulated camera: attaches orbit_usbip to vhci_hcd,
+# loads the driver, runs e2e_bench against it, then detaches.
+#
+#   sudo ./run_e2e.sh [script] [e2e_bench options]
+#   sudo ./run_e2e.sh scripts/lossy.seq -n 1000 -c 1
+
+cd "$(dirname "$0")"
+SCRIPT=${1:-scripts/clean.seq}
+[ $# -gt 0 ] && shift
+
+modprobe vhci-hcd || exit 1
+# uvcvideo would bind to the emulated camera first
+lsmod | grep -q '^uvcvideo' && rmmod uvcvideo
+lsmod | grep -q '^logitech_orbit_driver' || insmod ../driver/logitech_orbit_driver.ko || exit 1
+
+./bin/orbit_usbip -s "$SCRIPT" &
+EMU=$!
+
+i=0
+while [ ! -e /dev/camera_stream ]; do
+    i=$((i + 1))
+    if [ $i -gt 50 ] || ! kill -0 $EMU 2>/dev/null; then
+        echo "run_e2e: /dev/camera_stream did not appear"
+        kill -INT $EMU 2>/dev/null
+        exit 1
+    fi
+    sleep 0.1
+done
+
+./bin/e2e_bench -t "$@"
+STATUS=$?
+
+# SIGINT: orbit_usbip detaches itself from vhci_hcd
+kill -INT $EMU
+wait $EMU
+exit $STATUS
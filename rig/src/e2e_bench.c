@@ -0,0 +1,284 @@
+// =============================================================
+// End-to-end benchmark of the driver against the emulated camera
+// (orbit_usbip). Streams from /dev/camera_stream, checks every delivered
+// frame against the pattern of the emulator and measures the latency from
+// the end of the last packet of a frame on the device to the return of read().
+//
+//   ./bin/e2e_bench -n 300                  300 frames, default driver settings
+//   ./bin/e2e_bench -n 300 -c 1 -P 1        mark damaged frames, low latency URBs
+//   ./bin/e2e_bench -t                      also exercise the pan/tilt unit
+//
+// Exit status is 1 when a frame has wrong content, when sequence numbers go
+// backwards, when no frame arrives or when a pan/tilt check fails.
+// =============================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <ioctl_cmds.h>
+#include "rig.h"
+
+#define MAX_LATENCIES   100000
+
+struct stats {
+    uint32_t frames;
+    uint32_t complete;
+    uint32_t repaired;
+    uint32_t bad_content;
+    uint32_t bad_sequence;
+    uint32_t skipped;       // sequence numbers never delivered (dropped frames)
+    uint64_t bytes;
+    uint32_t nlat;
+    uint64_t lat[MAX_LATENCIES];
+};
+
+static uint8_t frame[RIG_FRAME_BYTES];
+static struct stats st;
+
+static int nframes  = 300;
+static int warmup   = 10;
+static int conceal  = -1;   // -1 = leave the driver setting
+static int profile  = -1;
+static int pantilt  = 0;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int damaged(const struct frame_meta *m, uint32_t off)
+{
+    uint32_t i;
+
+    for (i = 0; i < m->damage_count && i < FRAME_META_MAX_DAMAGE; i++)
+        if (off >= m->damage[i].offset && off - m->damage[i].offset < m->damage[i].length)
+            return 1;
+    return 0;
+}
+
+// Compare the frame with the emulator pattern, skipping the damaged ranges
+static int check_frame(const struct frame_meta *m, uint32_t sequence)
+{
+    uint32_t off;
+
+    for (off = sizeof(struct rig_frame_header); off < RIG_FRAME_BYTES; off++) {
+        if (frame[off] == rig_pattern(sequence, off))
+            continue;
+        if ((m->flags & FRAME_FLAG_REPAIRED) && damaged(m, off))
+            continue;
+        fprintf(stderr, "e2e_bench: frame %u differs at offset %u (%02x, expected %02x)\n",
+                sequence, off, frame[off], rig_pattern(sequence, off));
+        return -1;
+    }
+    return 0;
+}
+
+// =============================================================
+// Streaming
+// =============================================================
+static int stream_test(int fd)
+{
+    struct frame_meta meta;
+    struct rig_frame_header h;
+    uint32_t last_seq = 0;
+    uint64_t t_start = 0, t_end;
+    int i, r;
+
+    if (conceal >= 0) {
+        struct stream_conceal c = { .mode = conceal, .min_percent = 0 };
+
+        if (ioctl(fd, IOCTL_STREAM_SET_CONCEAL, &c) < 0)
+            perror("IOCTL_STREAM_SET_CONCEAL failed");
+    }
+    if (profile >= 0) {
+        struct stream_geometry g = { .profile = profile };
+
+        if (ioctl(fd, IOCTL_STREAM_SET_GEOMETRY, &g) < 0)
+            perror("IOCTL_STREAM_SET_GEOMETRY failed");
+    }
+    if (ioctl(fd, IOCTL_STREAMON, NULL) < 0) {
+        perror("IOCTL_STREAMON failed");
+        return -1;
+    }
+
+    for (i = 0; i < warmup + nframes; i++) {
+        r = read(fd, frame, sizeof(frame));
+        if (r < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            perror("read failed");
+            break;
+        }
+        t_end = now_ns();
+        if (r != RIG_FRAME_BYTES) {
+            fprintf(stderr, "e2e_bench: short frame (%d bytes)\n", r);
+            st.bad_content++;
+            continue;
+        }
+        if (ioctl(fd, IOCTL_STREAM_GET_META, &meta) < 0)
+            memset(&meta, 0, sizeof(meta));
+        if (i == warmup)
+            t_start = t_end;
+        if (i < warmup)
+            continue;
+
+        st.frames++;
+        st.bytes += r;
+        if (meta.flags & FRAME_FLAG_REPAIRED)
+            st.repaired++;
+        else
+            st.complete++;
+
+        // The header itself may be in a damaged range of a repaired frame
+        memcpy(&h, frame, sizeof(h));
+        if (memcmp(h.magic, RIG_MAGIC, 4)) {
+            if (!(meta.flags & FRAME_FLAG_REPAIRED) || !damaged(&meta, 0)) {
+                fprintf(stderr, "e2e_bench: frame without the rig header\n");
+                st.bad_content++;
+            }
+            continue;
+        }
+        if (last_seq && h.sequence <= last_seq) {
+            fprintf(stderr, "e2e_bench: sequence %u after %u\n", h.sequence, last_seq);
+            st.bad_sequence++;
+        } else if (last_seq) {
+            st.skipped += h.sequence - last_seq - 1;
+        }
+        last_seq = h.sequence;
+        if (check_frame(&meta, h.sequence) < 0)
+            st.bad_content++;
+        if (st.nlat < MAX_LATENCIES && t_end > h.eof_ns)
+            st.lat[st.nlat++] = t_end - h.eof_ns;
+    }
+    t_end = now_ns();
+
+    if (ioctl(fd, IOCTL_STREAMOFF, NULL) < 0)
+        perror("IOCTL_STREAMOFF failed");
+
+    printf("%-10s %8s %8s %8s %8s %8s %8s %8s\n",
+           "frames", "complete", "repaired", "dropped", "errors", "fps", "MB/s", "");
+    if (st.frames && t_end > t_start) {
+        double s = (t_end - t_start) / 1e9;
+
+        printf("%-10u %8u %8u %8u %8u %8.2f %8.2f\n", st.frames, st.complete, st.repaired,
+               st.skipped, st.bad_content + st.bad_sequence, st.frames / s, st.bytes / s / 1e6);
+    }
+    if (st.nlat) {
+        qsort(st.lat, st.nlat, sizeof(st.lat[0]), cmp_u64);
+        printf("latency us: p50 %llu  p90 %llu  p99 %llu  max %llu\n",
+               (unsigned long long)st.lat[st.nlat / 2] / 1000,
+               (unsigned long long)st.lat[st.nlat * 9 / 10] / 1000,
+               (unsigned long long)st.lat[st.nlat * 99 / 100] / 1000,
+               (unsigned long long)st.lat[st.nlat - 1] / 1000);
+    }
+    return (st.frames && !st.bad_content && !st.bad_sequence) ? 0 : -1;
+}
+
+// =============================================================
+// Pan/tilt (emulated unit 11)
+// =============================================================
+static int pantilt_test(int fd)
+{
+    struct pantilt_caps caps;
+    struct pantilt_relative rel = { .pan = 640, .tilt = -320 };
+    struct pantilt_position pos;
+    uint64_t t0;
+    int err = 0;
+
+    if (ioctl(fd, IOCTL_PANTILT_GET_CAPS, &caps) < 0) {
+        perror("IOCTL_PANTILT_GET_CAPS failed");
+        return -1;
+    }
+    printf("pan/tilt caps: pan %d..%d tilt %d..%d (%s)\n", caps.pan_min, caps.pan_max,
+           caps.tilt_min, caps.tilt_max, caps.from_device ? "device" : "defaults");
+    if (!caps.from_device || caps.pan_min != PANTILT_PAN_MIN || caps.pan_max != PANTILT_PAN_MAX ||
+        caps.tilt_min != PANTILT_TILT_MIN || caps.tilt_max != PANTILT_TILT_MAX) {
+        fprintf(stderr, "e2e_bench: pan/tilt ranges not read from the device\n");
+        err = -1;
+    }
+
+    t0 = now_ns();
+    if (ioctl(fd, IOCTL_PANTILT_RESET, 0) < 0 || ioctl(fd, IOCTL_PANTILT_WAIT, 10000) < 0) {
+        perror("pan/tilt reset failed");
+        return -1;
+    }
+    printf("pan/tilt reset: %llu ms\n", (unsigned long long)(now_ns() - t0) / 1000000);
+
+    t0 = now_ns();
+    if (ioctl(fd, IOCTL_PANTILT_RELATIVE, &rel) < 0) {
+        perror("IOCTL_PANTILT_RELATIVE failed");
+        return -1;
+    }
+    printf("pan/tilt relative: %llu us to send", (unsigned long long)(now_ns() - t0) / 1000);
+    if (ioctl(fd, IOCTL_PANTILT_WAIT, 10000) < 0)
+        perror("IOCTL_PANTILT_WAIT failed");
+    printf(", %llu ms to complete\n", (unsigned long long)(now_ns() - t0) / 1000000);
+
+    if (ioctl(fd, IOCTL_PANTILT_GET_POSITION, &pos) < 0 || !pos.valid ||
+        pos.pan != rel.pan || pos.tilt != rel.tilt) {
+        fprintf(stderr, "e2e_bench: position not tracked after the relative move\n");
+        err = -1;
+    }
+    return err;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-n frames] [-w warmup] [-c conceal] [-P profile] [-t]\n"
+            "  -c  STREAM_CONCEAL_* (0 drop, 1 mark, 2 zero, 3 previous)\n"
+            "  -P  URB_PROFILE_* (0 throughput, 1 low latency, 2 adaptive)\n"
+            "  -t  check the pan/tilt unit before streaming\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt, fd_stream, fd_control, err = 0;
+
+    while ((opt = getopt(argc, argv, "n:w:c:P:th")) != -1) {
+        switch (opt) {
+        case 'n': nframes = atoi(optarg); break;
+        case 'w': warmup = atoi(optarg); break;
+        case 'c': conceal = atoi(optarg); break;
+        case 'P': profile = atoi(optarg); break;
+        case 't': pantilt = 1; break;
+        default:  usage(argv[0]); return 2;
+        }
+    }
+
+    if (pantilt) {
+        fd_control = open("/dev/camera_control", O_RDWR);
+        if (fd_control < 0) {
+            perror("open /dev/camera_control");
+            return 1;
+        }
+        if (pantilt_test(fd_control) < 0)
+            err = 1;
+        close(fd_control);
+    }
+
+    fd_stream = open("/dev/camera_stream", O_RDWR);
+    if (fd_stream < 0) {
+        perror("open /dev/camera_stream");
+        return 1;
+    }
+    if (stream_test(fd_stream) < 0)
+        err = 1;
+    close(fd_stream);
+    return err;
+}
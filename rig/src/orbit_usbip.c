@@ -0,0 +1,1207 @@
+// =============================================================
+// Emulated Logitech Orbit for the hardware-free test rig.
+//
+// A USB/IP device: once attached to vhci_hcd the kernel enumerates it like a
+// camera on a real port, the driver probes it and every request goes through
+// the USB core (control transfers, SET_INTERFACE, isochronous URBs, unlinks).
+// The device answers the standard, VideoControl, VideoStreaming and pan/tilt
+// requests and fills each isochronous URB with UVC payload packets, paced on
+// the microframe clock, following a frame script.
+//
+//   sudo ./bin/orbit_usbip -s scripts/lossy.seq   attach to vhci_hcd directly
+//   ./bin/orbit_usbip -l 3240                     or wait for "usbip attach"
+//
+// Every frame starts with a small header (struct rig_frame_header) so that
+// the reader can check its content and measure the end-to-end latency.
+// =============================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <endian.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <ioctl_cmds.h>
+#include "rig.h"
+
+// USB/IP protocol (Documentation/usb/usbip_protocol.rst), big endian
+#define USBIP_VERSION       0x0111
+#define OP_REQ_DEVLIST      0x8005
+#define OP_REP_DEVLIST      0x0005
+#define OP_REQ_IMPORT       0x8003
+#define OP_REP_IMPORT       0x0003
+#define USBIP_CMD_SUBMIT    1
+#define USBIP_CMD_UNLINK    2
+#define USBIP_RET_SUBMIT    3
+#define USBIP_RET_UNLINK    4
+#define USBIP_HEADER_SIZE   48
+#define USB_SPEED_HIGH      3
+
+#define VHCI_SYSFS          "/sys/devices/platform/vhci_hcd.0"
+#define RIG_BUSID           "1-1"
+#define RIG_DEVID           ((1 << 16) | 2)
+
+// Standard and UVC requests
+#define REQ_GET_STATUS      0x00
+#define REQ_CLEAR_FEATURE   0x01
+#define REQ_SET_FEATURE     0x03
+#define REQ_GET_DESCRIPTOR  0x06
+#define REQ_GET_CONFIG      0x08
+#define REQ_SET_CONFIG      0x09
+#define REQ_GET_INTERFACE   0x0A
+#define REQ_SET_INTERFACE   0x0B
+#define UVC_SET_CUR         0x01
+#define UVC_GET_CUR         0x81
+#define UVC_GET_MIN         0x82
+#define UVC_GET_MAX         0x83
+#define UVC_GET_RES         0x84
+#define UVC_GET_LEN         0x85
+#define UVC_GET_INFO        0x86
+#define UVC_GET_DEF         0x87
+
+// Entities of the emulated camera
+#define INTF_VC             0
+#define INTF_VS             1
+#define ENTITY_CAMERA       1
+#define ENTITY_PANTILT      11   // Logitech motor control unit (PANTILT_INDEX)
+#define ENTITY_OUTPUT       4
+#define EP_VIDEO            1    // 0x81
+
+// Payload header bits
+#define UVC_FID             0x01
+#define UVC_EOF             0x02
+#define UVC_PTS             0x04
+#define UVC_SCR             0x08
+#define UVC_STI             0x20
+#define UVC_EOH             0x80
+
+#define SLOT_NS             125000ULL  // one high-speed microframe
+#define MAX_ISO_PACKETS     256
+#define MAX_PENDING         64
+#define MAX_SEGMENTS        64
+
+#define min_len(a, b)       ((int)(a) < (int)(b) ? (int)(a) : (int)(b))
+
+#define STATUS_STALL        (-EPIPE)
+#define STATUS_UNLINKED     (-ECONNRESET)
+
+// =============================================================
+// Descriptors: a QuickCam Orbit MP with one YUYV 640x480 format, a still
+// image frame (method 2), the camera terminal and the pan/tilt unit
+// =============================================================
+static const uint8_t dev_desc[18] = {
+    18, 0x01, 0x00, 0x02, 0xEF, 0x02, 0x01, 64,
+    RIG_VID & 0xFF, RIG_VID >> 8, RIG_PID & 0xFF, RIG_PID >> 8,
+    0x05, 0x00, 1, 2, 3, 1,
+};
+
+static const uint8_t qualifier_desc[10] = {
+    10, 0x06, 0x00, 0x02, 0xEF, 0x02, 0x01, 64, 1, 0,
+};
+
+#define VC_TOTAL  (13 + 18 + 26 + 9)
+#define VS_TOTAL  (14 + 27 + 30 + 10 + 6)
+#define CFG_TOTAL (9 + 8 + 9 + VC_TOTAL + 9 + VS_TOTAL + 3 * (9 + 7))
+
+#define LE16(v)   ((v) & 0xFF), (((v) >> 8) & 0xFF)
+#define LE32(v)   ((v) & 0xFF), (((v) >> 8) & 0xFF), (((v) >> 16) & 0xFF), (((v) >> 24) & 0xFF)
+
+static const uint8_t cfg_desc[CFG_TOTAL] = {
+    // configuration
+    9, 0x02, LE16(CFG_TOTAL), 2, 1, 0, 0x80, 250,
+    // interface association
+    8, 0x0B, 0, 2, 0x0E, 0x03, 0x00, 2,
+    // VideoControl interface, no status endpoint
+    9, 0x04, INTF_VC, 0, 0, 0x0E, 0x01, 0x00, 2,
+    13, 0x24, 0x01, LE16(0x0100), LE16(VC_TOTAL), LE32(48000000), 1, INTF_VS,
+    // camera terminal: AE mode, AE priority, exposure time (absolute)
+    18, 0x24, 0x02, ENTITY_CAMERA, LE16(0x0201), 0, 0, LE16(0), LE16(0), LE16(0), 3, 0x0E, 0x00, 0x00,
+    // pan/tilt extension unit {82066163-7050-AB49-B8CC-B3855E8D2256}: relative, reset
+    26, 0x24, 0x06, ENTITY_PANTILT,
+    0x63, 0x61, 0x06, 0x82, 0x50, 0x70, 0x49, 0xAB, 0xB8, 0xCC, 0xB3, 0x85, 0x5E, 0x8D, 0x22, 0x56,
+    2, 1, ENTITY_CAMERA, 1, 0x03, 0,
+    // output terminal (USB streaming)
+    9, 0x24, 0x03, ENTITY_OUTPUT, LE16(0x0101), 0, ENTITY_PANTILT, 0,
+    // VideoStreaming interface, alternate setting 0 (no bandwidth)
+    9, 0x04, INTF_VS, 0, 0, 0x0E, 0x02, 0x00, 0,
+    14, 0x24, 0x01, 1, LE16(VS_TOTAL), 0x80 | EP_VIDEO, 0, ENTITY_OUTPUT, 2, 1, 0, 1, 0,
+    // uncompressed YUY2
+    27, 0x24, 0x04, 1, 1,
+    0x59, 0x55, 0x59, 0x32, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71,
+    16, 1, 0, 0, 0, 0,
+    30, 0x24, 0x05, 1, 0, LE16(RIG_WIDTH), LE16(RIG_HEIGHT),
+    LE32(RIG_FRAME_BYTES * 8 * 5), LE32(RIG_FRAME_BYTES * 8 * 30), LE32(RIG_FRAME_BYTES),
+    LE32(333333), 1, LE32(333333),
+    // still image frame (method 2, no dedicated endpoint)
+    10, 0x24, 0x03, 0, 1, LE16(RIG_WIDTH), LE16(RIG_HEIGHT), 0,
+    // color matching
+    6, 0x24, 0x0D, 1, 1, 4,
+    // alternate settings 1..3: 1024, 2048 and 3060 bytes per microframe
+    9, 0x04, INTF_VS, 1, 1, 0x0E, 0x02, 0x00, 0,
+    7, 0x05, 0x80 | EP_VIDEO, 0x05, LE16(0x0400), 1,
+    9, 0x04, INTF_VS, 2, 1, 0x0E, 0x02, 0x00, 0,
+    7, 0x05, 0x80 | EP_VIDEO, 0x05, LE16(0x0800 | 1024), 1,
+    9, 0x04, INTF_VS, 3, 1, 0x0E, 0x02, 0x00, 0,
+    7, 0x05, 0x80 | EP_VIDEO, 0x05, LE16(0x1000 | 1020), 1,
+};
+
+static const uint16_t alt_packet_size[4] = { 0, 1024, 2048, 3060 };
+
+static const char *strings[] = { NULL, "Logitech", "QuickCam Orbit MP (ELE784 rig)", "ELE784-RIG" };
+
+// =============================================================
+// Frame script
+// =============================================================
+struct segment {
+    uint32_t frames;     // 0 = forever
+    uint32_t fps;        // 0 = committed frame interval
+    uint32_t loss;       // lost packets, per mille
+    uint32_t eof_every;  // EOF in the middle of every Nth frame
+    uint32_t fid_every;  // one packet with the wrong FID in every Nth frame
+};
+
+struct generator {
+    struct segment seg[MAX_SEGMENTS];
+    int       nseg;
+    int       loop;
+    // position
+    int       cur;
+    uint32_t  frame_in_seg;
+    uint32_t  slot;          // in the current frame
+    uint32_t  slots_per_frame;
+    uint64_t  slot_ns;
+    uint32_t  npk;           // payload packets of a frame
+    uint8_t   fid;
+    int       done;
+    int       is_still;
+    uint32_t  seq;           // preview frames started
+    uint64_t  t_next;        // start of the next slot (CLOCK_MONOTONIC)
+    uint64_t  t_eof;
+    // counters
+    uint64_t  frames, stills, packets, lost, missed;
+};
+
+struct iso_urb {
+    uint32_t seqnum;
+    uint32_t devid;
+    int      npackets;
+    uint64_t arrival;
+    uint32_t offset[MAX_ISO_PACKETS];
+    uint32_t length[MAX_ISO_PACKETS];
+    int      cancelled;
+};
+
+struct device {
+    int              fd;
+    pthread_mutex_t  send_lock;
+    pthread_mutex_t  gen_lock;     // generator (stream thread, SET_INTERFACE)
+    pthread_mutex_t  lock;         // URB queue and device state
+    pthread_cond_t   cond;
+    struct iso_urb   pending[MAX_PENDING];
+    int              head, count;
+    struct iso_urb   current;
+    int              busy;         // current is being filled
+    int              running;
+    int              alt;
+    uint8_t          probe[34];
+    uint8_t          still_probe[11];
+    int              still_pending;
+    uint8_t          ae_mode, ae_priority;
+    uint32_t         exposure;
+    int16_t          pan, tilt;
+    struct generator gen;
+};
+
+static struct device dev;
+static volatile sig_atomic_t stop;
+static int verbose;
+static int vhci_port = -1;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t)
+{
+    struct timespec ts = { .tv_sec = t / 1000000000ULL, .tv_nsec = t % 1000000000ULL };
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !stop)
+        ;
+}
+
+static int load_script(struct generator *g, const char *path)
+{
+    char line[256], *p, *tok;
+    FILE *fp = fopen(path, "r");
+    struct segment *s;
+
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp) && g->nseg < MAX_SEGMENTS) {
+        if ((p = strchr(line, '#')))
+            *p = 0;
+        s = &g->seg[g->nseg];
+        memset(s, 0, sizeof(*s));
+        if (sscanf(line, "%u %u", &s->frames, &s->fps) != 2)
+            continue;
+        strtok(line, " \t\n");
+        strtok(NULL, " \t\n");
+        while ((tok = strtok(NULL, " \t\n"))) {
+            if (!strncmp(tok, "loss=", 5))
+                s->loss = atoi(tok + 5);
+            else if (!strncmp(tok, "eof=", 4))
+                s->eof_every = atoi(tok + 4);
+            else if (!strncmp(tok, "fid=", 4))
+                s->fid_every = atoi(tok + 4);
+            else if (!strcmp(tok, "loop"))
+                g->loop = 1;
+            else
+                fprintf(stderr, "%s: unknown option %s\n", path, tok);
+        }
+        g->nseg++;
+    }
+    fclose(fp);
+    return g->nseg ? 0 : -1;
+}
+
+// Rate of the segment, or of the committed probe
+static uint32_t segment_fps(const struct segment *s)
+{
+    uint32_t interval = dev.probe[4] | (dev.probe[5] << 8) | (dev.probe[6] << 16) | ((uint32_t)dev.probe[7] << 24);
+
+    if (s->fps)
+        return s->fps;
+    return interval ? (10000000 + interval / 2) / interval : 30;
+}
+
+// Slot length: one microframe, shorter when the frame would not fit in its interval
+static void segment_enter(struct generator *g)
+{
+    uint64_t frame_ns = 1000000000ULL / segment_fps(&g->seg[g->cur]);
+
+    g->slot_ns = SLOT_NS;
+    if ((g->npk + 1) * SLOT_NS > frame_ns) {
+        g->slot_ns = frame_ns / (g->npk + 1);
+        if (verbose)
+            printf("orbit_usbip: %u fps needs %llu ns slots (faster than the bus)\n",
+                   segment_fps(&g->seg[g->cur]), (unsigned long long)g->slot_ns);
+    }
+    g->slots_per_frame = frame_ns / g->slot_ns;
+    g->frame_in_seg = 0;
+}
+
+static void gen_reset(struct generator *g, uint32_t payload)
+{
+    g->cur = 0;
+    g->slot = 0;
+    g->done = 0;
+    g->seq = 0;
+    g->fid = 0;
+    g->npk = (RIG_FRAME_BYTES + payload - 1) / payload;
+    g->t_next = now_ns();
+    segment_enter(g);
+}
+
+static void frame_fill(uint8_t *dst, uint32_t off, uint32_t len, const struct rig_frame_header *h)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++, off++)
+        dst[i] = (off < sizeof(*h)) ? ((const uint8_t *)h)[off] : rig_pattern(h->sequence, off);
+}
+
+// Produce the packet of the next slot (max_len bytes at most), returns its length
+static uint32_t gen_slot(struct generator *g, uint8_t *out, uint32_t max_len, int *status)
+{
+    const struct segment *s = &g->seg[g->cur];
+    struct rig_frame_header h;
+    uint32_t payload = max_len - RIG_HEADER_LEN, off, len = 0;
+    uint8_t flags;
+
+    *status = 0;
+    if (g->slot == 0 && !g->done) {
+        // a new frame (the still image takes the place of a preview frame)
+        g->fid ^= UVC_FID;
+        g->is_still = 0;
+        pthread_mutex_lock(&dev.lock);
+        if (dev.still_pending) {
+            dev.still_pending = 0;
+            g->is_still = 1;
+        }
+        pthread_mutex_unlock(&dev.lock);
+        g->t_eof = g->t_next + (uint64_t)g->npk * g->slot_ns;
+        if (!g->is_still)
+            g->seq++;
+    }
+
+    flags = UVC_EOH | UVC_PTS | UVC_SCR | g->fid;
+    if (!g->done && g->slot < g->npk) {
+        off = g->slot * payload;
+        len = (off + payload > RIG_FRAME_BYTES) ? RIG_FRAME_BYTES - off : payload;
+        if (g->slot == g->npk - 1)
+            flags |= UVC_EOF;
+        if (g->is_still)
+            flags |= UVC_STI;
+        if (s->eof_every && g->seq % s->eof_every == 0 && g->slot == g->npk / 3)
+            flags |= UVC_EOF;
+        if (s->fid_every && g->seq % s->fid_every == 0 && g->slot == g->npk / 2)
+            flags ^= UVC_FID;
+        g->packets++;
+        if (s->loss && (uint32_t)(rand() % 1000) < s->loss) {
+            *status = -EPROTO;
+            g->lost++;
+            len = 0;
+            goto next;
+        }
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, g->is_still ? RIG_MAGIC_STILL : RIG_MAGIC, 4);
+        h.sequence = g->seq;
+        h.eof_ns = g->t_eof;
+        frame_fill(out + RIG_HEADER_LEN, off, len, &h);
+    }
+    // payload header, PTS = frame number, SCR = slot time
+    out[0] = RIG_HEADER_LEN;
+    out[1] = flags;
+    memcpy(out + 2, &g->seq, 4);
+    memset(out + 6, 0, 6);
+    len += RIG_HEADER_LEN;
+
+next:
+    g->t_next += g->slot_ns;
+    if (++g->slot < g->slots_per_frame || g->done)
+        return len;
+    // end of the frame interval
+    g->slot = 0;
+    if (g->is_still)
+        g->stills++;
+    else
+        g->frames++;
+    if (g->is_still || !s->frames || ++g->frame_in_seg < s->frames)
+        return len;
+    if (++g->cur == g->nseg) {
+        if (!g->loop) {
+            g->done = 1;
+            g->cur--;
+            printf("orbit_usbip: end of the script, %llu frames sent\n", (unsigned long long)g->frames);
+            return len;
+        }
+        g->cur = 0;
+    }
+    segment_enter(g);
+    return len;
+}
+
+// =============================================================
+// USB/IP transport
+// =============================================================
+static int send_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    ssize_t n;
+
+    while (len) {
+        n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int recv_all(int fd, void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    ssize_t n;
+
+    while (len) {
+        n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR && !stop)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    v = htonl(v);
+    memcpy(p, &v, 4);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, 4);
+    return ntohl(v);
+}
+
+// RET_SUBMIT with the IN data (packed, for an isochronous URB) and the packet descriptors
+static int ret_submit(uint32_t seqnum, uint32_t devid, int status, uint32_t actual,
+                      const uint8_t *data, int npackets, const uint8_t *iso, int error_count)
+{
+    uint8_t hdr[USBIP_HEADER_SIZE] = {0};
+    int ret;
+
+    put32(hdr + 0, USBIP_RET_SUBMIT);
+    put32(hdr + 4, seqnum);
+    put32(hdr + 8, devid);
+    put32(hdr + 20, status);
+    put32(hdr + 24, actual);
+    put32(hdr + 32, npackets);
+    put32(hdr + 36, error_count);
+
+    pthread_mutex_lock(&dev.send_lock);
+    ret = send_all(dev.fd, hdr, sizeof(hdr));
+    if (!ret && data && actual)
+        ret = send_all(dev.fd, data, actual);
+    if (!ret && npackets > 0)
+        ret = send_all(dev.fd, iso, npackets * 16);
+    pthread_mutex_unlock(&dev.send_lock);
+    return ret;
+}
+
+// =============================================================
+// Control requests
+// =============================================================
+static int get_string(uint8_t idx, uint8_t *out, uint16_t max)
+{
+    const char *s;
+    int i, n;
+
+    if (idx == 0) {
+        out[0] = 4; out[1] = 0x03; out[2] = 0x09; out[3] = 0x04;
+        return min_len(4, max);
+    }
+    if (idx >= sizeof(strings) / sizeof(strings[0]))
+        return STATUS_STALL;
+    s = strings[idx];
+    n = strlen(s);
+    out[0] = 2 + 2 * n;
+    out[1] = 0x03;
+    for (i = 0; i < n; i++) {
+        out[2 + 2 * i] = s[i];
+        out[3 + 2 * i] = 0;
+    }
+    return min_len(out[0], max);
+}
+
+static int copy_reply(uint8_t *out, const void *src, int len, uint16_t max)
+{
+    len = min_len(len, max);
+    memcpy(out, src, len);
+    return len;
+}
+
+static int16_t le16s(const uint8_t *p)
+{
+    return (int16_t)(p[0] | (p[1] << 8));
+}
+
+static void put_le16(uint8_t *p, int v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static int clamp16(int v, int lo, int hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static void probe_default(uint8_t *p)
+{
+    memset(p, 0, 34);
+    p[0] = 1;                              // bmHint: frame interval
+    p[2] = 1;                              // bFormatIndex
+    p[3] = 1;                              // bFrameIndex
+    p[4] = 333333 & 0xFF; p[5] = (333333 >> 8) & 0xFF; p[6] = 333333 >> 16;
+    p[18] = RIG_FRAME_BYTES & 0xFF; p[19] = (RIG_FRAME_BYTES >> 8) & 0xFF; p[20] = RIG_FRAME_BYTES >> 16;
+    p[22] = 3060 & 0xFF; p[23] = 3060 >> 8;
+    p[26] = 0x00; p[27] = 0x6C; p[28] = 0xDC; p[29] = 0x02;  // 48 MHz
+}
+
+// VideoStreaming interface: probe/commit, still probe/commit and trigger
+static int vs_request(uint8_t req, uint8_t cs, uint8_t *buf, uint16_t len)
+{
+    uint32_t interval;
+
+    switch (cs) {
+    case 0x01:  // VS_PROBE_CONTROL
+    case 0x02:  // VS_COMMIT_CONTROL
+        if (req == UVC_SET_CUR) {
+            memcpy(dev.probe, buf, min_len(len, 34));
+            interval = buf[4] | (buf[5] << 8) | (buf[6] << 16) | ((uint32_t)buf[7] << 24);
+            if (interval < 83333 || interval > 10000000)
+                interval = 333333;
+            dev.probe[2] = 1;
+            dev.probe[3] = 1;
+            dev.probe[4] = interval & 0xFF; dev.probe[5] = (interval >> 8) & 0xFF;
+            dev.probe[6] = (interval >> 16) & 0xFF; dev.probe[7] = interval >> 24;
+            dev.probe[18] = RIG_FRAME_BYTES & 0xFF; dev.probe[19] = (RIG_FRAME_BYTES >> 8) & 0xFF;
+            dev.probe[20] = RIG_FRAME_BYTES >> 16; dev.probe[21] = 0;
+            dev.probe[22] = 3060 & 0xFF; dev.probe[23] = 3060 >> 8; dev.probe[24] = 0; dev.probe[25] = 0;
+            if (cs == 0x02)
+                printf("orbit_usbip: committed %u fps\n", (10000000 + interval / 2) / interval);
+            return len;
+        }
+        if (req == UVC_GET_INFO)
+            return buf[0] = 0x03, 1;
+        if (req == UVC_GET_LEN)
+            return put_le16(buf, 26), 2;
+        if (req == UVC_GET_DEF || req == UVC_GET_MIN || req == UVC_GET_MAX) {
+            uint8_t def[34];
+
+            probe_default(def);
+            return copy_reply(buf, def, 34, len);
+        }
+        return copy_reply(buf, dev.probe, 34, len);
+    case 0x03:  // VS_STILL_PROBE_CONTROL
+    case 0x04:  // VS_STILL_COMMIT_CONTROL
+        if (req == UVC_SET_CUR) {
+            memcpy(dev.still_probe, buf, min_len(len, 11));
+            dev.still_probe[0] = 1;
+            dev.still_probe[1] = 1;
+            dev.still_probe[3] = RIG_FRAME_BYTES & 0xFF; dev.still_probe[4] = (RIG_FRAME_BYTES >> 8) & 0xFF;
+            dev.still_probe[5] = RIG_FRAME_BYTES >> 16; dev.still_probe[6] = 0;
+            dev.still_probe[7] = 3060 & 0xFF; dev.still_probe[8] = 3060 >> 8;
+            return len;
+        }
+        if (req == UVC_GET_INFO)
+            return buf[0] = 0x03, 1;
+        return copy_reply(buf, dev.still_probe, 11, len);
+    case 0x05:  // VS_STILL_IMAGE_TRIGGER_CONTROL
+        if (req == UVC_SET_CUR) {
+            if (len >= 1 && buf[0] == 1) {
+                pthread_mutex_lock(&dev.lock);
+                dev.still_pending = 1;
+                pthread_mutex_unlock(&dev.lock);
+                if (verbose)
+                    printf("orbit_usbip: still image triggered\n");
+            }
+            return len;
+        }
+        if (req == UVC_GET_INFO)
+            return buf[0] = 0x03, 1;
+        return buf[0] = 0, min_len(1, len);
+    }
+    return STATUS_STALL;
+}
+
+// Camera terminal: auto-exposure mode and priority, exposure time
+static int camera_request(uint8_t req, uint8_t cs, uint8_t *buf, uint16_t len)
+{
+    if (req == UVC_GET_INFO)
+        return buf[0] = 0x03, 1;
+    switch (cs) {
+    case 0x02:  // CT_AE_MODE_CONTROL
+        if (req == UVC_SET_CUR)
+            return dev.ae_mode = buf[0], len;
+        if (req == UVC_GET_RES)
+            return buf[0] = 0x0F, 1;
+        return buf[0] = (req == UVC_GET_CUR) ? dev.ae_mode : 0x08, min_len(1, len);
+    case 0x03:  // CT_AE_PRIORITY_CONTROL
+        if (req == UVC_SET_CUR)
+            return dev.ae_priority = buf[0], len;
+        return buf[0] = (req == UVC_GET_CUR) ? dev.ae_priority : 0, min_len(1, len);
+    case 0x04:  // CT_EXPOSURE_TIME_ABSOLUTE_CONTROL
+        if (req == UVC_SET_CUR) {
+            dev.exposure = buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+            return len;
+        }
+        if (len < 4)
+            return STATUS_STALL;
+        {
+            uint32_t v = (req == UVC_GET_CUR) ? dev.exposure : (req == UVC_GET_MIN || req == UVC_GET_RES) ? 1 :
+                         (req == UVC_GET_MAX) ? 10000 : 333;
+
+            buf[0] = v & 0xFF; buf[1] = (v >> 8) & 0xFF; buf[2] = (v >> 16) & 0xFF; buf[3] = v >> 24;
+        }
+        return 4;
+    }
+    return STATUS_STALL;
+}
+
+// Pan/tilt unit: relative move (4 bytes) and reset (1 byte)
+static int pantilt_request(uint8_t req, uint8_t cs, uint8_t *buf, uint16_t len)
+{
+    if (req == UVC_GET_INFO)
+        return buf[0] = 0x03, 1;
+    if (cs == 0x01) {
+        if (req == UVC_GET_LEN)
+            return put_le16(buf, 4), 2;
+        if (len < 4)
+            return STATUS_STALL;
+        switch (req) {
+        case UVC_SET_CUR:
+            dev.pan  = clamp16(dev.pan + le16s(buf), PANTILT_PAN_MIN, PANTILT_PAN_MAX);
+            dev.tilt = clamp16(dev.tilt + le16s(buf + 2), PANTILT_TILT_MIN, PANTILT_TILT_MAX);
+            if (verbose)
+                printf("orbit_usbip: pan/tilt %+d %+d -> %d %d\n", le16s(buf), le16s(buf + 2), dev.pan, dev.tilt);
+            return len;
+        case UVC_GET_MIN: put_le16(buf, PANTILT_PAN_MIN); put_le16(buf + 2, PANTILT_TILT_MIN); return 4;
+        case UVC_GET_MAX: put_le16(buf, PANTILT_PAN_MAX); put_le16(buf + 2, PANTILT_TILT_MAX); return 4;
+        case UVC_GET_RES: put_le16(buf, 64); put_le16(buf + 2, 64); return 4;
+        case UVC_GET_DEF:
+        case UVC_GET_CUR: put_le16(buf, 0); put_le16(buf + 2, 0); return 4;
+        }
+    } else if (cs == 0x02) {
+        if (req == UVC_GET_LEN)
+            return put_le16(buf, 1), 2;
+        if (req == UVC_SET_CUR) {
+            dev.pan = dev.tilt = 0;
+            if (verbose)
+                printf("orbit_usbip: pan/tilt reset\n");
+            return len;
+        }
+        return buf[0] = 0, min_len(1, len);
+    }
+    return STATUS_STALL;
+}
+
+// Returns the length of the answer (IN) or of the accepted data (OUT), or a negative status
+static int control_request(const uint8_t *setup, uint8_t *buf)
+{
+    uint8_t  type = setup[0], req = setup[1];
+    uint16_t value = setup[2] | (setup[3] << 8);
+    uint16_t index = setup[4] | (setup[5] << 8);
+    uint16_t len = setup[6] | (setup[7] << 8);
+
+    if ((type & 0x60) == 0x00) {
+        switch (req) {
+        case REQ_GET_DESCRIPTOR:
+            switch (value >> 8) {
+            case 0x01: return copy_reply(buf, dev_desc, sizeof(dev_desc), len);
+            case 0x02: return copy_reply(buf, cfg_desc, sizeof(cfg_desc), len);
+            case 0x03: return get_string(value & 0xFF, buf, len);
+            case 0x06: return copy_reply(buf, qualifier_desc, sizeof(qualifier_desc), len);
+            }
+            return STATUS_STALL;
+        case REQ_SET_CONFIG:
+            return 0;
+        case REQ_GET_CONFIG:
+            return buf[0] = 1, min_len(1, len);
+        case REQ_GET_INTERFACE:
+            return buf[0] = (index == INTF_VS) ? dev.alt : 0, min_len(1, len);
+        case REQ_SET_INTERFACE:
+            if (index != INTF_VS)
+                return value == 0 ? 0 : STATUS_STALL;
+            if (value > 3)
+                return STATUS_STALL;
+            pthread_mutex_lock(&dev.gen_lock);
+            if (value)
+                gen_reset(&dev.gen, alt_packet_size[value] - RIG_HEADER_LEN);
+            pthread_mutex_unlock(&dev.gen_lock);
+            pthread_mutex_lock(&dev.lock);
+            dev.alt = value;
+            pthread_mutex_unlock(&dev.lock);
+            printf("orbit_usbip: streaming interface alternate setting %u (%u bytes per microframe)\n",
+                   value, alt_packet_size[value]);
+            return 0;
+        case REQ_GET_STATUS:
+            buf[0] = buf[1] = 0;
+            return min_len(2, len);
+        case REQ_CLEAR_FEATURE:
+        case REQ_SET_FEATURE:
+            return 0;
+        }
+        return STATUS_STALL;
+    }
+
+    if ((type & 0x60) != 0x20 || (type & 0x1F) != 0x01)
+        return STATUS_STALL;
+    // class request to an interface: wIndex = entity << 8 | interface
+    if ((index & 0xFF) == INTF_VS && (index >> 8) == 0)
+        return vs_request(req, value >> 8, buf, len);
+    if ((index & 0xFF) == INTF_VC && (index >> 8) == ENTITY_CAMERA)
+        return camera_request(req, value >> 8, buf, len);
+    if ((index & 0xFF) == INTF_VC && (index >> 8) == ENTITY_PANTILT)
+        return pantilt_request(req, value >> 8, buf, len);
+    return STATUS_STALL;
+}
+
+// =============================================================
+// Isochronous stream: one thread fills the queued URBs on the microframe clock
+// =============================================================
+static void *stream_thread(void *arg)
+{
+    static uint8_t data[MAX_ISO_PACKETS * 3060];
+    static uint8_t iso[MAX_ISO_PACKETS * 16];
+    static uint8_t scratch[3060];
+    struct generator *g = &dev.gen;
+    struct iso_urb *u = &dev.current;
+    uint32_t total, len, psize;
+    int i, status, errors;
+    uint64_t now;
+
+    (void)arg;
+    while (!stop) {
+        pthread_mutex_lock(&dev.lock);
+        while (!stop && dev.count == 0)
+            pthread_cond_wait(&dev.cond, &dev.lock);
+        if (stop) {
+            pthread_mutex_unlock(&dev.lock);
+            break;
+        }
+        *u = dev.pending[dev.head];
+        dev.head = (dev.head + 1) % MAX_PENDING;
+        dev.count--;
+        dev.busy = 1;
+        psize = alt_packet_size[dev.alt];
+        pthread_mutex_unlock(&dev.lock);
+
+        pthread_mutex_lock(&dev.gen_lock);
+        // Intervals that passed before the URB was queued are lost, as on the bus
+        if (!psize)
+            g->t_next = now_ns();  // not streaming: the URB completes empty at once
+        while (psize && g->t_next + g->slot_ns < u->arrival) {
+            gen_slot(g, scratch, psize, &status);
+            g->missed++;
+        }
+
+        total = 0;
+        errors = 0;
+        for (i = 0; i < u->npackets; i++) {
+            len = 0;
+            status = 0;
+            if (psize)
+                len = gen_slot(g, data + total, min_len(u->length[i], psize), &status);
+            errors += (status != 0);
+            put32(iso + 16 * i + 0, u->offset[i]);
+            put32(iso + 16 * i + 4, u->length[i]);
+            put32(iso + 16 * i + 8, len);
+            put32(iso + 16 * i + 12, status);
+            total += len;
+        }
+        now = g->t_next;
+        pthread_mutex_unlock(&dev.gen_lock);
+
+        // Complete the URB at the end of its last interval
+        sleep_until(now);
+
+        pthread_mutex_lock(&dev.lock);
+        dev.busy = 0;
+        if (u->cancelled) {
+            pthread_mutex_unlock(&dev.lock);
+            continue;
+        }
+        pthread_mutex_unlock(&dev.lock);
+        if (ret_submit(u->seqnum, u->devid, 0, total, data, u->npackets, iso, errors) < 0)
+            break;
+    }
+    return NULL;
+}
+
+static int queue_iso(const uint8_t *hdr)
+{
+    uint32_t npackets = get32(hdr + 32);
+    static uint8_t desc[MAX_ISO_PACKETS * 16];
+    struct iso_urb *u;
+    uint32_t i;
+
+    if (npackets == 0 || npackets > MAX_ISO_PACKETS) {
+        fprintf(stderr, "orbit_usbip: unsupported isochronous URB of %u packets\n", npackets);
+        return -1;
+    }
+    if (recv_all(dev.fd, desc, npackets * 16) < 0)
+        return -1;
+
+    pthread_mutex_lock(&dev.lock);
+    if (dev.count == MAX_PENDING) {
+        pthread_mutex_unlock(&dev.lock);
+        return ret_submit(get32(hdr + 4), get32(hdr + 8), -ENOSPC, 0, NULL, 0, NULL, 0);
+    }
+    u = &dev.pending[(dev.head + dev.count) % MAX_PENDING];
+    u->seqnum = get32(hdr + 4);
+    u->devid = get32(hdr + 8);
+    u->npackets = npackets;
+    u->arrival = now_ns();
+    u->cancelled = 0;
+    for (i = 0; i < npackets; i++) {
+        u->offset[i] = get32(desc + 16 * i);
+        u->length[i] = get32(desc + 16 * i + 4);
+    }
+    dev.count++;
+    pthread_cond_signal(&dev.cond);
+    pthread_mutex_unlock(&dev.lock);
+    return 0;
+}
+
+static int unlink_urb(const uint8_t *hdr)
+{
+    uint32_t victim = get32(hdr + 20);
+    uint8_t ret[USBIP_HEADER_SIZE] = {0};
+    int i, n, status = 0;
+
+    pthread_mutex_lock(&dev.lock);
+    if (dev.busy && dev.current.seqnum == victim) {
+        dev.current.cancelled = 1;
+        status = STATUS_UNLINKED;
+    }
+    for (i = 0; i < dev.count; i++) {
+        n = (dev.head + i) % MAX_PENDING;
+        if (dev.pending[n].seqnum == victim) {
+            // drop it from the queue, keeping the order of the others
+            for (; i < dev.count - 1; i++)
+                dev.pending[(dev.head + i) % MAX_PENDING] = dev.pending[(dev.head + i + 1) % MAX_PENDING];
+            dev.count--;
+            status = STATUS_UNLINKED;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&dev.lock);
+
+    put32(ret + 0, USBIP_RET_UNLINK);
+    put32(ret + 4, get32(hdr + 4));
+    put32(ret + 8, get32(hdr + 8));
+    put32(ret + 20, status);
+    pthread_mutex_lock(&dev.send_lock);
+    i = send_all(dev.fd, ret, sizeof(ret));
+    pthread_mutex_unlock(&dev.send_lock);
+    return i;
+}
+
+static int serve(void)
+{
+    static uint8_t buf[65536];
+    uint8_t hdr[USBIP_HEADER_SIZE];
+    uint32_t cmd, dir, ep, length;
+    int ret;
+
+    while (!stop) {
+        if (recv_all(dev.fd, hdr, sizeof(hdr)) < 0)
+            return stop ? 0 : -1;
+        cmd = get32(hdr);
+        dir = get32(hdr + 12);
+        ep = get32(hdr + 16);
+
+        if (cmd == USBIP_CMD_UNLINK) {
+            if (unlink_urb(hdr) < 0)
+                return -1;
+            continue;
+        }
+        if (cmd != USBIP_CMD_SUBMIT) {
+            fprintf(stderr, "orbit_usbip: unknown command %u\n", cmd);
+            return -1;
+        }
+
+        length = get32(hdr + 24);
+        if (ep == EP_VIDEO && dir == 1) {
+            if (queue_iso(hdr) < 0)
+                return -1;
+            continue;
+        }
+        if (ep != 0 || length > sizeof(buf)) {
+            fprintf(stderr, "orbit_usbip: unexpected URB on endpoint %u (%u bytes)\n", ep, length);
+            return -1;
+        }
+        // control transfer; OUT data follows the header
+        memset(buf, 0, length);
+        if (dir == 0 && length && recv_all(dev.fd, buf, length) < 0)
+            return -1;
+        ret = control_request(hdr + 40, buf);
+        if (verbose > 1)
+            printf("orbit_usbip: ctrl %02x %02x %02x%02x %02x%02x len %u -> %d\n",
+                   hdr[40], hdr[41], hdr[43], hdr[42], hdr[45], hdr[44], length, ret);
+        if (ret < 0)
+            ret = ret_submit(get32(hdr + 4), get32(hdr + 8), ret, 0, NULL, 0, NULL, 0);
+        else if (dir == 1)
+            ret = ret_submit(get32(hdr + 4), get32(hdr + 8), 0, min_len(ret, length), buf, 0, NULL, 0);
+        else
+            ret = ret_submit(get32(hdr + 4), get32(hdr + 8), 0, length, NULL, 0, NULL, 0);
+        if (ret < 0)
+            return -1;
+    }
+    return 0;
+}
+
+// =============================================================
+// Attachment: straight to vhci_hcd through sysfs, or through "usbip attach"
+// =============================================================
+
+// struct usbip_usb_device, followed in OP_REP_DEVLIST by the interfaces
+static void put_device(uint8_t *p)
+{
+    memset(p, 0, 312);
+    snprintf((char *)p, 256, "/sys/devices/platform/orbit-rig/usb1/" RIG_BUSID);
+    snprintf((char *)p + 256, 32, RIG_BUSID);
+    put32(p + 288, 1);              // busnum
+    put32(p + 292, 2);              // devnum
+    put32(p + 296, USB_SPEED_HIGH);
+    memcpy(p + 300, (uint16_t[]){ htons(RIG_VID), htons(RIG_PID), htons(0x0005) }, 6);
+    p[306] = 0xEF; p[307] = 0x02; p[308] = 0x01;
+    p[309] = 1;                     // bConfigurationValue
+    p[310] = 1;                     // bNumConfigurations
+    p[311] = 2;                     // bNumInterfaces
+}
+
+// Answer OP_REQ_DEVLIST / OP_REQ_IMPORT until a client imports the device
+static int usbip_handshake(int fd)
+{
+    uint8_t req[8], busid[32], rep[8 + 4 + 312 + 8];
+    uint16_t code;
+
+    for (;;) {
+        if (recv_all(fd, req, sizeof(req)) < 0)
+            return -1;
+        code = (req[2] << 8) | req[3];
+        memset(rep, 0, sizeof(rep));
+        rep[0] = USBIP_VERSION >> 8;
+        rep[1] = USBIP_VERSION & 0xFF;
+        if (code == OP_REQ_DEVLIST) {
+            rep[3] = OP_REP_DEVLIST;
+            put32(rep + 8, 1);
+            put_device(rep + 12);
+            rep[324] = 0x0E; rep[325] = 0x01;   // interfaces: VideoControl, VideoStreaming
+            rep[328] = 0x0E; rep[329] = 0x02;
+            if (send_all(fd, rep, sizeof(rep)) < 0)
+                return -1;
+            return 1;  // "usbip list" closes the connection
+        }
+        if (code != OP_REQ_IMPORT || recv_all(fd, busid, sizeof(busid)) < 0)
+            return -1;
+        rep[3] = OP_REP_IMPORT;
+        if (strncmp((char *)busid, RIG_BUSID, sizeof(busid))) {
+            put32(rep + 4, 1);
+            send_all(fd, rep, 8);
+            return -1;
+        }
+        put_device(rep + 8);
+        return send_all(fd, rep, 8 + 312);
+    }
+}
+
+static int listen_tcp(int port)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    int fd, one = 1;
+
+    addr.sin_addr.s_addr = htonl(port ? INADDR_ANY : INADDR_LOOPBACK);
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void tcp_tune(int fd)
+{
+    int one = 1;
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+// A free high-speed port of vhci_hcd.0 ("hs  0003 004 ..." = not in use)
+static int vhci_free_port(void)
+{
+    char line[256], hub[8];
+    int port, sta, found = -1;
+    FILE *fp = fopen(VHCI_SYSFS "/status", "r");
+
+    if (!fp) {
+        perror(VHCI_SYSFS "/status (modprobe vhci-hcd)");
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%7s %d %d", hub, &port, &sta) == 3 && !strcmp(hub, "hs") && sta == 4) {
+            found = port;
+            break;
+        }
+    }
+    fclose(fp);
+    return found;
+}
+
+static int vhci_write(const char *file, const char *text)
+{
+    char path[128];
+    FILE *fp;
+    int ret;
+
+    snprintf(path, sizeof(path), VHCI_SYSFS "/%s", file);
+    fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    ret = fputs(text, fp) < 0 ? -1 : 0;
+    if (fclose(fp) != 0)
+        ret = -1;
+    if (ret < 0)
+        perror(path);
+    return ret;
+}
+
+// Hand one end of a loopback TCP connection to vhci_hcd, serve the other one
+static int vhci_attach(void)
+{
+    struct sockaddr_in addr;
+    socklen_t alen = sizeof(addr);
+    char cmd[64];
+    int lfd, client, server, port;
+
+    port = vhci_free_port();
+    if (port < 0) {
+        fprintf(stderr, "orbit_usbip: no free high-speed port on vhci_hcd.0\n");
+        return -1;
+    }
+    lfd = listen_tcp(0);
+    if (lfd < 0 || getsockname(lfd, (struct sockaddr *)&addr, &alen) < 0) {
+        perror("listen");
+        return -1;
+    }
+    client = socket(AF_INET, SOCK_STREAM, 0);
+    if (client < 0 || connect(client, (struct sockaddr *)&addr, alen) < 0) {
+        perror("connect");
+        return -1;
+    }
+    server = accept(lfd, NULL, NULL);
+    close(lfd);
+    if (server < 0) {
+        perror("accept");
+        return -1;
+    }
+    tcp_tune(client);
+    tcp_tune(server);
+
+    snprintf(cmd, sizeof(cmd), "%d %d %u %u", port, client, RIG_DEVID, USB_SPEED_HIGH);
+    if (vhci_write("attach", cmd) < 0)
+        return -1;
+    close(client);  // vhci_hcd holds its own reference
+    vhci_port = port;
+    printf("orbit_usbip: attached to vhci_hcd.0 port %d\n", port);
+    return server;
+}
+
+static void vhci_detach(void)
+{
+    char cmd[16];
+
+    if (vhci_port < 0)
+        return;
+    snprintf(cmd, sizeof(cmd), "%d", vhci_port);
+    vhci_write("detach", cmd);
+    vhci_port = -1;
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-s script] [-f fps] [-L loss_permille] [-l tcp_port] [-v]\n"
+            "  default: attach to vhci_hcd.0 (root), stream at the committed rate forever\n"
+            "  -l port: wait for \"usbip attach -r <host> -b " RIG_BUSID "\" instead\n"
+            "  script lines: <frames> <fps> [loss=<per mille>] [eof=<every n>] [fid=<every n>] [loop]\n"
+            "                (frames 0 = forever, fps 0 = committed rate)\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    struct sigaction sa = { .sa_handler = on_signal };
+    struct generator *g = &dev.gen;
+    const char *script = NULL;
+    int opt, port = -1, lfd, ret;
+    uint32_t fps = 0, loss = 0;
+    pthread_t th;
+
+    while ((opt = getopt(argc, argv, "s:f:L:l:vh")) != -1) {
+        switch (opt) {
+        case 's': script = optarg; break;
+        case 'f': fps = atoi(optarg); break;
+        case 'L': loss = atoi(optarg); break;
+        case 'l': port = atoi(optarg); break;
+        case 'v': verbose++; break;
+        default:  usage(argv[0]); return 2;
+        }
+    }
+    if (script) {
+        if (load_script(g, script) < 0)
+            return 2;
+    } else {
+        g->nseg = 1;
+        g->seg[0].fps = fps;
+        g->seg[0].loss = loss;
+    }
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    srand(784);
+    probe_default(dev.probe);
+    dev.ae_mode = 0x08;  // aperture priority (auto exposure)
+    dev.exposure = 333;
+    pthread_mutex_init(&dev.send_lock, NULL);
+    pthread_mutex_init(&dev.gen_lock, NULL);
+    pthread_mutex_init(&dev.lock, NULL);
+    pthread_cond_init(&dev.cond, NULL);
+    gen_reset(g, 3060 - RIG_HEADER_LEN);
+
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (port < 0) {
+        dev.fd = vhci_attach();
+        if (dev.fd < 0)
+            return 1;
+    } else {
+        lfd = listen_tcp(port);
+        if (lfd < 0) {
+            perror("listen");
+            return 1;
+        }
+        printf("orbit_usbip: waiting for usbip on port %d (bus id " RIG_BUSID ")\n", port);
+        do {
+            dev.fd = accept(lfd, NULL, NULL);
+            if (dev.fd < 0)
+                return stop ? 0 : 1;
+            ret = usbip_handshake(dev.fd);
+            if (ret != 0)
+                close(dev.fd);
+        } while (ret != 0 && !stop);
+        close(lfd);
+        tcp_tune(dev.fd);
+        printf("orbit_usbip: imported\n");
+    }
+
+    pthread_create(&th, NULL, stream_thread, NULL);
+    ret = serve();
+
+    stop = 1;
+    pthread_mutex_lock(&dev.lock);
+    pthread_cond_broadcast(&dev.cond);
+    pthread_mutex_unlock(&dev.lock);
+    vhci_detach();
+    shutdown(dev.fd, SHUT_RDWR);
+    pthread_join(th, NULL);
+    close(dev.fd);
+
+    printf("orbit_usbip: %llu frames, %llu stills, %llu packets, %llu lost, %llu missed intervals\n",
+           (unsigned long long)g->frames, (unsigned long long)g->stills, (unsigned long long)g->packets,
+           (unsigned long long)g->lost, (unsigned long long)g->missed);
+    return ret < 0 ? 1 : 0;
+}
@@ -0,0 +1,31 @@
+#ifndef RIG_H
+#define RIG_H
+
+// Shared by the emulated camera (orbit_usbip) and the end-to-end benchmark (e2e_bench)
+
+#include <stdint.h>
+
+#define RIG_VID          0x046d
+#define RIG_PID          0x08cc   // QuickCam Orbit MP
+#define RIG_WIDTH        640
+#define RIG_HEIGHT       480
+#define RIG_FRAME_BYTES  (RIG_WIDTH * RIG_HEIGHT * 2)
+#define RIG_HEADER_LEN   12       // UVC payload header with PTS and SCR
+
+#define RIG_MAGIC        "ORBT"
+#define RIG_MAGIC_STILL  "STIL"
+
+// First bytes of every emulated frame
+struct rig_frame_header {
+    char     magic[4];
+    uint32_t sequence;   // preview frame number, from 1
+    uint64_t eof_ns;     // CLOCK_MONOTONIC of the end of the last packet of the frame
+};
+
+// Content of the frame after the header
+static inline uint8_t rig_pattern(uint32_t sequence, uint32_t offset)
+{
+    return (uint8_t)(offset * 7 + (offset >> 12) + sequence * 13);
+}
+
+#endif